@@ -41,20 +41,9 @@ namespace Example
         public static void AddSession(string id, string sdp)
         {
             var session = Sessions[id] = new WebRtcSession(id);
-            using (var go = new ManualResetEvent(false))
-            {
-                Task.Factory.StartNew(() =>
-                {
-
-                    using (session.Spitfire)
-                    {
-                       Console.WriteLine($"Starting WebRTC Loop for {id}");
-                        session.BeginLoop(go);
-                    }
-                }, session.Token.Token, TaskCreationOptions.LongRunning, TaskScheduler.Default);
-                if (go.WaitOne(9999))
-                    session.Setup(sdp);
-            }
+            Console.WriteLine($"Starting WebRTC session for {id}");
+            if (session.Begin())
+                session.Setup(sdp);
         }
     }
 }
@@ -15,6 +15,8 @@ namespace Example
         {
             Id = id;
             Spitfire = new SpitfireRtc(44110, 44113);
+            //Callbacks are driven by the shared engine threads, no message loop is needed
+            Spitfire.MessagePump = MessagePump.Engine;
             Token = new CancellationTokenSource();
         }
 
@@ -23,7 +25,7 @@ namespace Example
         public SpitfireRtc Spitfire { get; set; }
         public readonly CancellationTokenSource Token;
 
-        public void BeginLoop(ManualResetEvent go)
+        public bool Begin()
         {
             //Call this before starting a peer connection
             SpitfireRtc.InitializeSSL();
@@ -34,15 +36,7 @@ namespace Example
                 Port = 19302,
                 Type = ServerType.Stun,
             });
-            if (Spitfire.InitializePeerConnection())
-            {
-                go.Set();
-                //You only need this until the datachannel opens or the ice state is connected. 
-                while (!Token.Token.IsCancellationRequested && Spitfire.ProcessMessages(1000))
-                {
-                    Spitfire.ProcessMessages(1000);
-                }
-            }
+            return Spitfire.InitializePeerConnection();
         }
 
         public void Setup(string sdp)
@@ -0,0 +1,321 @@
+#include "AsyncLogSink.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/platform_thread_types.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace Spitfire
+{
+	// the writer hands the files this much at a time
+	static const size_t kBatchBytes = 64 * 1024;
+
+	static rtc::CriticalSection enabled_crit;
+	static std::unique_ptr<AsyncLogSink> enabled_sink;
+
+	static size_t Padded(size_t length)
+	{
+		return (length + 7) & ~size_t(7);
+	}
+
+	static const char* SeverityName(uint8_t severity)
+	{
+		switch (severity)
+		{
+		case rtc::LS_VERBOSE:
+			return "VERBOSE";
+		case rtc::LS_INFO:
+			return "INFO";
+		case rtc::LS_WARNING:
+			return "WARNING";
+		case rtc::LS_ERROR:
+			return "ERROR";
+		default:
+			return "NONE";
+		}
+	}
+
+	static size_t FileSize(size_t max_log_size, bool binary)
+	{
+		// binary files end on a record boundary, which is always a multiple of 8
+		return binary ? std::max<size_t>(max_log_size - max_log_size % 8, 64) : max_log_size;
+	}
+
+	static RtcLogSinkOptions Normalize(RtcLogSinkOptions options, size_t file_size)
+	{
+		options.records = std::max<uint32_t>(options.records, 1);
+		options.recordSize = std::max<uint32_t>(options.recordSize, 16);
+		if (options.binary)
+		{
+			// a record must fit into one file
+			const auto room = static_cast<uint32_t>(std::min<size_t>(file_size - 16, UINT32_MAX));
+			options.recordSize = std::min(options.recordSize, room);
+		}
+		options.flushIntervalMs = std::max(options.flushIntervalMs, 1);
+		return options;
+	}
+
+	AsyncLogSink::AsyncLogSink(const std::string& directory, const std::string& prefix, size_t max_log_size, size_t num_log_files,
+		const RtcLogSinkOptions& options) :
+		options_(Normalize(options, FileSize(max_log_size, options.binary))),
+		max_file_size_(FileSize(max_log_size, options.binary)),
+		stream_(new rtc::FileRotatingStream(directory, prefix, max_file_size_, num_log_files)),
+		headers_(options_.records),
+		text_(static_cast<size_t>(options_.records) * options_.recordSize),
+		free_(options_.records),
+		queued_(options_.records),
+		wake_threshold_(std::max<size_t>(options_.records / 4, 1))
+	{
+		static_assert(sizeof(RecordHeader) == 16, "binary logs depend on the header size");
+		for (uint32_t record = 0; record < options_.records; ++record)
+		{
+			auto free_record = record;
+			free_.TryPush(std::move(free_record));
+		}
+		batch_.reserve(kBatchBytes + options_.recordSize + sizeof(RecordHeader) + 8);
+	}
+
+	AsyncLogSink::~AsyncLogSink()
+	{
+		if (running_.exchange(false))
+		{
+			wake_.Set();
+			writer_.join();
+		}
+		stream_->Close();
+	}
+
+	bool AsyncLogSink::Init()
+	{
+		if (!stream_->Open())
+		{
+			return false;
+		}
+		running_ = true;
+		writer_ = std::thread(&AsyncLogSink::Run, this);
+		return true;
+	}
+
+	void AsyncLogSink::OnLogMessage(const std::string& message)
+	{
+		Append(message, rtc::LS_INFO);
+	}
+
+	void AsyncLogSink::OnLogMessage(const std::string& message, rtc::LoggingSeverity severity)
+	{
+		Append(message, severity);
+	}
+
+	void AsyncLogSink::OnLogMessage(const std::string& message, rtc::LoggingSeverity severity, const char*)
+	{
+		Append(message, severity);
+	}
+
+	void AsyncLogSink::Append(const std::string& message, rtc::LoggingSeverity severity)
+	{
+		uint32_t record;
+		if (!free_.TryPop(record))
+		{
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		const auto length = std::min<size_t>(message.size(), options_.recordSize);
+		auto& header = headers_[record];
+		header.timestampUs = rtc::TimeMicros();
+		header.length = static_cast<uint32_t>(length);
+		header.severity = static_cast<uint8_t>(severity);
+		header.truncated = length < message.size() ? 1 : 0;
+		header.reserved = 0;
+		if (header.truncated)
+		{
+			truncated_.fetch_add(1, std::memory_order_relaxed);
+		}
+		std::memcpy(&text_[static_cast<size_t>(record) * options_.recordSize], message.data(), length);
+		queued_.TryPush(std::move(record));
+
+		// the writer wakes up on its own every flush interval, only a filling ring is worth waking it early
+		if (queued_.Size() >= wake_threshold_)
+		{
+			wake_.Set();
+		}
+	}
+
+	void AsyncLogSink::Run()
+	{
+		rtc::SetCurrentThreadName("spitfire_log");
+		while (running_.load(std::memory_order_acquire))
+		{
+			wake_.Wait(options_.flushIntervalMs);
+			WriteQueued();
+		}
+		// whatever was logged before the sink was removed
+		WriteQueued();
+	}
+
+	void AsyncLogSink::WriteQueued()
+	{
+		const auto waiting = static_cast<uint32_t>(queued_.Size());
+		if (waiting > high_watermark_.load(std::memory_order_relaxed))
+		{
+			high_watermark_.store(waiting, std::memory_order_relaxed);
+		}
+
+		uint64_t count = 0;
+		uint32_t record;
+		while (queued_.TryPop(record))
+		{
+			Encode(record);
+			free_.TryPush(std::move(record));
+			++count;
+			if (batch_.size() >= kBatchBytes)
+			{
+				WriteBatch();
+			}
+		}
+		if (count > 0)
+		{
+			WriteBatch();
+			stream_->Flush();
+			written_.fetch_add(count, std::memory_order_relaxed);
+		}
+	}
+
+	void AsyncLogSink::Encode(uint32_t record)
+	{
+		const auto& header = headers_[record];
+		const auto* text = &text_[static_cast<size_t>(record) * options_.recordSize];
+		if (!options_.binary)
+		{
+			batch_.append(text, header.length);
+			if (header.truncated)
+			{
+				batch_ += '\n';
+			}
+			return;
+		}
+
+		const auto padded = Padded(header.length);
+		if (file_bytes_ + batch_.size() + sizeof(header) + padded > max_file_size_)
+		{
+			// fill up the current file so the record starts the next one
+			batch_.append(max_file_size_ - file_bytes_ - batch_.size(), '\0');
+			WriteBatch();
+		}
+		batch_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+		batch_.append(text, header.length);
+		batch_.append(padded - header.length, '\0');
+	}
+
+	void AsyncLogSink::WriteBatch()
+	{
+		if (batch_.empty())
+		{
+			return;
+		}
+		size_t written = 0;
+		int error = 0;
+		stream_->WriteAll(batch_.data(), batch_.size(), &written, &error);
+		bytes_written_.fetch_add(written, std::memory_order_relaxed);
+		// the stream starts a new file every time one reaches |max_file_size_|
+		file_bytes_ = (file_bytes_ + written) % max_file_size_;
+		batch_.clear();
+	}
+
+	RtcLogSinkStats AsyncLogSink::GetStats() const
+	{
+		RtcLogSinkStats stats{};
+		stats.written = written_.load(std::memory_order_relaxed);
+		stats.dropped = dropped_.load(std::memory_order_relaxed);
+		stats.truncated = truncated_.load(std::memory_order_relaxed);
+		stats.bytesWritten = bytes_written_.load(std::memory_order_relaxed);
+		stats.highWatermark = high_watermark_.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	bool AsyncLogSink::Enable(const std::string& directory, const std::string& prefix, size_t max_log_size, size_t num_log_files,
+		rtc::LoggingSeverity severity, const RtcLogSinkOptions& options)
+	{
+		rtc::CritScope lock(&enabled_crit);
+		// the new sink deletes the files of its prefix, so the old one has to be done with them first
+		if (enabled_sink)
+		{
+			rtc::LogMessage::RemoveLogToStream(enabled_sink.get());
+			enabled_sink.reset();
+		}
+
+		std::unique_ptr<AsyncLogSink> sink(new AsyncLogSink(directory, prefix, max_log_size, num_log_files, options));
+		if (!sink->Init())
+		{
+			return false;
+		}
+		rtc::LogMessage::LogTimestamps();
+		rtc::LogMessage::LogThreads();
+		rtc::LogMessage::AddLogToStream(sink.get(), severity);
+		enabled_sink = std::move(sink);
+		return true;
+	}
+
+	void AsyncLogSink::Disable()
+	{
+		rtc::CritScope lock(&enabled_crit);
+		if (enabled_sink)
+		{
+			// no thread is inside the sink anymore once it is removed
+			rtc::LogMessage::RemoveLogToStream(enabled_sink.get());
+			enabled_sink.reset();
+		}
+	}
+
+	bool AsyncLogSink::GetEnabledStats(RtcLogSinkStats* stats)
+	{
+		rtc::CritScope lock(&enabled_crit);
+		if (!enabled_sink)
+		{
+			return false;
+		}
+		*stats = enabled_sink->GetStats();
+		return true;
+	}
+
+	bool AsyncLogSink::Decode(const std::string& directory, const std::string& prefix, std::string* text)
+	{
+		rtc::FileRotatingStreamReader reader(directory, prefix);
+		std::vector<char> data(reader.GetSize());
+		if (data.empty())
+		{
+			return false;
+		}
+		data.resize(reader.ReadAll(data.data(), data.size()));
+
+		size_t position = 0;
+		while (position + sizeof(RecordHeader) <= data.size())
+		{
+			RecordHeader header;
+			std::memcpy(&header, &data[position], sizeof(header));
+			// a record never has a zero timestamp, zeros are the padding at the end of a file
+			if (header.timestampUs == 0)
+			{
+				position += 8;
+				continue;
+			}
+			const auto padded = Padded(header.length);
+			if (position + sizeof(header) + padded > data.size())
+			{
+				return false;
+			}
+			char prefix_text[48];
+			std::snprintf(prefix_text, sizeof(prefix_text), "[%lld] %s ", static_cast<long long>(header.timestampUs), SeverityName(header.severity));
+			*text += prefix_text;
+			text->append(&data[position + sizeof(header)], header.length);
+			if (header.truncated)
+			{
+				*text += '\n';
+			}
+			position += sizeof(header) + padded;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "MessageRing.h"
+#include "rtc_base/event.h"
+#include "rtc_base/file_rotating_stream.h"
+#include "rtc_base/logging.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Spitfire
+{
+	struct RtcLogSinkOptions
+	{
+		// Records the ring holds, once every one of them waits for the writer new records are dropped.
+		uint32_t records = 4096;
+		// Longer messages are cut to this many bytes.
+		uint32_t recordSize = 512;
+		// Writes fixed header binary records instead of text, AsyncLogSink::Decode turns them back into text.
+		bool binary = false;
+		// How long the writer sleeps while the ring is not filling up.
+		int32_t flushIntervalMs = 100;
+	};
+
+	struct RtcLogSinkStats
+	{
+		uint64_t written;
+		// records lost because the ring was full
+		uint64_t dropped;
+		// records cut to the record size
+		uint64_t truncated;
+		uint64_t bytesWritten;
+		// most records found waiting when the writer woke up
+		uint32_t highWatermark;
+	};
+
+	// Log sink that keeps file I/O off the threads that log.
+	// rtc::LogMessage hands every sink a formatted message on the logging thread, here it is only copied
+	// into a preallocated record taken from a lock-free ring and a background thread writes the records
+	// out through a FileRotatingStream, so a burst of ICE logging no longer stalls the network thread.
+	// When the writer falls behind and no record is free the message is dropped and counted.
+	class AsyncLogSink : public rtc::LogSink
+	{
+	public:
+		// |num_log_files| must be greater than 1 and |max_log_size| greater than 0, as for rtc::FileRotatingLogSink.
+		AsyncLogSink(const std::string& directory, const std::string& prefix, size_t max_log_size, size_t num_log_files,
+			const RtcLogSinkOptions& options = RtcLogSinkOptions());
+		// Writes what is still queued and stops the writer, remove the sink from rtc::LogMessage first.
+		~AsyncLogSink() override;
+
+		AsyncLogSink(const AsyncLogSink&) = delete;
+		AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+
+		// Deletes the previous files of |prefix|, opens a new one and starts the writer.
+		bool Init();
+
+		void OnLogMessage(const std::string& message) override;
+		void OnLogMessage(const std::string& message, rtc::LoggingSeverity severity) override;
+		void OnLogMessage(const std::string& message, rtc::LoggingSeverity severity, const char* tag) override;
+
+		RtcLogSinkStats GetStats() const;
+
+		// Replaces the process-wide sink with a new one logging |severity| and above, with timestamps and thread ids.
+		static bool Enable(const std::string& directory, const std::string& prefix, size_t max_log_size, size_t num_log_files,
+			rtc::LoggingSeverity severity, const RtcLogSinkOptions& options = RtcLogSinkOptions());
+		// Removes the process-wide sink once the records it still holds are written.
+		static void Disable();
+		// Returns false when there is no process-wide sink.
+		static bool GetEnabledStats(RtcLogSinkStats* stats);
+
+		// Turns the binary logs of |prefix| in |directory| back into text, oldest record first.
+		static bool Decode(const std::string& directory, const std::string& prefix, std::string* text);
+
+	private:
+		// Binary records start with this header, in host byte order, followed by the message padded to 8 bytes.
+		// The writer pads the rest of a log file with zeros instead of splitting a record across two files.
+		struct RecordHeader
+		{
+			int64_t timestampUs;
+			uint32_t length;
+			uint8_t severity;
+			uint8_t truncated;
+			uint16_t reserved;
+		};
+
+		void Run();
+		void Append(const std::string& message, rtc::LoggingSeverity severity);
+		// Moves every queued record into the files.
+		void WriteQueued();
+		void Encode(uint32_t record);
+		void WriteBatch();
+
+		const RtcLogSinkOptions options_;
+		const size_t max_file_size_;
+		std::unique_ptr<rtc::FileRotatingStream> stream_;
+		std::thread writer_;
+		rtc::Event wake_{ false, false };
+		std::atomic<bool> running_{ false };
+
+		// |free_| and |queued_| together always hold every record exactly once, so a push never fails
+		std::vector<RecordHeader> headers_;
+		std::vector<char> text_;
+		MessageRing<uint32_t> free_;
+		MessageRing<uint32_t> queued_;
+		const size_t wake_threshold_;
+
+		// only touched by the writer
+		std::string batch_;
+		size_t file_bytes_ = 0;
+
+		std::atomic<uint64_t> written_{ 0 };
+		std::atomic<uint64_t> dropped_{ 0 };
+		std::atomic<uint64_t> truncated_{ 0 };
+		std::atomic<uint64_t> bytes_written_{ 0 };
+		std::atomic<uint32_t> high_watermark_{ 0 };
+	};
+}
@@ -0,0 +1,99 @@
+#include "CandidateBatcher.h"
+#include "rtc_base/task_utils/to_queued_task.h"
+
+namespace Spitfire
+{
+	CandidateBatcher::CandidateBatcher(rtc::Thread* thread, const RtcCandidateBatchingOptions& options, Deliver deliver) :
+		thread_(thread),
+		options_(options),
+		deliver_(std::move(deliver))
+	{
+	}
+
+	void CandidateBatcher::Add(const std::string& sdp_mid, int32_t sdp_mline_index, const std::string& sdp, const RtcCandidateFields* fields)
+	{
+		auto full = false;
+		auto opened = false;
+		uint64_t generation;
+		{
+			rtc::CritScope lock(&crit_);
+			if (stopped_)
+			{
+				return;
+			}
+			open_.push_back(Candidate{ sdp_mid, sdp_mline_index, sdp, fields ? *fields : RtcCandidateFields{}, fields != nullptr });
+			opened = open_.size() == 1;
+			full = open_.size() >= options_.maxCandidates;
+			generation = generation_;
+		}
+		if (full)
+		{
+			Flush(false);
+		}
+		else if (opened && options_.windowMs > 0)
+		{
+			ScheduleWindow(generation);
+		}
+	}
+
+	void CandidateBatcher::Complete()
+	{
+		Flush(true);
+	}
+
+	void CandidateBatcher::Stop()
+	{
+		rtc::CritScope deliver_lock(&deliver_crit_);
+		rtc::CritScope lock(&crit_);
+		stopped_ = true;
+		open_.clear();
+		deliver_ = nullptr;
+	}
+
+	void CandidateBatcher::ScheduleWindow(uint64_t generation)
+	{
+		std::weak_ptr<CandidateBatcher> weak_self = shared_from_this();
+		thread_->PostDelayedTask(webrtc::ToQueuedTask([weak_self, generation]
+		{
+			auto self = weak_self.lock();
+			if (!self)
+			{
+				return;
+			}
+			{
+				rtc::CritScope lock(&self->crit_);
+				// the batch filled up and went out before its window ended
+				if (self->generation_ != generation)
+				{
+					return;
+				}
+			}
+			self->Flush(false);
+		}), options_.windowMs);
+	}
+
+	void CandidateBatcher::Flush(bool complete)
+	{
+		rtc::CritScope deliver_lock(&deliver_crit_);
+		std::vector<Candidate> batch;
+		{
+			rtc::CritScope lock(&crit_);
+			if (stopped_ || (open_.empty() && !complete))
+			{
+				return;
+			}
+			batch.swap(open_);
+			++generation_;
+		}
+		std::vector<RtcIceCandidate> candidates;
+		candidates.reserve(batch.size());
+		for (const auto& candidate : batch)
+		{
+			candidates.push_back(RtcIceCandidate{ candidate.sdpMid.c_str(), candidate.sdpMlineIndex, candidate.sdp.c_str(), candidate.hasFields ? &candidate.fields : nullptr });
+		}
+		if (deliver_)
+		{
+			deliver_(candidates.data(), static_cast<uint32_t>(candidates.size()), complete);
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "CandidateParser.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/thread.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Spitfire
+{
+	// A candidate as it goes to or comes from signaling, the strings are only valid for the call they are handed to.
+	struct RtcIceCandidate
+	{
+		const char* sdpMid;
+		int32_t sdpMlineIndex;
+		const char* sdp;
+		// set for local candidates when the peer has onIceCandidateFields, null otherwise and ignored by AddIceCandidates
+		const RtcCandidateFields* fields;
+	};
+
+	struct RtcCandidateBatchingOptions
+	{
+		// How long the first candidate of a batch may wait for company, 0 holds every candidate until gathering completes.
+		int32_t windowMs = 50;
+		// A batch is delivered as soon as it holds this many candidates.
+		uint32_t maxCandidates = 32;
+	};
+
+	// Collects the local candidates of a peer and delivers them in batches, so signaling can send
+	// one message for many candidates. The batch that goes out once gathering completed is marked
+	// complete, it is delivered even when empty and serves as the end of candidates.
+	// Batches are delivered on |thread|, the signaling thread the candidates are gathered on.
+	class CandidateBatcher : public std::enable_shared_from_this<CandidateBatcher>
+	{
+	public:
+		typedef std::function<void(const RtcIceCandidate* candidates, uint32_t count, bool complete)> Deliver;
+
+		CandidateBatcher(rtc::Thread* thread, const RtcCandidateBatchingOptions& options, Deliver deliver);
+
+		CandidateBatcher(const CandidateBatcher&) = delete;
+		CandidateBatcher& operator=(const CandidateBatcher&) = delete;
+
+		// |fields| may be null, the batch then carries none for this candidate.
+		void Add(const std::string& sdp_mid, int32_t sdp_mline_index, const std::string& sdp, const RtcCandidateFields* fields);
+		// Delivers what is left as the complete batch.
+		void Complete();
+		// Drops the open batch, no delivery is running or will start once this returns.
+		void Stop();
+
+	private:
+		struct Candidate
+		{
+			std::string sdpMid;
+			int32_t sdpMlineIndex;
+			std::string sdp;
+			RtcCandidateFields fields;
+			bool hasFields;
+		};
+
+		void ScheduleWindow(uint64_t generation);
+		void Flush(bool complete);
+
+		rtc::Thread* thread_;
+		const RtcCandidateBatchingOptions options_;
+
+		rtc::CriticalSection crit_;
+		std::vector<Candidate> open_;
+		// counts delivered batches, a window timer only flushes the batch it was started for
+		uint64_t generation_ = 0;
+		bool stopped_ = false;
+
+		// held while delivering, so Stop waits for a delivery in progress
+		rtc::CriticalSection deliver_crit_;
+		Deliver deliver_;
+	};
+}
@@ -0,0 +1,281 @@
+#include "CandidateParser.h"
+#include "api/candidate.h"
+#include "p2p/base/port.h"
+#include "rtc_base/net_helper.h"
+#include "rtc_base/net_helpers.h"
+
+#include <cstring>
+
+namespace Spitfire
+{
+	namespace
+	{
+		struct Token
+		{
+			const char* data;
+			size_t length;
+		};
+
+		// the next run of characters up to a space, false at the end of the line
+		bool Next(const char*& at, const char* end, Token* token)
+		{
+			while (at < end && *at == ' ')
+			{
+				++at;
+			}
+			const auto* start = at;
+			while (at < end && *at != ' ')
+			{
+				++at;
+			}
+			token->data = start;
+			token->length = static_cast<size_t>(at - start);
+			return token->length > 0;
+		}
+
+		// transport and type are case insensitive in RFC 5245, the rest is compared exactly
+		bool Equals(const Token& token, const char* literal)
+		{
+			const auto length = std::strlen(literal);
+			if (token.length != length)
+			{
+				return false;
+			}
+			for (size_t i = 0; i < length; ++i)
+			{
+				auto c = token.data[i];
+				if (c >= 'A' && c <= 'Z')
+				{
+					c = static_cast<char>(c - 'A' + 'a');
+				}
+				if (c != literal[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool Unsigned(const Token& token, uint64_t max, uint64_t* value)
+		{
+			if (token.length == 0 || token.length > 20)
+			{
+				return false;
+			}
+			uint64_t result = 0;
+			for (size_t i = 0; i < token.length; ++i)
+			{
+				const auto c = token.data[i];
+				if (c < '0' || c > '9')
+				{
+					return false;
+				}
+				result = result * 10 + static_cast<uint64_t>(c - '0');
+				if (result > max)
+				{
+					return false;
+				}
+			}
+			*value = result;
+			return true;
+		}
+
+		template <size_t N>
+		void Copy(const char* data, size_t length, char (&destination)[N])
+		{
+			const auto count = length < N - 1 ? length : N - 1;
+			std::memcpy(destination, data, count);
+			destination[count] = '\0';
+		}
+
+		bool TypeOf(const Token& token, RtcCandidateType* type)
+		{
+			if (Equals(token, "host"))
+			{
+				*type = RtcCandidateType::Host;
+			}
+			else if (Equals(token, "srflx"))
+			{
+				*type = RtcCandidateType::ServerReflexive;
+			}
+			else if (Equals(token, "prflx"))
+			{
+				*type = RtcCandidateType::PeerReflexive;
+			}
+			else if (Equals(token, "relay"))
+			{
+				*type = RtcCandidateType::Relay;
+			}
+			else
+			{
+				return false;
+			}
+			return true;
+		}
+
+		template <size_t N>
+		void CopyAddress(const rtc::SocketAddress& address, char (&destination)[N])
+		{
+			const auto& ip = address.ipaddr();
+			if (ip.family() == AF_INET)
+			{
+				const auto v4 = ip.ipv4_address();
+				if (rtc::inet_ntop(AF_INET, &v4, destination, N))
+				{
+					return;
+				}
+			}
+			else if (ip.family() == AF_INET6)
+			{
+				const auto v6 = ip.ipv6_address();
+				if (rtc::inet_ntop(AF_INET6, &v6, destination, N))
+				{
+					return;
+				}
+			}
+			// mDNS host candidates only carry a name
+			const auto& hostname = address.hostname();
+			Copy(hostname.data(), hostname.size(), destination);
+		}
+	}
+
+	bool CandidateParser::Parse(const char* sdp, size_t length, RtcCandidateFields* fields)
+	{
+		*fields = RtcCandidateFields{};
+		if (!sdp)
+		{
+			return false;
+		}
+
+		const auto* at = sdp;
+		auto* end = sdp + length;
+		while (end > at && (end[-1] == '\r' || end[-1] == '\n'))
+		{
+			--end;
+		}
+		if (end - at >= 2 && at[0] == 'a' && at[1] == '=')
+		{
+			at += 2;
+		}
+		static const char kPrefix[] = "candidate:";
+		const auto prefix_length = sizeof(kPrefix) - 1;
+		if (static_cast<size_t>(end - at) < prefix_length || std::memcmp(at, kPrefix, prefix_length) != 0)
+		{
+			return false;
+		}
+		at += prefix_length;
+
+		Token foundation, component, transport, priority, address, port, typ, type;
+		uint64_t value = 0;
+		if (!Next(at, end, &foundation) || !Next(at, end, &component) || !Next(at, end, &transport) || !Next(at, end, &priority)
+			|| !Next(at, end, &address) || !Next(at, end, &port) || !Next(at, end, &typ) || !Next(at, end, &type))
+		{
+			*fields = RtcCandidateFields{};
+			return false;
+		}
+
+		Copy(foundation.data, foundation.length, fields->foundation);
+		Copy(address.data, address.length, fields->address);
+		auto valid = Unsigned(component, UINT32_MAX, &value);
+		fields->component = static_cast<uint32_t>(value);
+		valid = valid && Unsigned(priority, UINT32_MAX, &value);
+		fields->priority = static_cast<uint32_t>(value);
+		valid = valid && Unsigned(port, 65535, &value);
+		fields->port = static_cast<int32_t>(value);
+		valid = valid && Equals(typ, "typ") && TypeOf(type, &fields->type);
+		if (Equals(transport, "tcp") || Equals(transport, "ssltcp"))
+		{
+			fields->tcp = true;
+		}
+		else if (!Equals(transport, "udp"))
+		{
+			valid = false;
+		}
+
+		// the extensions come in name value pairs, the ones not listed here are skipped
+		Token name, extension;
+		while (valid && Next(at, end, &name))
+		{
+			if (!Next(at, end, &extension))
+			{
+				valid = false;
+			}
+			else if (Equals(name, "raddr"))
+			{
+				Copy(extension.data, extension.length, fields->relatedAddress);
+			}
+			else if (Equals(name, "rport"))
+			{
+				valid = Unsigned(extension, 65535, &value);
+				fields->relatedPort = static_cast<int32_t>(value);
+			}
+			else if (Equals(name, "generation"))
+			{
+				valid = Unsigned(extension, UINT32_MAX, &value);
+				fields->generation = static_cast<uint32_t>(value);
+			}
+			else if (Equals(name, "ufrag"))
+			{
+				Copy(extension.data, extension.length, fields->ufrag);
+			}
+			else if (Equals(name, "network-id"))
+			{
+				valid = Unsigned(extension, 65535, &value);
+				fields->networkId = static_cast<uint16_t>(value);
+			}
+			else if (Equals(name, "network-cost"))
+			{
+				valid = Unsigned(extension, 65535, &value);
+				fields->networkCost = static_cast<uint16_t>(value);
+			}
+		}
+
+		if (!valid)
+		{
+			*fields = RtcCandidateFields{};
+		}
+		return valid;
+	}
+
+	void CandidateParser::Fill(const cricket::Candidate& candidate, RtcCandidateFields* fields)
+	{
+		*fields = RtcCandidateFields{};
+		const auto& foundation = candidate.foundation();
+		Copy(foundation.data(), foundation.size(), fields->foundation);
+		fields->component = static_cast<uint32_t>(candidate.component());
+		fields->tcp = candidate.protocol() != cricket::UDP_PROTOCOL_NAME;
+		fields->priority = candidate.priority();
+		CopyAddress(candidate.address(), fields->address);
+		fields->port = candidate.address().port();
+
+		// WebRTC names the types after the ports that found them
+		const auto& type = candidate.type();
+		if (type == cricket::LOCAL_PORT_TYPE)
+		{
+			fields->type = RtcCandidateType::Host;
+		}
+		else if (type == cricket::STUN_PORT_TYPE)
+		{
+			fields->type = RtcCandidateType::ServerReflexive;
+		}
+		else if (type == cricket::PRFLX_PORT_TYPE)
+		{
+			fields->type = RtcCandidateType::PeerReflexive;
+		}
+		else if (type == cricket::RELAY_PORT_TYPE)
+		{
+			fields->type = RtcCandidateType::Relay;
+		}
+
+		if (fields->type != RtcCandidateType::Host && !candidate.related_address().IsNil())
+		{
+			CopyAddress(candidate.related_address(), fields->relatedAddress);
+			fields->relatedPort = candidate.related_address().port();
+		}
+		fields->generation = candidate.generation();
+		const auto& ufrag = candidate.username();
+		Copy(ufrag.data(), ufrag.size(), fields->ufrag);
+		fields->networkId = candidate.network_id();
+		fields->networkCost = candidate.network_cost();
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "StatsCollectorObserver.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cricket
+{
+	class Candidate;
+}
+
+namespace Spitfire
+{
+	// The fields of one candidate line, fixed size so it is handed across the C API and the managed wrapper
+	// without allocating. Strings are always terminated, longer values are cut off.
+	struct RtcCandidateFields
+	{
+		char foundation[36];
+		uint32_t component;
+		// true for TCP, false for UDP
+		bool tcp;
+		uint32_t priority;
+		// an IP address, or the mDNS name of a host candidate
+		char address[48];
+		int32_t port;
+		RtcCandidateType type;
+		// empty and 0 for host candidates
+		char relatedAddress[48];
+		int32_t relatedPort;
+		uint32_t generation;
+		char ufrag[64];
+		uint16_t networkId;
+		uint16_t networkCost;
+	};
+
+	// Reads candidates without regular expressions or allocations, for the application that needs more
+	// than the candidate string and would otherwise run its own parser on every line.
+	class CandidateParser
+	{
+	public:
+		// Parses one "candidate:" line of |length| bytes, with or without the leading "a=" and trailing line break.
+		// Returns false when a mandatory field is missing or malformed, |fields| is then zeroed.
+		static bool Parse(const char* sdp, size_t length, RtcCandidateFields* fields);
+		// The fields of a candidate WebRTC already parsed, as handed to the peer connection observer.
+		static void Fill(const cricket::Candidate& candidate, RtcCandidateFields* fields);
+	};
+}
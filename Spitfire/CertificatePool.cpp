@@ -0,0 +1,152 @@
+#include "CertificatePool.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+namespace Spitfire
+{
+	class CertificatePool::Generator : public rtc::RTCCertificateGeneratorInterface
+	{
+	public:
+		explicit Generator(std::shared_ptr<CertificatePool> pool) :
+			pool_(std::move(pool))
+		{
+		}
+
+		void GenerateCertificateAsync(const rtc::KeyParams& key_params, const absl::optional<uint64_t>& expires_ms,
+			const rtc::scoped_refptr<rtc::RTCCertificateGeneratorCallback>& callback) override
+		{
+			// called on the signaling thread, which is where the answer is expected as well
+			auto* caller = rtc::Thread::Current();
+			rtc::scoped_refptr<rtc::RTCCertificate> certificate;
+			if (key_params.type() == rtc::KT_ECDSA && key_params.ec_curve() == rtc::EC_NIST_P256 && !expires_ms)
+			{
+				certificate = pool_->Take();
+			}
+			if (!certificate)
+			{
+				pool_->GenerateAsync(caller, key_params, expires_ms, callback);
+				return;
+			}
+			// never answer from within the call, the peer connection only listens once it returned
+			caller->PostTask(RTC_FROM_HERE, [callback, certificate]
+			{
+				callback->OnSuccess(certificate);
+			});
+		}
+
+	private:
+		const std::shared_ptr<CertificatePool> pool_;
+	};
+
+	CertificatePool::CertificatePool(uint32_t size) :
+		size_(size),
+		thread_(rtc::Thread::Create())
+	{
+		thread_->SetName("certificate_thread", nullptr);
+		RTC_CHECK(thread_->Start()) << "Failed to start certificate thread";
+		rtc::CritScope lock(&crit_);
+		ScheduleRefill();
+	}
+
+	CertificatePool::~CertificatePool()
+	{
+		stopping_ = true;
+		thread_->Stop();
+	}
+
+	rtc::scoped_refptr<rtc::RTCCertificate> CertificatePool::Take()
+	{
+		rtc::CritScope lock(&crit_);
+		rtc::scoped_refptr<rtc::RTCCertificate> certificate;
+		if (certificates_.empty())
+		{
+			++misses_;
+		}
+		else
+		{
+			certificate = certificates_.front();
+			certificates_.pop_front();
+			++hits_;
+		}
+		ScheduleRefill();
+		return certificate;
+	}
+
+	std::unique_ptr<rtc::RTCCertificateGeneratorInterface> CertificatePool::CreateGenerator(std::shared_ptr<CertificatePool> pool)
+	{
+		return std::unique_ptr<rtc::RTCCertificateGeneratorInterface>(new Generator(std::move(pool)));
+	}
+
+	void CertificatePool::GenerateAsync(rtc::Thread* caller, const rtc::KeyParams& key_params, const absl::optional<uint64_t>& expires_ms,
+		const rtc::scoped_refptr<rtc::RTCCertificateGeneratorCallback>& callback)
+	{
+		thread_->PostTask(RTC_FROM_HERE, [caller, key_params, expires_ms, callback]
+		{
+			const auto certificate = rtc::RTCCertificateGenerator::GenerateCertificate(key_params, expires_ms);
+			caller->PostTask(RTC_FROM_HERE, [callback, certificate]
+			{
+				if (certificate)
+				{
+					callback->OnSuccess(certificate);
+				}
+				else
+				{
+					callback->OnFailure();
+				}
+			});
+		});
+	}
+
+	void CertificatePool::ScheduleRefill()
+	{
+		// crit_ is held
+		if (refilling_ || certificates_.size() >= size_)
+		{
+			return;
+		}
+		refilling_ = true;
+		thread_->PostTask(RTC_FROM_HERE, [this] { Refill(); });
+	}
+
+	void CertificatePool::Refill()
+	{
+		// one at a time, so the pool is usable while it fills and stopping does not wait for all of them
+		while (!stopping_)
+		{
+			{
+				rtc::CritScope lock(&crit_);
+				if (certificates_.size() >= size_)
+				{
+					refilling_ = false;
+					return;
+				}
+			}
+
+			const auto start_ns = rtc::TimeNanos();
+			const auto certificate = rtc::RTCCertificateGenerator::GenerateCertificate(rtc::KeyParams::ECDSA(rtc::EC_NIST_P256), absl::nullopt);
+
+			rtc::CritScope lock(&crit_);
+			if (!certificate)
+			{
+				RTC_LOG(LS_ERROR) << "Unable to generate a pooled certificate";
+				refilling_ = false;
+				return;
+			}
+			certificates_.push_back(certificate);
+			++generated_;
+			generate_ns_ += rtc::TimeNanos() - start_ns;
+		}
+	}
+
+	RtcCertificatePoolStats CertificatePool::GetStats() const
+	{
+		rtc::CritScope lock(&crit_);
+		RtcCertificatePoolStats stats{};
+		stats.available = static_cast<uint32_t>(certificates_.size());
+		stats.generated = generated_;
+		stats.hits = hits_;
+		stats.misses = misses_;
+		stats.generateMeanUs = generated_ > 0 ? generate_ns_ / static_cast<int64_t>(generated_) / rtc::kNumNanosecsPerMicrosec : 0;
+		return stats;
+	}
+}
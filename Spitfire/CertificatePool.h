@@ -0,0 +1,70 @@
+#pragma once
+
+#include "rtc_base/critical_section.h"
+#include "rtc_base/rtc_certificate.h"
+#include "rtc_base/rtc_certificate_generator.h"
+#include "rtc_base/thread.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+
+namespace Spitfire
+{
+	struct RtcCertificatePoolStats
+	{
+		// certificates ready to be handed out right now
+		uint32_t available;
+		uint64_t generated;
+		// peer connections that got a pooled certificate
+		uint64_t hits;
+		// peer connections that had to wait for a certificate to be generated
+		uint64_t misses;
+		// mean time the pool thread spent generating one certificate
+		int64_t generateMeanUs;
+	};
+
+	// ECDSA P-256 certificates generated ahead of time on a thread of their own.
+	// Generating the DTLS certificate is what a new peer connection waits for longest before it can
+	// answer, so during a connection storm every peer otherwise queues behind the others' key generation.
+	// Whatever is taken is refilled in the background.
+	class CertificatePool
+	{
+	public:
+		explicit CertificatePool(uint32_t size);
+		~CertificatePool();
+
+		CertificatePool(const CertificatePool&) = delete;
+		CertificatePool& operator=(const CertificatePool&) = delete;
+
+		// Hands out a pooled certificate, or null when the pool ran dry.
+		rtc::scoped_refptr<rtc::RTCCertificate> Take();
+
+		// Generator for PeerConnectionDependencies::cert_generator, it takes from the pool and generates
+		// on the pool thread when the pool is empty or another kind of key is asked for.
+		static std::unique_ptr<rtc::RTCCertificateGeneratorInterface> CreateGenerator(std::shared_ptr<CertificatePool> pool);
+
+		RtcCertificatePoolStats GetStats() const;
+
+	private:
+		class Generator;
+
+		// Generates on the pool thread and hands the result to |callback| on |caller|.
+		void GenerateAsync(rtc::Thread* caller, const rtc::KeyParams& key_params, const absl::optional<uint64_t>& expires_ms,
+			const rtc::scoped_refptr<rtc::RTCCertificateGeneratorCallback>& callback);
+		void ScheduleRefill();
+		void Refill();
+
+		const uint32_t size_;
+		std::unique_ptr<rtc::Thread> thread_;
+		std::atomic<bool> stopping_{ false };
+
+		rtc::CriticalSection crit_;
+		std::deque<rtc::scoped_refptr<rtc::RTCCertificate>> certificates_;
+		bool refilling_ = false;
+		uint64_t generated_ = 0;
+		uint64_t hits_ = 0;
+		uint64_t misses_ = 0;
+		int64_t generate_ns_ = 0;
+	};
+}
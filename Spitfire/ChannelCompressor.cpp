@@ -0,0 +1,193 @@
+#include "ChannelCompressor.h"
+#include "rtc_base/byte_order.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+#include "third_party/zlib/zlib.h"
+
+#include <cstring>
+
+namespace Spitfire
+{
+	// raw deflate without the zlib header and checksum, SCTP already protects the payload
+	static const int kWindowBits = -15;
+
+	ChannelCompressor::ChannelCompressor(const RtcCompressionOptions& options) :
+		options_(options),
+		deflate_(new z_stream_s()),
+		inflate_(new z_stream_s()),
+		pool_(kPoolSize)
+	{
+		if (deflateInit2(deflate_.get(), options_.level, Z_DEFLATED, kWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		{
+			RTC_LOG(LS_ERROR) << "Unable to initialize deflate, messages are sent uncompressed";
+			deflate_.reset();
+		}
+		if (inflateInit2(inflate_.get(), kWindowBits) != Z_OK)
+		{
+			RTC_LOG(LS_ERROR) << "Unable to initialize inflate, compressed messages are dropped";
+			inflate_.reset();
+		}
+	}
+
+	ChannelCompressor::~ChannelCompressor()
+	{
+		if (deflate_)
+		{
+			deflateEnd(deflate_.get());
+		}
+		if (inflate_)
+		{
+			inflateEnd(inflate_.get());
+		}
+	}
+
+	void ChannelCompressor::Compress(const webrtc::DataBuffer& message, webrtc::DataBuffer* encoded)
+	{
+		rtc::CritScope lock(&deflate_crit_);
+		const auto size = message.size();
+		if (!deflate_ || size < options_.minimumSize || backoff_ > 0)
+		{
+			if (backoff_ > 0)
+			{
+				--backoff_;
+			}
+			Tag(message, encoded);
+			return;
+		}
+
+		const auto start_us = rtc::TimeMicros();
+		const auto bound = deflateBound(deflate_.get(), static_cast<uLong>(size));
+		rtc::CopyOnWriteBuffer compressed(kHeaderSize + bound);
+		deflateReset(deflate_.get());
+		deflate_->next_in = const_cast<Bytef*>(message.data.cdata());
+		deflate_->avail_in = static_cast<uInt>(size);
+		deflate_->next_out = compressed.data() + kHeaderSize;
+		deflate_->avail_out = static_cast<uInt>(bound);
+		const auto result = deflate(deflate_.get(), Z_FINISH);
+		compress_us_ += rtc::TimeMicros() - start_us;
+
+		const auto compressed_size = bound - deflate_->avail_out;
+		if (result != Z_STREAM_END || compressed_size + kHeaderSize >= size)
+		{
+			backoff_ = options_.backoffMessages;
+			Tag(message, encoded);
+			return;
+		}
+
+		// a short memory of the ratio, so a change in the kind of data is picked up quickly
+		const auto ratio = static_cast<double>(compressed_size) / size;
+		ratio_ = messages_compressed_ == 0 ? ratio : ratio_ + (ratio - ratio_) / 8;
+		if (ratio_ > options_.maximumRatio)
+		{
+			backoff_ = options_.backoffMessages;
+		}
+
+		compressed.SetSize(kHeaderSize + compressed_size);
+		auto* header = compressed.data();
+		header[0] = kDeflate;
+		rtc::SetBE32(header + 1, static_cast<uint32_t>(size));
+		*encoded = webrtc::DataBuffer(compressed, message.binary);
+
+		++messages_compressed_;
+		bytes_in_ += size;
+		bytes_out_ += compressed.size();
+	}
+
+	void ChannelCompressor::Tag(const webrtc::DataBuffer& message, webrtc::DataBuffer* encoded)
+	{
+		rtc::CopyOnWriteBuffer tagged(1 + message.size());
+		auto* data = tagged.data();
+		data[0] = kRaw;
+		if (message.size() > 0)
+		{
+			std::memcpy(data + 1, message.data.cdata(), message.size());
+		}
+		*encoded = webrtc::DataBuffer(tagged, message.binary);
+
+		++messages_skipped_;
+		bytes_in_ += message.size();
+		bytes_out_ += tagged.size();
+	}
+
+	bool ChannelCompressor::Decompress(const webrtc::DataBuffer& encoded, webrtc::DataBuffer* message)
+	{
+		rtc::CritScope lock(&inflate_crit_);
+		const auto* data = encoded.data.cdata();
+		const auto size = encoded.size();
+		if (size >= 1 && data[0] == kRaw)
+		{
+			// nothing to undo, the message is handed on as a slice without copying
+			*message = webrtc::DataBuffer(encoded.data.Slice(1, size - 1), encoded.binary);
+			return true;
+		}
+		if (!inflate_ || size < kHeaderSize || data[0] != kDeflate)
+		{
+			++messages_dropped_;
+			return false;
+		}
+		const auto original_size = rtc::GetBE32(data + 1);
+		if (original_size > options_.maximumMessageSize)
+		{
+			RTC_LOG(WARNING) << "Dropping compressed message claiming " << original_size << " bytes";
+			++messages_dropped_;
+			return false;
+		}
+
+		const auto start_us = rtc::TimeMicros();
+		// inflated in place while the pool holds the only reference, shared with the message only afterwards
+		auto& decompressed = PooledBuffer(original_size);
+		inflateReset(inflate_.get());
+		inflate_->next_in = const_cast<Bytef*>(data + kHeaderSize);
+		inflate_->avail_in = static_cast<uInt>(size - kHeaderSize);
+		inflate_->next_out = decompressed.data();
+		inflate_->avail_out = original_size;
+		const auto result = inflate(inflate_.get(), Z_FINISH);
+		decompress_us_ += rtc::TimeMicros() - start_us;
+
+		if (result != Z_STREAM_END || inflate_->avail_out != 0)
+		{
+			++messages_dropped_;
+			return false;
+		}
+		*message = webrtc::DataBuffer(decompressed, encoded.binary);
+		++messages_decompressed_;
+		return true;
+	}
+
+	rtc::CopyOnWriteBuffer& ChannelCompressor::PooledBuffer(size_t size)
+	{
+		auto& buffer = pool_[next_pooled_];
+		next_pooled_ = (next_pooled_ + 1) % pool_.size();
+
+		// Clear keeps the memory unless the application still holds the previous message, it allocates
+		// a buffer of its own then. Either way the entry is the only reference afterwards.
+		const auto* previous = buffer.cdata();
+		buffer.Clear();
+		if (previous && buffer.cdata() == previous && buffer.capacity() >= size)
+		{
+			++pool_hits_;
+		}
+		buffer.SetSize(size);
+		return buffer;
+	}
+
+	RtcCompressionStats ChannelCompressor::GetStats() const
+	{
+		RtcCompressionStats stats{};
+		{
+			rtc::CritScope lock(&deflate_crit_);
+			stats.messagesCompressed = messages_compressed_;
+			stats.messagesSkipped = messages_skipped_;
+			stats.bytesIn = bytes_in_;
+			stats.bytesOut = bytes_out_;
+			stats.ratio = ratio_;
+			stats.compressUs = compress_us_;
+		}
+		rtc::CritScope lock(&inflate_crit_);
+		stats.messagesDecompressed = messages_decompressed_;
+		stats.messagesDropped = messages_dropped_;
+		stats.decompressUs = decompress_us_;
+		stats.poolHits = pool_hits_;
+		return stats;
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "api/data_channel_interface.h"
+#include "rtc_base/critical_section.h"
+
+#include <memory>
+#include <vector>
+
+struct z_stream_s;
+
+namespace Spitfire
+{
+	// Channels whose protocol contains this token deflate their messages on both ends.
+	static const char kDeflateProtocol[] = "sf-deflate";
+
+	struct RtcCompressionOptions
+	{
+		// Messages below this size are always sent as they are.
+		uint32_t minimumSize = 256;
+		// zlib level, 1 favors speed which is what a live channel wants.
+		int32_t level = 1;
+		// Compression is paused once the compressed size stays above this share of the original.
+		double maximumRatio = 0.9;
+		// Messages to send uncompressed after a poor ratio before trying again.
+		uint32_t backoffMessages = 64;
+		// Compressed messages claiming a larger original size are dropped.
+		uint32_t maximumMessageSize = 64 * 1024 * 1024;
+	};
+
+	struct RtcCompressionStats
+	{
+		uint64_t messagesCompressed;
+		// messages sent as they are because they were small or compression was backing off
+		uint64_t messagesSkipped;
+		uint64_t bytesIn;
+		uint64_t bytesOut;
+		// compressed size over original size of the recent messages
+		double ratio;
+		// time spent inside zlib, the work never blocks so this is CPU time
+		int64_t compressUs;
+		uint64_t messagesDecompressed;
+		uint64_t messagesDropped;
+		int64_t decompressUs;
+		// decompressions that reused a pooled buffer instead of allocating
+		uint64_t poolHits;
+	};
+
+	// Deflates outgoing messages of one data channel and inflates incoming ones.
+	// Every message starts with a one byte codec tag, compressed ones also carry their original size,
+	// so each message is decoded on its own and a skipped message costs a single byte.
+	class ChannelCompressor
+	{
+	public:
+		explicit ChannelCompressor(const RtcCompressionOptions& options);
+		~ChannelCompressor();
+
+		ChannelCompressor(const ChannelCompressor&) = delete;
+		ChannelCompressor& operator=(const ChannelCompressor&) = delete;
+
+		// Fills |encoded| with the tagged, possibly compressed |message|, can be called from any thread.
+		void Compress(const webrtc::DataBuffer& message, webrtc::DataBuffer* encoded);
+
+		// Restores a received message, returns false when it is malformed.
+		bool Decompress(const webrtc::DataBuffer& encoded, webrtc::DataBuffer* message);
+
+		RtcCompressionStats GetStats() const;
+
+	private:
+		enum Codec : uint8_t
+		{
+			kRaw = 0,
+			kDeflate = 1
+		};
+
+		static const size_t kHeaderSize = 5;
+		static const size_t kPoolSize = 8;
+
+		void Tag(const webrtc::DataBuffer& message, webrtc::DataBuffer* encoded);
+		// The next pool entry sized to |size|, to be written before it is shared.
+		rtc::CopyOnWriteBuffer& PooledBuffer(size_t size);
+
+		const RtcCompressionOptions options_;
+
+		std::unique_ptr<z_stream_s> deflate_;
+		uint32_t backoff_ = 0;
+		double ratio_ = 0;
+		uint64_t messages_compressed_ = 0;
+		uint64_t messages_skipped_ = 0;
+		uint64_t bytes_in_ = 0;
+		uint64_t bytes_out_ = 0;
+		int64_t compress_us_ = 0;
+		rtc::CriticalSection deflate_crit_;
+
+		std::unique_ptr<z_stream_s> inflate_;
+		// output buffers handed out in turn, one is reused once the application let go of it
+		std::vector<rtc::CopyOnWriteBuffer> pool_;
+		size_t next_pooled_ = 0;
+		uint64_t messages_decompressed_ = 0;
+		uint64_t messages_dropped_ = 0;
+		int64_t decompress_us_ = 0;
+		uint64_t pool_hits_ = 0;
+		rtc::CriticalSection inflate_crit_;
+	};
+}
@@ -0,0 +1,278 @@
+#include "ChannelFragmenter.h"
+#include "rtc_base/byte_order.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Spitfire
+{
+	// fragments are only handed to the data channel while it buffers less than this,
+	// enough to keep SCTP busy while leaving the round-robin order intact
+	static const uint64_t kSendWindowBytes = 256 * 1024;
+
+	ChannelFragmenter::ChannelFragmenter(rtc::Thread* thread, rtc::scoped_refptr<webrtc::DataChannelInterface> channel, const RtcFragmentationOptions& options, std::shared_ptr<ChannelMetrics> metrics) :
+		thread_(thread),
+		channel_(channel),
+		options_(options),
+		metrics_(metrics)
+	{
+	}
+
+	bool ChannelFragmenter::Send(webrtc::DataBuffer message, const uint8_t* prefix, size_t prefix_size)
+	{
+		RTC_DCHECK_LE(prefix_size, kMaxPrefixSize);
+		const auto queued_ns = metrics_ ? rtc::TimeNanos() : 0;
+		OutgoingMessage outgoing{ std::move(message), {}, static_cast<uint32_t>(prefix_size), 0, 0, queued_ns };
+		if (prefix_size > 0)
+		{
+			std::memcpy(outgoing.prefix, prefix, prefix_size);
+		}
+		{
+			rtc::CritScope lock(&send_crit_);
+			if (stopped_)
+			{
+				return false;
+			}
+			outgoing.id = next_id_++;
+			queued_bytes_ += outgoing.prefixSize + outgoing.buffer.size();
+			outgoing_.push_back(std::move(outgoing));
+		}
+		SchedulePump();
+		return true;
+	}
+
+	void ChannelFragmenter::SchedulePump()
+	{
+		if (pump_scheduled_.exchange(true))
+		{
+			return;
+		}
+		std::weak_ptr<ChannelFragmenter> weak_self = shared_from_this();
+		thread_->PostTask(RTC_FROM_HERE, [weak_self]
+		{
+			if (auto self = weak_self.lock())
+			{
+				self->pump_scheduled_ = false;
+				self->Pump();
+			}
+		});
+	}
+
+	void ChannelFragmenter::Pump()
+	{
+		RTC_DCHECK(thread_->IsCurrent());
+		webrtc::DataBuffer fragment(std::string{});
+		uint32_t id;
+		uint32_t length;
+		while (channel_->buffered_amount() < kSendWindowBytes && PeekFragment(&fragment, &id, &length))
+		{
+			// the fragment stays queued until the channel took it, a lost one would leave the receiver
+			// holding the partial message for good
+			if (!channel_->Send(fragment))
+			{
+				RTC_LOG(WARNING) << "Unable to send fragment on " << channel_->label();
+				break;
+			}
+			const auto completed_queued_ns = CommitFragment(id, length);
+			if (completed_queued_ns > 0)
+			{
+				metrics_->RecordHandoff(rtc::TimeNanos() - completed_queued_ns);
+			}
+		}
+	}
+
+	bool ChannelFragmenter::PeekFragment(webrtc::DataBuffer* fragment, uint32_t* id, uint32_t* length)
+	{
+		rtc::CritScope lock(&send_crit_);
+		if (outgoing_.empty())
+		{
+			return false;
+		}
+		const auto& message = outgoing_.front();
+
+		const auto total = message.prefixSize + static_cast<uint32_t>(message.buffer.size());
+		*id = message.id;
+		*length = std::min(total - message.offset, options_.fragmentSize);
+		rtc::CopyOnWriteBuffer payload(kHeaderSize + *length);
+		auto* data = payload.data();
+		rtc::SetBE32(data, message.id);
+		rtc::SetBE32(data + 4, message.offset);
+		rtc::SetBE32(data + 8, total);
+		// the part of the prefix left, then the message
+		auto* out = data + kHeaderSize;
+		auto offset = message.offset;
+		auto remaining = *length;
+		if (offset < message.prefixSize)
+		{
+			const auto from_prefix = std::min(message.prefixSize - offset, remaining);
+			std::memcpy(out, message.prefix + offset, from_prefix);
+			out += from_prefix;
+			offset += from_prefix;
+			remaining -= from_prefix;
+		}
+		if (remaining > 0)
+		{
+			std::memcpy(out, message.buffer.data.cdata() + (offset - message.prefixSize), remaining);
+		}
+		*fragment = webrtc::DataBuffer(payload, message.buffer.binary);
+		return true;
+	}
+
+	int64_t ChannelFragmenter::CommitFragment(uint32_t id, uint32_t length)
+	{
+		rtc::CritScope lock(&send_crit_);
+		// Stop may have dropped the message while it was being sent
+		if (outgoing_.empty() || outgoing_.front().id != id)
+		{
+			return 0;
+		}
+		auto message = std::move(outgoing_.front());
+		outgoing_.pop_front();
+
+		message.offset += length;
+		queued_bytes_ -= length;
+		++fragments_sent_;
+		if (message.offset < message.prefixSize + message.buffer.size())
+		{
+			// to the back of the line, every queued message gets one fragment per round
+			outgoing_.push_back(std::move(message));
+			return 0;
+		}
+		return message.queuedNs;
+	}
+
+	bool ChannelFragmenter::Reassemble(const webrtc::DataBuffer& fragment, webrtc::DataBuffer* message)
+	{
+		rtc::CritScope lock(&receive_crit_);
+		const auto* data = fragment.data.cdata();
+		const auto size = fragment.size();
+		if (size < kHeaderSize)
+		{
+			++messages_dropped_;
+			return false;
+		}
+		const auto id = rtc::GetBE32(data);
+		const auto offset = rtc::GetBE32(data + 4);
+		const auto total = rtc::GetBE32(data + 8);
+		const auto length = static_cast<uint32_t>(size - kHeaderSize);
+		const auto last = static_cast<uint64_t>(offset) + length == total;
+		if (static_cast<uint64_t>(offset) + length > total)
+		{
+			++messages_dropped_;
+			return false;
+		}
+
+		if (offset == 0 && last)
+		{
+			// a message in a single fragment is handed on without copying
+			*message = webrtc::DataBuffer(fragment.data.Slice(kHeaderSize, length), fragment.binary);
+			++messages_reassembled_;
+			return true;
+		}
+
+		if (dropped_.count(id) > 0)
+		{
+			if (last)
+			{
+				dropped_.erase(id);
+			}
+			return false;
+		}
+
+		auto partial = incoming_.find(id);
+		if (partial == incoming_.end())
+		{
+			if (total > options_.reassemblyBudget)
+			{
+				RTC_LOG(WARNING) << "Dropping message of " << total << " bytes on " << channel_->label() << ", it exceeds the reassembly budget";
+				Drop(id, last);
+				return false;
+			}
+			// the oldest partial messages make room, on a lossy channel they may never complete
+			while (reassembling_bytes_ + total > options_.reassemblyBudget && !arrival_.empty())
+			{
+				const auto oldest = arrival_.front();
+				arrival_.pop_front();
+				reassembling_bytes_ -= incoming_[oldest].buffer.size();
+				incoming_.erase(oldest);
+				Drop(oldest, false);
+			}
+			IncomingMessage incoming;
+			// preallocated once at full size, fragments are copied straight to their place
+			incoming.buffer = rtc::CopyOnWriteBuffer(total);
+			incoming.received = 0;
+			incoming.binary = fragment.binary;
+			partial = incoming_.emplace(id, std::move(incoming)).first;
+			arrival_.push_back(id);
+			reassembling_bytes_ += total;
+		}
+		else if (partial->second.buffer.size() != total)
+		{
+			++messages_dropped_;
+			return false;
+		}
+
+		auto& incoming = partial->second;
+		std::memcpy(incoming.buffer.data() + offset, data + kHeaderSize, length);
+		incoming.received += length;
+		if (incoming.received < total)
+		{
+			return false;
+		}
+
+		*message = webrtc::DataBuffer(std::move(incoming.buffer), incoming.binary);
+		reassembling_bytes_ -= total;
+		incoming_.erase(partial);
+		arrival_.erase(std::remove(arrival_.begin(), arrival_.end(), id), arrival_.end());
+		++messages_reassembled_;
+		return true;
+	}
+
+	void ChannelFragmenter::Drop(uint32_t id, bool last)
+	{
+		++messages_dropped_;
+		if (!last)
+		{
+			// ids left behind by lost final fragments must not pile up
+			if (dropped_.size() >= kMaxDroppedIds)
+			{
+				dropped_.clear();
+			}
+			dropped_.insert(id);
+		}
+	}
+
+	void ChannelFragmenter::Stop()
+	{
+		{
+			rtc::CritScope lock(&send_crit_);
+			stopped_ = true;
+			outgoing_.clear();
+			queued_bytes_ = 0;
+		}
+		rtc::CritScope lock(&receive_crit_);
+		incoming_.clear();
+		arrival_.clear();
+		dropped_.clear();
+		reassembling_bytes_ = 0;
+	}
+
+	RtcFragmentationStats ChannelFragmenter::GetStats() const
+	{
+		RtcFragmentationStats stats{};
+		{
+			rtc::CritScope lock(&send_crit_);
+			stats.sendingMessages = static_cast<uint32_t>(outgoing_.size());
+			stats.sendingBytes = queued_bytes_;
+			stats.fragmentsSent = fragments_sent_;
+		}
+		rtc::CritScope lock(&receive_crit_);
+		stats.reassemblingMessages = static_cast<uint32_t>(incoming_.size());
+		stats.reassemblingBytes = reassembling_bytes_;
+		stats.messagesReassembled = messages_reassembled_;
+		stats.messagesDropped = messages_dropped_;
+		return stats;
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "api/data_channel_interface.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/thread.h"
+#include "ChannelMetrics.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Spitfire
+{
+	// Channels whose protocol contains this token fragment on both ends.
+	static const char kFragmentedProtocol[] = "sf-frag";
+
+	struct RtcFragmentationOptions
+	{
+		// Largest payload of one fragment, 16KB including the header is what every browser accepts.
+		uint32_t fragmentSize = 16 * 1024 - 12;
+		// Most memory the partially received messages of one channel may hold.
+		uint64_t reassemblyBudget = 64 * 1024 * 1024;
+	};
+
+	struct RtcFragmentationStats
+	{
+		uint32_t sendingMessages;
+		uint64_t sendingBytes;
+		uint64_t fragmentsSent;
+		uint32_t reassemblingMessages;
+		uint64_t reassemblingBytes;
+		uint64_t messagesReassembled;
+		// messages dropped because they did not fit the reassembly budget or arrived malformed
+		uint64_t messagesDropped;
+	};
+
+	// Splits the messages sent on one data channel into fragments prefixed with a 12 byte header
+	// (message id, offset, total length) and puts them back together on receive.
+	// Fragments of queued messages are sent round-robin, so a small message never waits for a large one.
+	// Sending happens on |thread| and only while the channel buffers less than a small window,
+	// the rest waits here instead of in the data channel queue, which closes the channel when it overflows.
+	class ChannelFragmenter : public std::enable_shared_from_this<ChannelFragmenter>
+	{
+	public:
+		static const uint32_t kHeaderSize = 12;
+		static const size_t kMaxPrefixSize = 8;
+
+		ChannelFragmenter(rtc::Thread* thread, rtc::scoped_refptr<webrtc::DataChannelInterface> channel, const RtcFragmentationOptions& options, std::shared_ptr<ChannelMetrics> metrics = std::shared_ptr<ChannelMetrics>());
+
+		ChannelFragmenter(const ChannelFragmenter&) = delete;
+		ChannelFragmenter& operator=(const ChannelFragmenter&) = delete;
+
+		// Queues |message| for sending, can be called from any thread. The |prefix_size| bytes of |prefix|, at
+		// most kMaxPrefixSize, go out in front of it as part of the same message without copying |message| first.
+		bool Send(webrtc::DataBuffer message, const uint8_t* prefix = nullptr, size_t prefix_size = 0);
+
+		// Bytes accepted by Send that have not reached the data channel yet.
+		uint64_t QueuedBytes() const { return queued_bytes_; }
+
+		// Sends more fragments once the channel drained.
+		void OnBufferedAmountChange() { SchedulePump(); }
+
+		// Feeds a received fragment, returns true and fills |message| once a message is complete.
+		bool Reassemble(const webrtc::DataBuffer& fragment, webrtc::DataBuffer* message);
+
+		// Drops everything queued or partially received.
+		void Stop();
+
+		RtcFragmentationStats GetStats() const;
+
+	private:
+		struct OutgoingMessage
+		{
+			webrtc::DataBuffer buffer;
+			uint8_t prefix[kMaxPrefixSize];
+			uint32_t prefixSize;
+			uint32_t id;
+			// into the prefix followed by the buffer
+			uint32_t offset;
+			// when the message was queued, only taken when there are metrics to record to
+			int64_t queuedNs;
+		};
+
+		struct IncomingMessage
+		{
+			rtc::CopyOnWriteBuffer buffer;
+			uint32_t received;
+			bool binary;
+		};
+
+		void SchedulePump();
+		void Pump();
+		// Builds the next fragment without taking it off the queue, CommitFragment does once it was sent.
+		bool PeekFragment(webrtc::DataBuffer* fragment, uint32_t* id, uint32_t* length);
+		// Returns the queue time of the message the fragment completes, zero otherwise.
+		int64_t CommitFragment(uint32_t id, uint32_t length);
+		void Drop(uint32_t id, bool last);
+
+		static const size_t kMaxDroppedIds = 1024;
+
+		rtc::Thread* thread_;
+		rtc::scoped_refptr<webrtc::DataChannelInterface> channel_;
+		const RtcFragmentationOptions options_;
+		std::shared_ptr<ChannelMetrics> metrics_;
+
+		// messages with fragments left to send, served round-robin from the front
+		std::deque<OutgoingMessage> outgoing_;
+		uint32_t next_id_ = 0;
+		std::atomic<uint64_t> queued_bytes_{ 0 };
+		uint64_t fragments_sent_ = 0;
+		rtc::CriticalSection send_crit_;
+
+		// partial messages by id, |arrival_| keeps their ids oldest first
+		std::unordered_map<uint32_t, IncomingMessage> incoming_;
+		std::deque<uint32_t> arrival_;
+		// ids of dropped messages whose remaining fragments are ignored
+		std::unordered_set<uint32_t> dropped_;
+		uint64_t reassembling_bytes_ = 0;
+		uint64_t messages_reassembled_ = 0;
+		uint64_t messages_dropped_ = 0;
+		rtc::CriticalSection receive_crit_;
+
+		std::atomic<bool> pump_scheduled_{ false };
+		bool stopped_ = false;
+	};
+}
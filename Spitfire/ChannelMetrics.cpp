@@ -0,0 +1,66 @@
+#include "ChannelMetrics.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+
+namespace Spitfire
+{
+	ChannelMetrics::ChannelMetrics() :
+		last_drain_ns_(rtc::TimeNanos())
+	{
+	}
+
+	void ChannelMetrics::RecordBuffered(uint64_t buffered_amount, uint64_t bytes_sent)
+	{
+		const auto now_ns = rtc::TimeNanos();
+		const auto sent = bytes_sent - std::min(bytes_sent, last_sctp_bytes_sent_);
+		const auto elapsed_ns = now_ns - last_buffered_ns_;
+		if (last_buffered_ns_ > 0 && sent > 0 && elapsed_ns > 0)
+		{
+			// smoothed, a single callback covers too little data to give a stable rate
+			const auto rate = static_cast<double>(sent) / elapsed_ns;
+			drain_rate_ = drain_rate_ == 0 ? rate : drain_rate_ + (rate - drain_rate_) / 8;
+		}
+		last_sctp_bytes_sent_ = bytes_sent;
+		last_buffered_ns_ = now_ns;
+
+		if (buffered_amount == 0)
+		{
+			buffered_.Record(0);
+		}
+		else if (drain_rate_ > 0)
+		{
+			buffered_.Record(static_cast<int64_t>(buffered_amount / drain_rate_));
+		}
+	}
+
+	RtcChannelMetrics ChannelMetrics::Drain()
+	{
+		rtc::CritScope lock(&drain_crit_);
+		RtcChannelMetrics metrics{};
+		metrics.handoff = handoff_.Drain();
+		metrics.buffered = buffered_.Drain();
+		metrics.receive = receive_.Drain();
+
+		const auto now_ns = rtc::TimeNanos();
+		const auto messages_sent = messages_sent_.load(std::memory_order_relaxed);
+		const auto bytes_sent = bytes_sent_.load(std::memory_order_relaxed);
+		const auto messages_received = messages_received_.load(std::memory_order_relaxed);
+		const auto bytes_received = bytes_received_.load(std::memory_order_relaxed);
+		const auto seconds = static_cast<double>(now_ns - last_drain_ns_) / rtc::kNumNanosecsPerSec;
+		metrics.intervalMs = (now_ns - last_drain_ns_) / rtc::kNumNanosecsPerMillisec;
+		if (seconds > 0)
+		{
+			metrics.messagesSentPerSecond = (messages_sent - last_messages_sent_) / seconds;
+			metrics.bytesSentPerSecond = (bytes_sent - last_bytes_sent_) / seconds;
+			metrics.messagesReceivedPerSecond = (messages_received - last_messages_received_) / seconds;
+			metrics.bytesReceivedPerSecond = (bytes_received - last_bytes_received_) / seconds;
+		}
+		last_drain_ns_ = now_ns;
+		last_messages_sent_ = messages_sent;
+		last_bytes_sent_ = bytes_sent;
+		last_messages_received_ = messages_received;
+		last_bytes_received_ = bytes_received;
+		return metrics;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include "rtc_base/critical_section.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace Spitfire
+{
+	struct RtcChannelMetrics
+	{
+		int32_t channel;
+		// time between the channel taking a message and WebRTC taking it from us, fragmented channels
+		// count a message once its last fragment went out and coalesced ones once its batch did
+		RtcLatencySummary handoff;
+		// how long data waits in the SCTP send queue, the buffered amount over the rate it drains at
+		RtcLatencySummary buffered;
+		// time spent handing a received message to the application
+		RtcLatencySummary receive;
+		// rates over the interval since the previous drain
+		int64_t intervalMs;
+		double messagesSentPerSecond;
+		double bytesSentPerSecond;
+		double messagesReceivedPerSecond;
+		double bytesReceivedPerSecond;
+	};
+
+	// Latency histograms and rates of one data channel. Recording never blocks, draining is meant
+	// to happen about once a second from a single thread for all channels of a peer.
+	class ChannelMetrics
+	{
+	public:
+		ChannelMetrics();
+
+		ChannelMetrics(const ChannelMetrics&) = delete;
+		ChannelMetrics& operator=(const ChannelMetrics&) = delete;
+
+		// A message of |size| bytes entered the channel.
+		void RecordSent(uint64_t size)
+		{
+			messages_sent_.fetch_add(1, std::memory_order_relaxed);
+			bytes_sent_.fetch_add(size, std::memory_order_relaxed);
+		}
+
+		// |messages| messages reached WebRTC |latency_ns| after they entered the channel.
+		void RecordHandoff(int64_t latency_ns, uint32_t messages = 1) { handoff_.Record(latency_ns, messages); }
+
+		// Called from OnBufferedAmountChange, on the thread the data channel lives on.
+		void RecordBuffered(uint64_t buffered_amount, uint64_t bytes_sent);
+
+		// The application spent |duration_ns| on a received message of |size| bytes.
+		void RecordReceived(int64_t duration_ns, uint64_t size)
+		{
+			receive_.Record(duration_ns);
+			messages_received_.fetch_add(1, std::memory_order_relaxed);
+			bytes_received_.fetch_add(size, std::memory_order_relaxed);
+		}
+
+		RtcChannelMetrics Drain();
+
+	private:
+		LatencyHistogram handoff_;
+		LatencyHistogram buffered_;
+		LatencyHistogram receive_;
+
+		std::atomic<uint64_t> messages_sent_{ 0 };
+		std::atomic<uint64_t> bytes_sent_{ 0 };
+		std::atomic<uint64_t> messages_received_{ 0 };
+		std::atomic<uint64_t> bytes_received_{ 0 };
+
+		// drain rate of the SCTP queue in bytes per nanosecond, only touched by RecordBuffered
+		double drain_rate_ = 0;
+		uint64_t last_sctp_bytes_sent_ = 0;
+		int64_t last_buffered_ns_ = 0;
+
+		// counters as of the previous Drain
+		int64_t last_drain_ns_;
+		uint64_t last_messages_sent_ = 0;
+		uint64_t last_bytes_sent_ = 0;
+		uint64_t last_messages_received_ = 0;
+		uint64_t last_bytes_received_ = 0;
+		rtc::CriticalSection drain_crit_;
+	};
+}
@@ -0,0 +1,64 @@
+#include "ConnectionTimeline.h"
+#include "rtc_base/time_utils.h"
+
+namespace Spitfire
+{
+	ConnectionTimeline::ConnectionTimeline()
+	{
+		for (auto& reached : reachedUs_)
+		{
+			reached = 0;
+		}
+	}
+
+	void ConnectionTimeline::Mark(RtcMilestone milestone)
+	{
+		int64_t unset = 0;
+		reachedUs_[static_cast<size_t>(milestone)].compare_exchange_strong(unset, rtc::TimeMicros());
+	}
+
+	bool ConnectionTimeline::Reached(RtcMilestone milestone) const
+	{
+		return reachedUs_[static_cast<size_t>(milestone)] != 0;
+	}
+
+	RtcConnectionTimeline ConnectionTimeline::Get() const
+	{
+		RtcConnectionTimeline timeline{};
+		timeline.startUs = reachedUs_[static_cast<size_t>(RtcMilestone::Started)];
+		for (size_t i = 0; i < kMilestoneCount; ++i)
+		{
+			const int64_t reached = reachedUs_[i];
+			timeline.offsetUs[i] = reached != 0 && timeline.startUs != 0 ? reached - timeline.startUs : -1;
+		}
+		return timeline;
+	}
+
+	const char* ConnectionTimeline::NameOf(RtcMilestone milestone)
+	{
+		switch (milestone)
+		{
+		case RtcMilestone::Started:
+			return "started";
+		case RtcMilestone::DescriptionParsed:
+			return "descriptionParsed";
+		case RtcMilestone::RemoteDescriptionSet:
+			return "remoteDescriptionSet";
+		case RtcMilestone::LocalDescriptionCreated:
+			return "localDescriptionCreated";
+		case RtcMilestone::FirstLocalCandidate:
+			return "firstLocalCandidate";
+		case RtcMilestone::IceChecking:
+			return "iceChecking";
+		case RtcMilestone::IceConnected:
+			return "iceConnected";
+		case RtcMilestone::DtlsConnected:
+			return "dtlsConnected";
+		case RtcMilestone::SctpConnected:
+			return "sctpConnected";
+		case RtcMilestone::ChannelOpen:
+			return "channelOpen";
+		}
+		return "unknown";
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Spitfire
+{
+	// Milestones of bringing up a peer connection, in the order they usually happen.
+	enum class RtcMilestone
+	{
+		// OnOfferRequest got the offer, or CreateOffer was called
+		Started = 0,
+		// the remote description was parsed
+		DescriptionParsed = 1,
+		RemoteDescriptionSet = 2,
+		// the answer, or the offer, was created
+		LocalDescriptionCreated = 3,
+		FirstLocalCandidate = 4,
+		IceChecking = 5,
+		IceConnected = 6,
+		// ICE and DTLS are connected, the peer connection state went to connected
+		DtlsConnected = 7,
+		// the SCTP association is up
+		SctpConnected = 8,
+		// the first data channel is open
+		ChannelOpen = 9
+	};
+
+	const size_t kMilestoneCount = 10;
+
+	struct RtcConnectionTimeline
+	{
+		// rtc::TimeMicros of Started, 0 when the peer did not start connecting yet
+		int64_t startUs;
+		// microseconds from Started to each milestone, -1 when it was not reached
+		int64_t offsetUs[kMilestoneCount];
+	};
+
+	// When each milestone of one peer connection was reached, stamped by whichever thread observes it.
+	// Only the first time counts, a peer connects once.
+	class ConnectionTimeline
+	{
+	public:
+		ConnectionTimeline();
+
+		ConnectionTimeline(const ConnectionTimeline&) = delete;
+		ConnectionTimeline& operator=(const ConnectionTimeline&) = delete;
+
+		void Mark(RtcMilestone milestone);
+		bool Reached(RtcMilestone milestone) const;
+		RtcConnectionTimeline Get() const;
+
+		// camelCase name of |milestone|, for reports
+		static const char* NameOf(RtcMilestone milestone);
+
+	private:
+		// rtc::TimeMicros per milestone, 0 until it is reached
+		std::atomic<int64_t> reachedUs_[kMilestoneCount];
+	};
+}
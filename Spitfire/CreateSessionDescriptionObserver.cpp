@@ -1,12 +1,17 @@
 #include "CreateSessionDescriptionObserver.h"
 #include "RtcConductor.h"
+#include "RingTracer.h"
+#include "rtc_base/trace_event.h"
 
 void Spitfire::Observers::CreateSessionDescriptionObserver::OnSuccess(webrtc::SessionDescriptionInterface * desc)
 {
+	TRACE_EVENT_ASYNC_END0(kTraceCategory, "CreateSessionDescription", conductor_);
 	if (!conductor_->peerObserver->peerConnection.get())
 	{
 		return;
 	}
+	conductor_->MarkMilestone(RtcMilestone::LocalDescriptionCreated);
+	TRACE_EVENT0(kTraceCategory, "SetLocalDescription");
 	conductor_->peerObserver->peerConnection->SetLocalDescription(conductor_->setSessionObserver.get(), desc);
 	std::string sdp;
 	desc->ToString(&sdp);
@@ -14,13 +19,16 @@ void Spitfire::Observers::CreateSessionDescriptionObserver::OnSuccess(webrtc::Se
 	{
 		conductor_->onSuccess(desc->type().c_str(), sdp.c_str());
 	}
+	conductor_->NotifyActivity();
 }
 
 void Spitfire::Observers::CreateSessionDescriptionObserver::OnFailure(const std::string & error)
 {
+	TRACE_EVENT_ASYNC_END0(kTraceCategory, "CreateSessionDescription", conductor_);
 	RTC_LOG(LERROR) << error;
 	if (conductor_->onFailure)
 	{
 		conductor_->onFailure(error.c_str());
 	}
+	conductor_->NotifyActivity();
 }
\ No newline at end of file
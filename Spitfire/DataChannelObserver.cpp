@@ -4,24 +4,120 @@
 void Spitfire::Observers::DataChannelObserver::OnStateChange()
 {
 	const auto state = dataChannel->state();
+	channelState = state;
+	TRACE_EVENT_INSTANT2(kTraceCategory, "ChannelState", "channel", handle_, "state", static_cast<int>(state));
+	if (state == webrtc::DataChannelInterface::kOpen)
+	{
+		conductor_->MarkMilestone(RtcMilestone::ChannelOpen);
+		conductor_->OnChannelOpen(handle_);
+	}
 	if (conductor_->onDataChannelState)
 	{
-		conductor_->onDataChannelState(dataChannel->label().c_str(), state);
+		conductor_->onDataChannelState(handle_, label_.c_str(), state);
 	}
+	conductor_->NotifyActivity();
+}
+
+void Spitfire::Observers::DataChannelObserver::SetBufferedAmount(uint64_t amount)
+{
+	conductor_->OnBufferedAmount(bufferedAmount.exchange(amount), amount);
 }
 
 void Spitfire::Observers::DataChannelObserver::OnBufferedAmountChange(uint64_t previous_amount)
 {
+	const auto buffered = dataChannel->buffered_amount();
+	SetBufferedAmount(buffered);
+	if (metrics)
+	{
+		metrics->RecordBuffered(buffered, dataChannel->bytes_sent());
+	}
+	if (fragmenter)
+	{
+		fragmenter->OnBufferedAmountChange();
+	}
+	conductor_->OnChannelDrained(handle_);
 	if (conductor_->onBufferAmountChange)
 	{
-		conductor_->onBufferAmountChange(dataChannel->label().c_str(), previous_amount, dataChannel->buffered_amount(), dataChannel->bytes_sent(), dataChannel->bytes_received());
+		conductor_->onBufferAmountChange(handle_, previous_amount, buffered, dataChannel->bytes_sent(), dataChannel->bytes_received());
+	}
+	// edge triggered, only a sender that was turned away hears about it
+	if (PendingAmount() <= lowWatermark && blocked.exchange(false))
+	{
+		if (conductor_->onWritable)
+		{
+			conductor_->onWritable(handle_);
+		}
+		conductor_->NotifyActivity();
 	}
 }
 
 void Spitfire::Observers::DataChannelObserver::OnMessage(const webrtc::DataBuffer & buffer)
 {
+	TRACE_EVENT1(kTraceCategory, "Receive", "bytes", static_cast<uint64_t>(buffer.size()));
+	if (!fragmenter)
+	{
+		Unbatch(buffer);
+		return;
+	}
+	webrtc::DataBuffer message(rtc::CopyOnWriteBuffer(), buffer.binary);
+	if (fragmenter->Reassemble(buffer, &message))
+	{
+		Unbatch(message);
+	}
+}
+
+void Spitfire::Observers::DataChannelObserver::Unbatch(const webrtc::DataBuffer & buffer)
+{
+	if (!coalescer)
+	{
+		Decode(buffer);
+		return;
+	}
+	if (coalescer->Split(buffer, &batch_))
+	{
+		for (const auto& message : batch_)
+		{
+			Decode(message);
+		}
+		batch_.clear();
+	}
+}
+
+void Spitfire::Observers::DataChannelObserver::Decode(const webrtc::DataBuffer & buffer)
+{
+	if (!compressor)
+	{
+		Deliver(buffer);
+		return;
+	}
+	webrtc::DataBuffer message(rtc::CopyOnWriteBuffer(), buffer.binary);
+	if (compressor->Decompress(buffer, &message))
+	{
+		Deliver(message);
+	}
+}
+
+void Spitfire::Observers::DataChannelObserver::Deliver(const webrtc::DataBuffer & buffer)
+{
+	if (!metrics)
+	{
+		Dispatch(buffer);
+		return;
+	}
+	const auto start_ns = rtc::TimeNanos();
+	Dispatch(buffer);
+	metrics->RecordReceived(rtc::TimeNanos() - start_ns, buffer.size());
+}
+
+void Spitfire::Observers::DataChannelObserver::Dispatch(const webrtc::DataBuffer & buffer)
+{
+	TRACE_EVENT0(kTraceCategory, "Dispatch");
+	if (conductor_->EnqueueInbound(handle_, buffer) || conductor_->DeliverLeased(handle_, buffer))
+	{
+		return;
+	}
 	if (conductor_->onMessage)
 	{
-		conductor_->onMessage(dataChannel->label().c_str(), buffer.data.data(), static_cast<uint32_t>(buffer.size()), buffer.binary);
+		conductor_->onMessage(handle_, buffer.data.data(), static_cast<uint32_t>(buffer.size()), buffer.binary);
 	}
 }
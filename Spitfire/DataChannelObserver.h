@@ -2,6 +2,16 @@
 
 #include "api/peer_connection_interface.h"
 #include "api/data_channel_interface.h"
+#include "ChannelCompressor.h"
+#include "ChannelFragmenter.h"
+#include "ChannelMetrics.h"
+#include "MessageCoalescer.h"
+#include "RingTracer.h"
+#include "rtc_base/time_utils.h"
+#include "rtc_base/trace_event.h"
+
+#include <atomic>
+#include <functional>
 
 namespace Spitfire 
 {
@@ -12,8 +22,14 @@ namespace Spitfire
 		class DataChannelObserver : public webrtc::DataChannelObserver
 		{
 		public:
-			explicit DataChannelObserver(RtcConductor* conductor) :
-				conductor_(conductor)
+			// half of the 16MB a data channel queues before it closes itself
+			static const uint64_t kDefaultHighWatermark = 8 * 1024 * 1024;
+			static const uint64_t kDefaultLowWatermark = 1024 * 1024;
+
+			DataChannelObserver(RtcConductor* conductor, int32_t handle, const std::string& label) :
+				conductor_(conductor),
+				handle_(handle),
+				label_(label)
 			{
 			}
 			~DataChannelObserver() = default;
@@ -27,8 +43,69 @@ namespace Spitfire
 			// The data channel's buffered_amount has changed.
 			void OnBufferedAmountChange(uint64_t previous_amount) override;
 
+			// Hands |buffer| to the compressor, coalescer and fragmenter the channel has, in that order.
+			bool Send(const webrtc::DataBuffer& buffer)
+			{
+				return Forward(buffer, dataChannel, compressor, coalescer, fragmenter, metrics);
+			}
+
+			// What the channel holds back, including what still waits in the coalescer and fragmenter.
+			uint64_t PendingAmount() const
+			{
+				return bufferedAmount + QueuedAmount(coalescer, fragmenter);
+			}
+
+			// Send and the pending amount for components which may outlive the observer, like the send scheduler.
+			std::function<bool(const webrtc::DataBuffer&)> MakeSender() const
+			{
+				auto channel = dataChannel;
+				auto channel_compressor = compressor;
+				auto channel_coalescer = coalescer;
+				auto channel_fragmenter = fragmenter;
+				auto channel_metrics = metrics;
+				return [channel, channel_compressor, channel_coalescer, channel_fragmenter, channel_metrics](const webrtc::DataBuffer& buffer)
+				{
+					return Forward(buffer, channel, channel_compressor, channel_coalescer, channel_fragmenter, channel_metrics);
+				};
+			}
+
+			std::function<uint64_t()> MakePendingAmount() const
+			{
+				auto channel = dataChannel;
+				auto channel_coalescer = coalescer;
+				auto channel_fragmenter = fragmenter;
+				return [channel, channel_coalescer, channel_fragmenter]
+				{
+					return channel->buffered_amount() + QueuedAmount(channel_coalescer, channel_fragmenter);
+				};
+			}
+
+			// Updates |bufferedAmount| and the total of the conductor with it.
+			void SetBufferedAmount(uint64_t amount);
+
+			int32_t handle() const { return handle_; }
+			const std::string& label() const { return label_; }
+
 			rtc::scoped_refptr<webrtc::DataChannelInterface> dataChannel;
 
+			// send side flow control, TrySend refuses to queue beyond |highWatermark| and
+			// onWritable fires once |bufferedAmount| fell back to |lowWatermark|, written through SetBufferedAmount
+			std::atomic<uint64_t> highWatermark{ kDefaultHighWatermark };
+			std::atomic<uint64_t> lowWatermark{ kDefaultLowWatermark };
+			std::atomic<uint64_t> bufferedAmount{ 0 };
+			std::atomic<bool> blocked{ false };
+			// kept by OnStateChange so TrySend does not ask the channel on the signaling thread
+			std::atomic<webrtc::DataChannelInterface::DataState> channelState{ webrtc::DataChannelInterface::kConnecting };
+
+			// set when the channel was negotiated with kFragmentedProtocol
+			std::shared_ptr<ChannelFragmenter> fragmenter;
+			// set when the channel was negotiated with kCoalescedProtocol, sits in front of |fragmenter|
+			std::shared_ptr<MessageCoalescer> coalescer;
+			// set when the channel was negotiated with kDeflateProtocol, sits in front of |coalescer|
+			std::shared_ptr<ChannelCompressor> compressor;
+			// set when the peer has channel metrics enabled, shared with the components above
+			std::shared_ptr<ChannelMetrics> metrics;
+
 			int AddRef() const
 			{
 				return 0;
@@ -39,7 +116,69 @@ namespace Spitfire
 			};
 
 		private:
+			static bool Forward(const webrtc::DataBuffer& buffer,
+				const rtc::scoped_refptr<webrtc::DataChannelInterface>& channel,
+				const std::shared_ptr<ChannelCompressor>& compressor,
+				const std::shared_ptr<MessageCoalescer>& coalescer,
+				const std::shared_ptr<ChannelFragmenter>& fragmenter,
+				const std::shared_ptr<ChannelMetrics>& metrics)
+			{
+				TRACE_EVENT1(kTraceCategory, "Send", "bytes", static_cast<uint64_t>(buffer.size()));
+				int64_t start_ns = 0;
+				if (metrics)
+				{
+					start_ns = rtc::TimeNanos();
+					metrics->RecordSent(buffer.size());
+				}
+				if (compressor)
+				{
+					webrtc::DataBuffer encoded(rtc::CopyOnWriteBuffer(), buffer.binary);
+					compressor->Compress(buffer, &encoded);
+					return Handoff(encoded, channel, coalescer, fragmenter, metrics, start_ns);
+				}
+				return Handoff(buffer, channel, coalescer, fragmenter, metrics, start_ns);
+			}
+
+			// the coalescer and fragmenter record the hand-off themselves once their queue reached the channel
+			static bool Handoff(const webrtc::DataBuffer& buffer,
+				const rtc::scoped_refptr<webrtc::DataChannelInterface>& channel,
+				const std::shared_ptr<MessageCoalescer>& coalescer,
+				const std::shared_ptr<ChannelFragmenter>& fragmenter,
+				const std::shared_ptr<ChannelMetrics>& metrics,
+				int64_t start_ns)
+			{
+				if (coalescer)
+				{
+					return coalescer->Send(buffer);
+				}
+				if (fragmenter)
+				{
+					return fragmenter->Send(buffer);
+				}
+				const auto sent = channel->Send(buffer);
+				if (metrics && sent)
+				{
+					metrics->RecordHandoff(rtc::TimeNanos() - start_ns);
+				}
+				return sent;
+			}
+
+			static uint64_t QueuedAmount(const std::shared_ptr<MessageCoalescer>& coalescer, const std::shared_ptr<ChannelFragmenter>& fragmenter)
+			{
+				return (coalescer ? coalescer->QueuedBytes() : 0) + (fragmenter ? fragmenter->QueuedBytes() : 0);
+			}
+
+			void Deliver(const webrtc::DataBuffer& buffer);
+			void Dispatch(const webrtc::DataBuffer& buffer);
+			void Unbatch(const webrtc::DataBuffer& buffer);
+			void Decode(const webrtc::DataBuffer& buffer);
+
 			RtcConductor* conductor_;
+			const int32_t handle_;
+			// cached so callbacks do not go through the channel proxy for it
+			const std::string label_;
+			// reused for every received batch, messages arrive on one thread
+			std::vector<webrtc::DataBuffer> batch_;
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Spitfire
+{
+	static int HighestBit(uint64_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long bit;
+		_BitScanReverse64(&bit, value);
+		return static_cast<int>(bit);
+#else
+		return 63 - __builtin_clzll(value);
+#endif
+	}
+
+	LatencyHistogram::LatencyHistogram()
+	{
+		for (auto& count : counts_)
+		{
+			count.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	int LatencyHistogram::BucketIndex(int64_t value)
+	{
+		if (value < kSubBuckets)
+		{
+			return static_cast<int>(std::max<int64_t>(value, 0));
+		}
+		const auto bit = HighestBit(static_cast<uint64_t>(std::min(value, kMaxValue)));
+		const auto shift = bit - kSubBucketBits;
+		const auto sub_bucket = static_cast<int>((value >> shift) & (kSubBuckets - 1));
+		return (shift + 1) * kSubBuckets + sub_bucket;
+	}
+
+	int64_t LatencyHistogram::BucketValue(int index)
+	{
+		if (index < kSubBuckets)
+		{
+			return index;
+		}
+		const auto shift = index / kSubBuckets - 1;
+		const auto sub_bucket = index % kSubBuckets;
+		return ((static_cast<int64_t>(kSubBuckets + sub_bucket + 1)) << shift) - 1;
+	}
+
+	void LatencyHistogram::Record(int64_t value_ns, uint32_t count)
+	{
+		value_ns = std::min(std::max<int64_t>(value_ns, 0), kMaxValue);
+		counts_[BucketIndex(value_ns)].fetch_add(count, std::memory_order_relaxed);
+		total_ns_.fetch_add(static_cast<uint64_t>(value_ns) * count, std::memory_order_relaxed);
+		auto max_ns = max_ns_.load(std::memory_order_relaxed);
+		while (value_ns > max_ns && !max_ns_.compare_exchange_weak(max_ns, value_ns, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	RtcLatencySummary LatencyHistogram::Drain()
+	{
+		// most buckets stay empty, reading them first keeps the drain of an idle histogram cheap
+		uint32_t counts[kBuckets];
+		uint64_t total = 0;
+		for (int i = 0; i < kBuckets; ++i)
+		{
+			counts[i] = counts_[i].load(std::memory_order_relaxed) != 0 ? counts_[i].exchange(0, std::memory_order_relaxed) : 0;
+			total += counts[i];
+		}
+
+		RtcLatencySummary summary{};
+		const auto total_ns = total_ns_.exchange(0, std::memory_order_relaxed);
+		const auto max_ns = max_ns_.exchange(0, std::memory_order_relaxed);
+		summary.count = total;
+		if (total == 0)
+		{
+			return summary;
+		}
+		summary.meanNs = static_cast<int64_t>(total_ns / total);
+		summary.maxNs = max_ns;
+
+		struct Target
+		{
+			double quantile;
+			int64_t* value;
+		};
+		const Target targets[] =
+		{
+			{ 0.5, &summary.p50Ns },
+			{ 0.9, &summary.p90Ns },
+			{ 0.99, &summary.p99Ns },
+			{ 0.999, &summary.p999Ns }
+		};
+		uint64_t seen = 0;
+		size_t next = 0;
+		for (int i = 0; i < kBuckets && next < sizeof(targets) / sizeof(targets[0]); ++i)
+		{
+			seen += counts[i];
+			while (next < sizeof(targets) / sizeof(targets[0]) && seen >= targets[next].quantile * total)
+			{
+				// never above the largest sample, the last bucket is wide
+				*targets[next].value = std::min(BucketValue(i), max_ns);
+				++next;
+			}
+		}
+		return summary;
+	}
+}
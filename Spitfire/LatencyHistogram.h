@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Spitfire
+{
+	struct RtcLatencySummary
+	{
+		uint64_t count;
+		int64_t meanNs;
+		int64_t p50Ns;
+		int64_t p90Ns;
+		int64_t p99Ns;
+		int64_t p999Ns;
+		int64_t maxNs;
+	};
+
+	// Log-linear histogram of durations in nanoseconds, in the spirit of HdrHistogram.
+	// Every power of two is split into 16 buckets, so a reported percentile is at most 1/16 above the
+	// real value. Recording is a relaxed atomic increment and never blocks, from any number of threads.
+	class LatencyHistogram
+	{
+	public:
+		// Longer durations, about 68 seconds, are counted in the last bucket.
+		static const int64_t kMaxValue = (int64_t(1) << 36) - 1;
+
+		LatencyHistogram();
+
+		LatencyHistogram(const LatencyHistogram&) = delete;
+		LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+		// Counts |count| samples of |value_ns|.
+		void Record(int64_t value_ns, uint32_t count = 1);
+
+		// Summarizes what was recorded since the previous call and starts over.
+		// Samples recorded meanwhile land in either interval, none is lost. Only one thread may drain.
+		RtcLatencySummary Drain();
+
+	private:
+		static const int kSubBucketBits = 4;
+		static const int kSubBuckets = 1 << kSubBucketBits;
+		static const int kBuckets = (36 - kSubBucketBits + 1) * kSubBuckets;
+
+		static int BucketIndex(int64_t value);
+		// highest value that falls into |index|
+		static int64_t BucketValue(int index);
+
+		std::atomic<uint32_t> counts_[kBuckets];
+		std::atomic<uint64_t> total_ns_{ 0 };
+		std::atomic<int64_t> max_ns_{ 0 };
+	};
+}
@@ -0,0 +1,103 @@
+#include "LeaseTable.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+namespace Spitfire
+{
+	LeaseTable::LeaseTable(uint32_t max_leases, uint64_t max_bytes, int64_t leak_timeout_ms) :
+		slots_(max_leases),
+		max_bytes_(max_bytes),
+		leak_timeout_ms_(leak_timeout_ms)
+	{
+		free_.reserve(max_leases);
+		for (uint32_t i = 0; i < max_leases; ++i)
+		{
+			free_.push_back(max_leases - 1 - i);
+		}
+	}
+
+	uint64_t LeaseTable::Lease(const rtc::CopyOnWriteBuffer& data)
+	{
+		const uint64_t pinned_bytes = data.capacity();
+		rtc::CritScope lock(&crit_);
+		if (free_.empty() || (max_bytes_ > 0 && outstanding_bytes_ + pinned_bytes > max_bytes_))
+		{
+			++fallbacks_;
+			return kInvalidLease;
+		}
+		const auto index = free_.back();
+		free_.pop_back();
+
+		auto& slot = slots_[index];
+		slot.data = data;
+		slot.pinnedBytes = pinned_bytes;
+		slot.leasedAtMs = rtc::TimeMillis();
+		slot.active = true;
+		slot.reported = false;
+		outstanding_bytes_ += pinned_bytes;
+		++leased_;
+		return static_cast<uint64_t>(slot.generation) << 32 | index;
+	}
+
+	bool LeaseTable::Release(uint64_t lease)
+	{
+		const auto index = static_cast<uint32_t>(lease);
+		const auto generation = static_cast<uint32_t>(lease >> 32);
+
+		rtc::CopyOnWriteBuffer data;
+		{
+			rtc::CritScope lock(&crit_);
+			if (index >= slots_.size() || !slots_[index].active || slots_[index].generation != generation)
+			{
+				return false;
+			}
+			auto& slot = slots_[index];
+			// the buffer is freed outside the lock
+			data = std::move(slot.data);
+			slot.active = false;
+			// generation zero would make a handle equal kInvalidLease
+			if (++slot.generation == 0)
+			{
+				slot.generation = 1;
+			}
+			outstanding_bytes_ -= slot.pinnedBytes;
+			++released_;
+			free_.push_back(index);
+		}
+		return true;
+	}
+
+	uint32_t LeaseTable::CheckForLeaks()
+	{
+		const auto now_ms = rtc::TimeMillis();
+		uint32_t found = 0;
+		rtc::CritScope lock(&crit_);
+		for (size_t index = 0; index < slots_.size(); ++index)
+		{
+			auto& slot = slots_[index];
+			if (slot.active && !slot.reported && now_ms - slot.leasedAtMs > leak_timeout_ms_)
+			{
+				slot.reported = true;
+				++found;
+				RTC_LOG(WARNING) << "Lease " << index << " of " << slot.data.size() << " bytes held for " << now_ms - slot.leasedAtMs << "ms, it was probably never released";
+			}
+		}
+		leaked_ += found;
+		return found;
+	}
+
+	RtcLeaseStats LeaseTable::GetStats() const
+	{
+		rtc::CritScope lock(&crit_);
+		RtcLeaseStats stats{};
+		stats.limit = static_cast<uint32_t>(slots_.size());
+		stats.limitBytes = max_bytes_;
+		stats.outstanding = static_cast<uint32_t>(slots_.size() - free_.size());
+		stats.outstandingBytes = outstanding_bytes_;
+		stats.leased = leased_;
+		stats.released = released_;
+		stats.fallbacks = fallbacks_;
+		stats.leaked = leaked_;
+		return stats;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "rtc_base/copy_on_write_buffer.h"
+#include "rtc_base/critical_section.h"
+
+#include <vector>
+
+namespace Spitfire
+{
+	struct RtcLeaseStats
+	{
+		uint32_t limit;
+		// 0 when only the number of leases is limited
+		uint64_t limitBytes;
+		uint32_t outstanding;
+		// the whole receive buffers the leases keep alive, which can be more than the messages they hold
+		uint64_t outstandingBytes;
+		uint64_t leased;
+		uint64_t released;
+		// messages delivered without a lease because either limit was reached
+		uint64_t fallbacks;
+		// leases held longer than the leak timeout, each one is counted once
+		uint64_t leaked;
+	};
+
+	// Keeps received buffers alive on behalf of the application until it releases them.
+	// A lease handle packs the slot index with a generation, so releasing a stale or
+	// duplicated handle can never free a buffer that was leased again in the meantime.
+	class LeaseTable
+	{
+	public:
+		static const uint64_t kInvalidLease = 0;
+
+		// At most |max_leases| are outstanding, keeping at most |max_bytes| alive unless it is 0.
+		LeaseTable(uint32_t max_leases, uint64_t max_bytes, int64_t leak_timeout_ms);
+
+		LeaseTable(const LeaseTable&) = delete;
+		LeaseTable& operator=(const LeaseTable&) = delete;
+
+		// Shares |data| into a new lease, returns kInvalidLease when every slot is taken or its buffer
+		// would take the outstanding bytes past the limit.
+		uint64_t Lease(const rtc::CopyOnWriteBuffer& data);
+
+		// Drops the reference held by |lease|, returns false for unknown or already released handles.
+		bool Release(uint64_t lease);
+
+		// Logs leases held longer than the leak timeout and returns how many were found for the first time.
+		uint32_t CheckForLeaks();
+
+		RtcLeaseStats GetStats() const;
+
+	private:
+		struct Slot
+		{
+			rtc::CopyOnWriteBuffer data;
+			// the capacity of the buffer, all of it stays allocated while the lease holds a reference
+			uint64_t pinnedBytes = 0;
+			uint32_t generation = 1;
+			int64_t leasedAtMs = 0;
+			bool active = false;
+			bool reported = false;
+		};
+
+		std::vector<Slot> slots_;
+		std::vector<uint32_t> free_;
+		const uint64_t max_bytes_;
+		const int64_t leak_timeout_ms_;
+		rtc::CriticalSection crit_;
+
+		uint64_t outstanding_bytes_ = 0;
+		uint64_t leased_ = 0;
+		uint64_t released_ = 0;
+		uint64_t fallbacks_ = 0;
+		uint64_t leaked_ = 0;
+	};
+}
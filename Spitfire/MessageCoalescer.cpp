@@ -0,0 +1,307 @@
+#include "MessageCoalescer.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/task_utils/to_queued_task.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Spitfire
+{
+	// a message length takes at most five bytes as a varint
+	static const size_t kMaxPrefixSize = 5;
+
+	static size_t WriteLength(uint32_t length, uint8_t* prefix)
+	{
+		size_t size = 0;
+		while (length >= 0x80)
+		{
+			prefix[size++] = static_cast<uint8_t>(length | 0x80);
+			length >>= 7;
+		}
+		prefix[size++] = static_cast<uint8_t>(length);
+		return size;
+	}
+
+	static bool ReadLength(const uint8_t* data, size_t available, uint32_t* length, size_t* size)
+	{
+		uint32_t value = 0;
+		for (size_t i = 0; i < std::min(available, kMaxPrefixSize); ++i)
+		{
+			value |= static_cast<uint32_t>(data[i] & 0x7F) << (7 * i);
+			if ((data[i] & 0x80) == 0)
+			{
+				*length = value;
+				*size = i + 1;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	MessageCoalescer::MessageCoalescer(rtc::Thread* thread, rtc::scoped_refptr<webrtc::DataChannelInterface> channel, bool ordered, bool reliable, std::shared_ptr<ChannelFragmenter> fragmenter, const RtcCoalescingOptions& options, std::shared_ptr<ChannelMetrics> metrics) :
+		thread_(thread),
+		channel_(channel),
+		fragmenter_(fragmenter),
+		options_(options),
+		metrics_(metrics),
+		announce_(!fragmenter && ordered && reliable)
+	{
+	}
+
+	bool MessageCoalescer::Send(const webrtc::DataBuffer& message)
+	{
+		const auto now_us = rtc::TimeMicros();
+		const auto size = static_cast<uint32_t>(message.size());
+		uint8_t prefix[kMaxPrefixSize];
+		const auto prefix_size = WriteLength(size, prefix);
+
+		// copying a large message into a batch saves no packets, only the receive side of its announcement
+		// needs the channel to keep the order
+		if (size > 0 && size >= options_.maxBatchBytes / 2 && (fragmenter_ || announce_))
+		{
+			return SendDirect(message, prefix, prefix_size, now_us);
+		}
+
+		auto sealed = false;
+		auto opened = false;
+		uint64_t generation;
+		{
+			rtc::CritScope lock(&crit_);
+			if (stopped_)
+			{
+				return false;
+			}
+			// text and binary messages never share a batch, the batch carries the flag for all of them
+			if (open_.messages > 0 && (open_.binary != message.binary || open_.data.size() + prefix_size + size > options_.maxBatchBytes))
+			{
+				Seal();
+				sealed = true;
+			}
+			if (open_.messages == 0)
+			{
+				open_.data.EnsureCapacity(std::max<size_t>(options_.maxBatchBytes, prefix_size + size));
+				open_.binary = message.binary;
+				open_.firstQueuedUs = now_us;
+				opened = true;
+			}
+			open_.data.AppendData(prefix, prefix_size);
+			open_.data.AppendData(message.data.cdata(), size);
+			++open_.messages;
+			open_.payloadBytes += size;
+			open_.queuedUsSum += now_us;
+			queued_bytes_ += size;
+
+			if (open_.data.size() >= options_.maxBatchBytes)
+			{
+				Seal();
+				sealed = true;
+				opened = false;
+			}
+			generation = generation_;
+		}
+		if (sealed)
+		{
+			ScheduleDrain();
+		}
+		if (opened)
+		{
+			ScheduleWindow(generation);
+		}
+		return true;
+	}
+
+	bool MessageCoalescer::SendDirect(const webrtc::DataBuffer& message, const uint8_t* prefix, size_t prefix_size, int64_t now_us)
+	{
+		{
+			rtc::CritScope lock(&crit_);
+			if (stopped_)
+			{
+				return false;
+			}
+			if (!fragmenter_)
+			{
+				// the open batch, or an empty one, ends in the length of the message that follows it
+				if (open_.messages == 0)
+				{
+					open_.firstQueuedUs = now_us;
+				}
+				open_.data.AppendData(prefix, prefix_size);
+			}
+			Seal();
+
+			Batch direct;
+			// shares the memory of the message, the channel or the fragmenter makes the only copy
+			direct.data = message.data;
+			direct.binary = message.binary;
+			direct.messages = 1;
+			direct.payloadBytes = message.size();
+			direct.firstQueuedUs = now_us;
+			direct.queuedUsSum = now_us;
+			if (fragmenter_)
+			{
+				std::memcpy(direct.prefix, prefix, prefix_size);
+				direct.prefixSize = prefix_size;
+			}
+			sealed_.push_back(std::move(direct));
+			queued_bytes_ += message.size();
+		}
+		ScheduleDrain();
+		return true;
+	}
+
+	void MessageCoalescer::Seal()
+	{
+		// a batch holding only an announcement goes out as well
+		if (open_.messages == 0 && open_.data.size() == 0)
+		{
+			return;
+		}
+		sealed_.push_back(std::move(open_));
+		open_ = Batch();
+		++generation_;
+	}
+
+	void MessageCoalescer::ScheduleWindow(uint64_t generation)
+	{
+		std::weak_ptr<MessageCoalescer> weak_self = shared_from_this();
+		thread_->PostDelayedTask(webrtc::ToQueuedTask([weak_self, generation]
+		{
+			auto self = weak_self.lock();
+			if (!self)
+			{
+				return;
+			}
+			{
+				rtc::CritScope lock(&self->crit_);
+				// the batch filled up and was sent before its window ended
+				if (self->generation_ != generation)
+				{
+					return;
+				}
+				self->Seal();
+			}
+			self->Drain();
+		}), options_.windowMs);
+	}
+
+	void MessageCoalescer::ScheduleDrain()
+	{
+		if (drain_scheduled_.exchange(true))
+		{
+			return;
+		}
+		std::weak_ptr<MessageCoalescer> weak_self = shared_from_this();
+		thread_->PostTask(RTC_FROM_HERE, [weak_self]
+		{
+			if (auto self = weak_self.lock())
+			{
+				self->drain_scheduled_ = false;
+				self->Drain();
+			}
+		});
+	}
+
+	void MessageCoalescer::Drain()
+	{
+		// only ever runs on |thread_|, which keeps the batches in order without holding the lock while sending
+		RTC_DCHECK(thread_->IsCurrent());
+		std::deque<Batch> batches;
+		{
+			rtc::CritScope lock(&crit_);
+			batches.swap(sealed_);
+		}
+		for (auto& batch : batches)
+		{
+			const webrtc::DataBuffer buffer(batch.data, batch.binary);
+			const auto sent = fragmenter_ ? fragmenter_->Send(buffer, batch.prefix, batch.prefixSize) : channel_->Send(buffer);
+			const auto now_us = rtc::TimeMicros();
+			// behind a fragmenter the hand-off is only known once the last fragment went out, it records it
+			if (metrics_ && sent && !fragmenter_ && batch.messages > 0)
+			{
+				const auto latency_us = (now_us * batch.messages - batch.queuedUsSum) / batch.messages;
+				metrics_->RecordHandoff(latency_us * rtc::kNumNanosecsPerMicrosec, batch.messages);
+			}
+
+			rtc::CritScope lock(&crit_);
+			queued_bytes_ -= std::min<uint64_t>(queued_bytes_, batch.payloadBytes);
+			if (!sent)
+			{
+				RTC_LOG(WARNING) << "Unable to send batch of " << batch.messages << " messages on " << channel_->label();
+				continue;
+			}
+			messages_sent_ += batch.messages;
+			++batches_sent_;
+			latency_us_sum_ += now_us * batch.messages - batch.queuedUsSum;
+			max_latency_us_ = std::max(max_latency_us_, now_us - batch.firstQueuedUs);
+		}
+	}
+
+	bool MessageCoalescer::Split(const webrtc::DataBuffer& batch, std::vector<webrtc::DataBuffer>* messages)
+	{
+		messages->clear();
+		if (announced_length_ > 0)
+		{
+			const auto announced = announced_length_;
+			announced_length_ = 0;
+			if (batch.size() == announced)
+			{
+				// the large message the last batch ended with, as it was sent
+				messages->push_back(batch);
+				++messages_received_;
+				return true;
+			}
+		}
+
+		const auto* data = batch.data.cdata();
+		const auto size = batch.size();
+		size_t offset = 0;
+		while (offset < size)
+		{
+			uint32_t length;
+			size_t prefix_size;
+			const auto read = ReadLength(data + offset, size - offset, &length, &prefix_size);
+			// a length with nothing after it announces the next message of the channel
+			if (read && length > 0 && offset + prefix_size == size)
+			{
+				announced_length_ = length;
+				break;
+			}
+			if (!read || length > size - offset - prefix_size)
+			{
+				++malformed_batches_;
+				messages->clear();
+				return false;
+			}
+			offset += prefix_size;
+			messages->emplace_back(batch.data.Slice(offset, length), batch.binary);
+			offset += length;
+		}
+		++batches_received_;
+		messages_received_ += messages->size();
+		return true;
+	}
+
+	void MessageCoalescer::Stop()
+	{
+		rtc::CritScope lock(&crit_);
+		stopped_ = true;
+		open_ = Batch();
+		sealed_.clear();
+		queued_bytes_ = 0;
+	}
+
+	RtcCoalescingStats MessageCoalescer::GetStats() const
+	{
+		rtc::CritScope lock(&crit_);
+		RtcCoalescingStats stats{};
+		stats.messagesSent = messages_sent_;
+		stats.batchesSent = batches_sent_;
+		stats.averageLatencyUs = messages_sent_ > 0 ? latency_us_sum_ / static_cast<int64_t>(messages_sent_) : 0;
+		stats.maxLatencyUs = max_latency_us_;
+		stats.messagesReceived = messages_received_;
+		stats.batchesReceived = batches_received_;
+		stats.malformedBatches = malformed_batches_;
+		return stats;
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "api/data_channel_interface.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/thread.h"
+#include "ChannelFragmenter.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace Spitfire
+{
+	// Channels whose protocol contains this token carry batches on both ends.
+	static const char kCoalescedProtocol[] = "sf-batch";
+
+	struct RtcCoalescingOptions
+	{
+		// How long the first message of a batch may wait for company.
+		int32_t windowMs = 5;
+		// A batch is sent as soon as it holds this many bytes, one packet worth by default.
+		uint32_t maxBatchBytes = 1200;
+	};
+
+	struct RtcCoalescingStats
+	{
+		uint64_t messagesSent;
+		uint64_t batchesSent;
+		// time between a message being sent by the application and its batch reaching the channel
+		int64_t averageLatencyUs;
+		int64_t maxLatencyUs;
+		uint64_t messagesReceived;
+		uint64_t batchesReceived;
+		// batches that could not be split, their messages are lost
+		uint64_t malformedBatches;
+	};
+
+	// Packs small messages sent within a short window into one data channel message, each one
+	// prefixed by its length as a varint, and splits such batches up again on receive.
+	// Batches are sent from |thread|, the thread the data channel lives on, in the order they were sealed.
+	// Messages of half a batch or more are not copied into one. Behind a fragmenter they go out as a batch
+	// of their own with the prefix handed over separately. On an ordered reliable channel the batch before
+	// them ends in their bare length prefix, and the message follows as it is.
+	class MessageCoalescer : public std::enable_shared_from_this<MessageCoalescer>
+	{
+	public:
+		// |ordered| and |reliable| are those of |channel|, passed in so building a coalescer makes no proxy call.
+		MessageCoalescer(rtc::Thread* thread, rtc::scoped_refptr<webrtc::DataChannelInterface> channel, bool ordered, bool reliable, std::shared_ptr<ChannelFragmenter> fragmenter, const RtcCoalescingOptions& options, std::shared_ptr<ChannelMetrics> metrics = std::shared_ptr<ChannelMetrics>());
+
+		MessageCoalescer(const MessageCoalescer&) = delete;
+		MessageCoalescer& operator=(const MessageCoalescer&) = delete;
+
+		// Adds |message| to the open batch, can be called from any thread.
+		bool Send(const webrtc::DataBuffer& message);
+
+		// Bytes accepted by Send that have not reached the channel or fragmenter yet.
+		uint64_t QueuedBytes() const { return queued_bytes_; }
+
+		// Splits a received batch into |messages|, which share its memory. Called for every message the
+		// channel receives, in order, as a message announced by the batch before it arrives on its own.
+		bool Split(const webrtc::DataBuffer& batch, std::vector<webrtc::DataBuffer>* messages);
+
+		// Drops the open and sealed batches.
+		void Stop();
+
+		RtcCoalescingStats GetStats() const;
+
+	private:
+		struct Batch
+		{
+			rtc::CopyOnWriteBuffer data;
+			bool binary = false;
+			uint32_t messages = 0;
+			// message bytes without their length prefixes
+			uint64_t payloadBytes = 0;
+			int64_t firstQueuedUs = 0;
+			// sum of the times its messages were queued, for their average latency
+			int64_t queuedUsSum = 0;
+			// set for a single large message sent without copying, the fragmenter puts it in front
+			uint8_t prefix[ChannelFragmenter::kMaxPrefixSize];
+			size_t prefixSize = 0;
+		};
+
+		bool SendDirect(const webrtc::DataBuffer& message, const uint8_t* prefix, size_t prefix_size, int64_t now_us);
+		void Seal();
+		void ScheduleDrain();
+		void Drain();
+		void ScheduleWindow(uint64_t generation);
+
+		rtc::Thread* thread_;
+		rtc::scoped_refptr<webrtc::DataChannelInterface> channel_;
+		std::shared_ptr<ChannelFragmenter> fragmenter_;
+		const RtcCoalescingOptions options_;
+		std::shared_ptr<ChannelMetrics> metrics_;
+		// large messages may follow their announcement as separate channel messages
+		const bool announce_;
+
+		Batch open_;
+		// counts sealed batches, a window timer only seals the batch it was started for
+		uint64_t generation_ = 0;
+		std::deque<Batch> sealed_;
+		std::atomic<uint64_t> queued_bytes_{ 0 };
+		std::atomic<bool> drain_scheduled_{ false };
+		bool stopped_ = false;
+		rtc::CriticalSection crit_;
+
+		uint64_t messages_sent_ = 0;
+		uint64_t batches_sent_ = 0;
+		int64_t latency_us_sum_ = 0;
+		int64_t max_latency_us_ = 0;
+		std::atomic<uint64_t> messages_received_{ 0 };
+		std::atomic<uint64_t> batches_received_{ 0 };
+		std::atomic<uint64_t> malformed_batches_{ 0 };
+		// length of the message announced at the end of the last batch, zero when none is expected
+		uint32_t announced_length_ = 0;
+	};
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace Spitfire
+{
+	// Bounded lock-free queue, safe for any number of producers and consumers.
+	// Every cell carries a sequence number which tells producers and consumers whose turn it is,
+	// so a push or pop is a single compare-and-swap on the shared position in the common case.
+	// The capacity is rounded up to a power of two.
+	template <typename T>
+	class MessageRing
+	{
+	public:
+		explicit MessageRing(size_t capacity)
+		{
+			size_t size = 2;
+			while (size < capacity)
+			{
+				size <<= 1;
+			}
+			mask_ = size - 1;
+			cells_.reset(new Cell[size]);
+			for (size_t i = 0; i < size; ++i)
+			{
+				cells_[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		MessageRing(const MessageRing&) = delete;
+		MessageRing& operator=(const MessageRing&) = delete;
+
+		// Returns false when the ring is full, |item| is left untouched in that case.
+		bool TryPush(T&& item)
+		{
+			auto position = enqueue_position_.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				auto& cell = cells_[position & mask_];
+				const auto sequence = cell.sequence.load(std::memory_order_acquire);
+				const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+				if (difference == 0)
+				{
+					if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						cell.data = std::move(item);
+						cell.sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = enqueue_position_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Returns false when the ring is empty.
+		bool TryPop(T& item)
+		{
+			auto position = dequeue_position_.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				auto& cell = cells_[position & mask_];
+				const auto sequence = cell.sequence.load(std::memory_order_acquire);
+				const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+				if (difference == 0)
+				{
+					if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						item = std::move(cell.data);
+						// drop whatever the cell still references before handing it back to the producers
+						cell.data = T();
+						cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = dequeue_position_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Number of queued items, only exact while no push or pop is in flight.
+		size_t Size() const
+		{
+			const auto enqueued = enqueue_position_.load(std::memory_order_relaxed);
+			const auto dequeued = dequeue_position_.load(std::memory_order_relaxed);
+			return enqueued > dequeued ? enqueued - dequeued : 0;
+		}
+
+		size_t Capacity() const
+		{
+			return mask_ + 1;
+		}
+
+	private:
+		struct Cell
+		{
+			std::atomic<size_t> sequence;
+			T data;
+		};
+
+		std::unique_ptr<Cell[]> cells_;
+		size_t mask_;
+
+		// kept on separate cache lines so producers and the consumer do not share one
+		alignas(64) std::atomic<size_t> enqueue_position_{ 0 };
+		alignas(64) std::atomic<size_t> dequeue_position_{ 0 };
+	};
+}
@@ -8,13 +8,18 @@ void Spitfire::Observers::PeerConnectionObserver::OnSignalingChange(webrtc::Peer
 
 void Spitfire::Observers::PeerConnectionObserver::OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel)
 {
-	if (conductor_->dataObservers.find(channel->label()) == conductor_->dataObservers.end())
+	RTC_LOG(INFO) << __FUNCTION__ << " " << channel->label();
+	const auto handle = conductor_->RegisterDataChannel(channel);
+	if (channel->state() == webrtc::DataChannelInterface::kOpen)
 	{
-		RTC_LOG(INFO) << __FUNCTION__ << " " << channel->label();
-		conductor_->dataObservers[channel->label()] = new DataChannelObserver(conductor_);
-		conductor_->dataObservers[channel->label()]->dataChannel = channel.get();
-		conductor_->dataObservers[channel->label()]->dataChannel->RegisterObserver(conductor_->dataObservers[channel->label()]);
+		conductor_->MarkMilestone(Spitfire::RtcMilestone::ChannelOpen);
 	}
+	// remote channels arrive already open, report it so the application learns their handle
+	if (conductor_->onDataChannelState)
+	{
+		conductor_->onDataChannelState(handle, channel->label().c_str(), channel->state());
+	}
+	conductor_->NotifyActivity();
 }
 
 void Spitfire::Observers::PeerConnectionObserver::OnRenegotiationNeeded()
@@ -24,23 +29,46 @@ void Spitfire::Observers::PeerConnectionObserver::OnRenegotiationNeeded()
 
 void Spitfire::Observers::PeerConnectionObserver::OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state)
 {
+	if (new_state == webrtc::PeerConnectionInterface::kIceConnectionChecking)
+	{
+		conductor_->MarkMilestone(Spitfire::RtcMilestone::IceChecking);
+	}
+	else if (new_state == webrtc::PeerConnectionInterface::kIceConnectionConnected || new_state == webrtc::PeerConnectionInterface::kIceConnectionCompleted)
+	{
+		conductor_->MarkMilestone(Spitfire::RtcMilestone::IceConnected);
+	}
 	if (conductor_->onIceStateChange)
 	{
 		conductor_->onIceStateChange(new_state);
 	}
+	conductor_->NotifyActivity();
+}
+
+void Spitfire::Observers::PeerConnectionObserver::OnConnectionChange(webrtc::PeerConnectionInterface::PeerConnectionState new_state)
+{
+	if (new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kConnected)
+	{
+		conductor_->MarkMilestone(Spitfire::RtcMilestone::DtlsConnected);
+	}
 }
 
 void Spitfire::Observers::PeerConnectionObserver::OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state)
 {
+	if (new_state == webrtc::PeerConnectionInterface::kIceGatheringComplete)
+	{
+		conductor_->OnGatheringComplete();
+	}
 	if (conductor_->onIceGatheringStateChange) 
 	{
 		conductor_->onIceGatheringStateChange(new_state);
 	}
+	conductor_->NotifyActivity();
 }
 
 void Spitfire::Observers::PeerConnectionObserver::OnIceCandidate(const webrtc::IceCandidateInterface * candidate)
 {
 	RTC_LOG(INFO) << __FUNCTION__ << " " << candidate->sdp_mline_index();
+	conductor_->MarkMilestone(Spitfire::RtcMilestone::FirstLocalCandidate);
 
 	std::string sdp;
 	if (!candidate->ToString(&sdp))
@@ -48,8 +76,24 @@ void Spitfire::Observers::PeerConnectionObserver::OnIceCandidate(const webrtc::I
 		RTC_LOG(LS_ERROR) << "Failed to serialize candidate";
 		return;
 	}
-	if (conductor_->onIceCandidate)
+	// filled before batching, so batched candidates come with their fields as well
+	Spitfire::RtcCandidateFields fields;
+	const auto with_fields = static_cast<bool>(conductor_->onIceCandidateFields);
+	if (with_fields)
+	{
+		Spitfire::CandidateParser::Fill(candidate->candidate(), &fields);
+	}
+	if (conductor_->BatchIceCandidate(candidate->sdp_mid(), candidate->sdp_mline_index(), sdp, with_fields ? &fields : nullptr))
+	{
+		return;
+	}
+	if (with_fields)
+	{
+		conductor_->onIceCandidateFields(candidate->sdp_mid().c_str(), candidate->sdp_mline_index(), sdp.c_str(), &fields);
+	}
+	else if (conductor_->onIceCandidate)
 	{
 		conductor_->onIceCandidate(candidate->sdp_mid().c_str(), candidate->sdp_mline_index(), sdp.c_str());
 	}
+	conductor_->NotifyActivity();
 }
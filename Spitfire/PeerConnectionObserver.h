@@ -41,6 +41,9 @@ namespace Spitfire
 			// Called any time the IceConnectionState changes
 			void OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state) override;
 
+			// Called any time the PeerConnectionState changes, connected means ICE and DTLS are.
+			void OnConnectionChange(webrtc::PeerConnectionInterface::PeerConnectionState new_state) override;
+
 			// Called any time the IceGatheringState changes
 			void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state) override;
 
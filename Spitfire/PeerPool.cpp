@@ -0,0 +1,140 @@
+#include "PeerPool.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+
+namespace Spitfire
+{
+	PeerPool::PeerPool(std::shared_ptr<RtcEngine> engine, const RtcPeerPoolOptions& options) :
+		engine_(engine ? std::move(engine) : RtcEngine::Shared()),
+		options_(options),
+		thread_(rtc::Thread::Create())
+	{
+		thread_->SetName("peer_pool_thread", nullptr);
+		RTC_CHECK(thread_->Start()) << "Failed to start peer pool thread";
+		{
+			rtc::CritScope lock(&crit_);
+			ScheduleRefill();
+		}
+
+		const auto interval_ms = std::max<int64_t>(options_.maxIdleMs / 4, 100);
+		thread_->Invoke<void>(RTC_FROM_HERE, [this, interval_ms]
+		{
+			expire_ = webrtc::RepeatingTaskHandle::DelayedStart(thread_.get(), webrtc::TimeDelta::ms(interval_ms), [this, interval_ms]
+			{
+				Expire();
+				return webrtc::TimeDelta::ms(interval_ms);
+			});
+		});
+	}
+
+	PeerPool::~PeerPool()
+	{
+		stopping_ = true;
+		thread_->Invoke<void>(RTC_FROM_HERE, [this]
+		{
+			expire_.Stop();
+		});
+		thread_->Stop();
+	}
+
+	std::unique_ptr<RtcConductor> PeerPool::Acquire()
+	{
+		rtc::CritScope lock(&crit_);
+		if (peers_.empty())
+		{
+			++misses_;
+			ScheduleRefill();
+			return nullptr;
+		}
+		auto peer = std::move(peers_.front().peer);
+		peers_.pop_front();
+		++hits_;
+		ScheduleRefill();
+		return peer;
+	}
+
+	void PeerPool::Expire()
+	{
+		// closed once crit_ is released, closing waits for the engine threads
+		std::vector<std::unique_ptr<RtcConductor>> stale;
+		{
+			rtc::CritScope lock(&crit_);
+			const auto now_ms = rtc::TimeMillis();
+			while (!peers_.empty() && now_ms - peers_.front().builtMs > options_.maxIdleMs)
+			{
+				stale.push_back(std::move(peers_.front().peer));
+				peers_.pop_front();
+				++expired_;
+			}
+			ScheduleRefill();
+		}
+	}
+
+	void PeerPool::ScheduleRefill()
+	{
+		// crit_ is held
+		if (refilling_ || peers_.size() >= options_.peers)
+		{
+			return;
+		}
+		refilling_ = true;
+		thread_->PostTask(RTC_FROM_HERE, [this] { Refill(); });
+	}
+
+	void PeerPool::Refill()
+	{
+		// one at a time, so the pool is usable while it fills and stopping does not wait for all of them
+		while (!stopping_)
+		{
+			{
+				rtc::CritScope lock(&crit_);
+				if (peers_.size() >= options_.peers)
+				{
+					refilling_ = false;
+					return;
+				}
+			}
+
+			const auto start_ns = rtc::TimeNanos();
+			std::unique_ptr<RtcConductor> peer(new RtcConductor(engine_));
+			// the pool thread does not pump messages, the engine threads have to drive the peer
+			peer->SetMessagePump(RtcMessagePump::Engine);
+			peer->SetIceCandidatePoolSize(options_.iceCandidatePoolSize);
+			for (const auto& server : options_.servers)
+			{
+				peer->AddServerConfig(server.uri, server.username, server.password);
+			}
+			if (options_.configure)
+			{
+				options_.configure(*peer);
+			}
+			const auto created = peer->InitializePeerConnection(options_.minPort, options_.maxPort);
+
+			rtc::CritScope lock(&crit_);
+			if (!created)
+			{
+				RTC_LOG(LS_ERROR) << "Unable to create a pooled peer connection";
+				refilling_ = false;
+				return;
+			}
+			peers_.push_back(Idle{ std::move(peer), rtc::TimeMillis() });
+			++built_;
+			build_ns_ += rtc::TimeNanos() - start_ns;
+		}
+	}
+
+	RtcPeerPoolStats PeerPool::GetStats() const
+	{
+		rtc::CritScope lock(&crit_);
+		RtcPeerPoolStats stats{};
+		stats.available = static_cast<uint32_t>(peers_.size());
+		stats.built = built_;
+		stats.hits = hits_;
+		stats.misses = misses_;
+		stats.expired = expired_;
+		stats.buildMeanUs = built_ > 0 ? build_ns_ / static_cast<int64_t>(built_) / rtc::kNumNanosecsPerMicrosec : 0;
+		return stats;
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "RtcConductor.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/task_utils/repeating_task.h"
+#include "rtc_base/thread.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Spitfire
+{
+	struct RtcPeerPoolOptions
+	{
+		// idle peers kept ready
+		uint32_t peers = 4;
+		uint16_t minPort = 0;
+		uint16_t maxPort = 0;
+		// allocator sessions every idle peer gathers candidates for, see RtcConductor::SetIceCandidatePoolSize
+		int32_t iceCandidatePoolSize = 1;
+		// idle peers older than this are replaced, their candidates may no longer match the network.
+		// The pool thread looks for them every quarter of it, so Acquire never has to.
+		int64_t maxIdleMs = 60000;
+		std::vector<webrtc::PeerConnectionInterface::IceServer> servers;
+		// Runs on the pool thread for every peer before its InitializePeerConnection, the place for the
+		// Enable* and Set* calls a peer only takes before it has a peer connection.
+		std::function<void(RtcConductor&)> configure;
+	};
+
+	struct RtcPeerPoolStats
+	{
+		// idle peers ready to be handed out right now
+		uint32_t available;
+		uint64_t built;
+		// accepts that got an idle peer
+		uint64_t hits;
+		// accepts that found the pool empty and have to create their own peer
+		uint64_t misses;
+		// idle peers dropped for being older than maxIdleMs
+		uint64_t expired;
+		// mean time the pool thread spent creating one peer connection
+		int64_t buildMeanUs;
+	};
+
+	// Fully created idle peer connections, built ahead of time on a thread of their own.
+	// Accepting an offer otherwise waits for the peer connection, its port allocator and the first
+	// candidates before the answer can go out. Whatever is taken is refilled in the background.
+	// Pooled peers use RtcMessagePump::Engine and only get the options above, set the callbacks
+	// right after Acquire and before handing the peer the offer. Anything else a peer needs before its
+	// peer connection exists goes into RtcPeerPoolOptions::configure.
+	class PeerPool
+	{
+	public:
+		PeerPool(std::shared_ptr<RtcEngine> engine, const RtcPeerPoolOptions& options);
+		~PeerPool();
+
+		PeerPool(const PeerPool&) = delete;
+		PeerPool& operator=(const PeerPool&) = delete;
+
+		// Hands out the oldest idle peer, or null when the pool ran dry.
+		std::unique_ptr<RtcConductor> Acquire();
+
+		RtcPeerPoolStats GetStats() const;
+
+	private:
+		struct Idle
+		{
+			std::unique_ptr<RtcConductor> peer;
+			int64_t builtMs;
+		};
+
+		void ScheduleRefill();
+		void Refill();
+		// drops the peers idle for longer than maxIdleMs and refills, on the pool thread
+		void Expire();
+
+		const std::shared_ptr<RtcEngine> engine_;
+		const RtcPeerPoolOptions options_;
+		std::unique_ptr<rtc::Thread> thread_;
+		std::atomic<bool> stopping_{ false };
+		webrtc::RepeatingTaskHandle expire_;
+
+		rtc::CriticalSection crit_;
+		// oldest first
+		std::deque<Idle> peers_;
+		bool refilling_ = false;
+		uint64_t built_ = 0;
+		uint64_t hits_ = 0;
+		uint64_t misses_ = 0;
+		uint64_t expired_ = 0;
+		int64_t build_ns_ = 0;
+	};
+}
@@ -0,0 +1,325 @@
+#include "RingTracer.h"
+#include "rtc_base/event_tracer.h"
+#include "rtc_base/platform_thread_types.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/time_utils.h"
+#include "rtc_base/trace_event.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Spitfire
+{
+	static const int kMaxArgs = 2;
+	static const size_t kMaxCategories = 128;
+
+	struct TraceEvent
+	{
+		int64_t timestampUs;
+		const char* category;
+		const char* name;
+		uint64_t id;
+		const char* argNames[kMaxArgs];
+		unsigned long long argValues[kMaxArgs];
+		unsigned char argTypes[kMaxArgs];
+		unsigned char argCount;
+		unsigned char flags;
+		char phase;
+	};
+
+	// Written only by its own thread. |head| counts every event ever recorded, the ring holds the last ones.
+	struct ThreadRing
+	{
+		explicit ThreadRing(uint32_t capacity) :
+			events(capacity)
+		{
+		}
+
+		std::vector<TraceEvent> events;
+		std::atomic<uint64_t> head{ 0 };
+		rtc::PlatformThreadId threadId = 0;
+		std::string threadName;
+	};
+
+	// |enabled| comes first, WebRTC hands us its address back with every event
+	struct TraceCategory
+	{
+		unsigned char enabled;
+		const char* name;
+	};
+
+	static std::mutex tracer_lock;
+	static std::once_flag tracer_installed;
+	static std::vector<std::unique_ptr<ThreadRing>> rings;
+	static uint32_t ring_capacity = 16384;
+	static std::atomic<bool> tracing{ false };
+	static TraceCategory categories[kMaxCategories];
+	static size_t category_count = 0;
+	static unsigned char category_overflow = 0;
+	static thread_local ThreadRing* current_ring = nullptr;
+
+	static bool EnabledByDefault(const char* category)
+	{
+		return std::strncmp(category, "disabled-by-default-", 20) != 0;
+	}
+
+	static const unsigned char* GetCategoryEnabled(const char* name)
+	{
+		// every call site asks once and keeps the pointer
+		std::lock_guard<std::mutex> lock(tracer_lock);
+		for (size_t i = 0; i < category_count; ++i)
+		{
+			if (std::strcmp(categories[i].name, name) == 0)
+			{
+				return &categories[i].enabled;
+			}
+		}
+		if (category_count == kMaxCategories)
+		{
+			return &category_overflow;
+		}
+		auto& category = categories[category_count++];
+		category.name = name;
+		category.enabled = tracing && EnabledByDefault(name) ? 1 : 0;
+		return &category.enabled;
+	}
+
+	static ThreadRing* CurrentRing()
+	{
+		if (!current_ring)
+		{
+			std::lock_guard<std::mutex> lock(tracer_lock);
+			std::unique_ptr<ThreadRing> ring(new ThreadRing(ring_capacity));
+			ring->threadId = rtc::CurrentThreadId();
+			if (auto* thread = rtc::ThreadManager::Instance()->CurrentThread())
+			{
+				ring->threadName = thread->name();
+			}
+			current_ring = ring.get();
+			rings.push_back(std::move(ring));
+		}
+		return current_ring;
+	}
+
+	static void AddTraceEvent(char phase, const unsigned char* category_enabled, const char* name, unsigned long long id,
+		int num_args, const char** arg_names, const unsigned char* arg_types, const unsigned long long* arg_values, unsigned char flags)
+	{
+		if (!tracing.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+		auto* ring = CurrentRing();
+		const auto index = ring->head.load(std::memory_order_relaxed);
+		auto& event = ring->events[index % ring->events.size()];
+		event.timestampUs = rtc::TimeMicros();
+		const auto* category = reinterpret_cast<const TraceCategory*>(category_enabled);
+		event.category = category >= categories && category < categories + kMaxCategories ? category->name : "unknown";
+		// copied names are only valid during the call, the ring only keeps pointers
+		event.name = (flags & TRACE_EVENT_FLAG_COPY) ? "(copied name)" : name;
+		event.id = id;
+		event.argCount = static_cast<unsigned char>(std::min(num_args, kMaxArgs));
+		for (int i = 0; i < event.argCount; ++i)
+		{
+			event.argNames[i] = arg_names[i];
+			event.argTypes[i] = arg_types[i];
+			event.argValues[i] = arg_values[i];
+		}
+		event.flags = flags;
+		event.phase = phase;
+		ring->head.store(index + 1, std::memory_order_release);
+	}
+
+	void RingTracer::Install()
+	{
+		std::call_once(tracer_installed, []
+		{
+			webrtc::SetupEventTracer(&GetCategoryEnabled, &AddTraceEvent);
+		});
+	}
+
+	static void SetCategoriesEnabled(bool enabled)
+	{
+		for (size_t i = 0; i < category_count; ++i)
+		{
+			categories[i].enabled = enabled && EnabledByDefault(categories[i].name) ? 1 : 0;
+		}
+	}
+
+	void RingTracer::Start(uint32_t events_per_thread)
+	{
+		Install();
+		std::lock_guard<std::mutex> lock(tracer_lock);
+		ring_capacity = std::max<uint32_t>(events_per_thread, 1);
+		for (auto& ring : rings)
+		{
+			ring->head = 0;
+		}
+		tracing = true;
+		SetCategoriesEnabled(true);
+	}
+
+	void RingTracer::Stop()
+	{
+		std::lock_guard<std::mutex> lock(tracer_lock);
+		tracing = false;
+		SetCategoriesEnabled(false);
+	}
+
+	bool RingTracer::Enabled()
+	{
+		return tracing;
+	}
+
+	static void AppendEscaped(std::string& json, const char* text)
+	{
+		json += '"';
+		for (const char* c = text ? text : ""; *c; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				json += '\\';
+				json += *c;
+			}
+			else if (static_cast<unsigned char>(*c) < 0x20)
+			{
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+				json += escaped;
+			}
+			else
+			{
+				json += *c;
+			}
+		}
+		json += '"';
+	}
+
+	static void AppendArg(std::string& json, unsigned char type, unsigned long long value)
+	{
+		char number[32];
+		switch (type)
+		{
+		case TRACE_VALUE_TYPE_BOOL:
+			json += value ? "true" : "false";
+			return;
+		case TRACE_VALUE_TYPE_UINT:
+			std::snprintf(number, sizeof(number), "%llu", value);
+			break;
+		case TRACE_VALUE_TYPE_INT:
+			std::snprintf(number, sizeof(number), "%lld", static_cast<long long>(value));
+			break;
+		case TRACE_VALUE_TYPE_DOUBLE:
+		{
+			double real;
+			std::memcpy(&real, &value, sizeof(real));
+			std::snprintf(number, sizeof(number), "%.17g", real);
+			break;
+		}
+		case TRACE_VALUE_TYPE_POINTER:
+			std::snprintf(number, sizeof(number), "\"0x%llx\"", value);
+			break;
+		case TRACE_VALUE_TYPE_STRING:
+			AppendEscaped(json, reinterpret_cast<const char*>(static_cast<uintptr_t>(value)));
+			return;
+		default:
+			// copied strings are gone by now
+			json += "null";
+			return;
+		}
+		json += number;
+	}
+
+	static void AppendEvent(std::string& json, const TraceEvent& event, rtc::PlatformThreadId thread_id)
+	{
+		char header[128];
+		std::snprintf(header, sizeof(header), "{\"pid\":1,\"tid\":%llu,\"ts\":%lld,\"ph\":\"%c\",\"cat\":",
+			static_cast<unsigned long long>(thread_id), static_cast<long long>(event.timestampUs), event.phase);
+		json += header;
+		AppendEscaped(json, event.category);
+		json += ",\"name\":";
+		AppendEscaped(json, event.name);
+		if (event.flags & TRACE_EVENT_FLAG_HAS_ID)
+		{
+			char id[40];
+			std::snprintf(id, sizeof(id), ",\"id\":\"0x%llx\"", static_cast<unsigned long long>(event.id));
+			json += id;
+		}
+		if (event.phase == TRACE_EVENT_PHASE_INSTANT)
+		{
+			json += ",\"s\":\"t\"";
+		}
+		json += ",\"args\":{";
+		for (int i = 0; i < event.argCount; ++i)
+		{
+			if (i > 0)
+			{
+				json += ',';
+			}
+			AppendEscaped(json, event.argNames[i]);
+			json += ':';
+			AppendArg(json, event.argTypes[i], event.argValues[i]);
+		}
+		json += "}}";
+	}
+
+	std::string RingTracer::ToJson()
+	{
+		std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		auto first = true;
+		std::vector<TraceEvent> copy;
+
+		std::lock_guard<std::mutex> lock(tracer_lock);
+		for (auto& ring : rings)
+		{
+			const auto capacity = ring->events.size();
+			const auto end = ring->head.load(std::memory_order_acquire);
+			const auto begin = end > capacity ? end - capacity : 0;
+			copy.clear();
+			for (auto index = begin; index < end; ++index)
+			{
+				copy.push_back(ring->events[index % capacity]);
+			}
+			// the owning thread kept recording, events it overwrote meanwhile are dropped
+			const auto head = ring->head.load(std::memory_order_acquire);
+			const auto valid_begin = head > capacity ? head - capacity : 0;
+			const auto skip = valid_begin > begin ? std::min<uint64_t>(valid_begin - begin, copy.size()) : 0;
+
+			if (!ring->threadName.empty())
+			{
+				json += first ? "" : ",";
+				first = false;
+				char header[96];
+				std::snprintf(header, sizeof(header), "{\"pid\":1,\"tid\":%llu,\"ph\":\"M\",\"name\":\"thread_name\",\"args\":{\"name\":",
+					static_cast<unsigned long long>(ring->threadId));
+				json += header;
+				AppendEscaped(json, ring->threadName.c_str());
+				json += "}}";
+			}
+			for (size_t i = static_cast<size_t>(skip); i < copy.size(); ++i)
+			{
+				json += first ? "" : ",";
+				first = false;
+				AppendEvent(json, copy[i], ring->threadId);
+			}
+		}
+		json += "]}";
+		return json;
+	}
+
+	bool RingTracer::WriteJson(const std::string& path)
+	{
+		const auto json = ToJson();
+		auto* file = std::fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			return false;
+		}
+		const auto written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+		return std::fclose(file) == 0 && written;
+	}
+}
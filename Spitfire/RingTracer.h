@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Spitfire
+{
+	// Category of the trace events Spitfire itself records, next to the ones of WebRTC.
+	static const char kTraceCategory[] = "spitfire";
+
+	// Process-wide event tracer installed through webrtc::SetupEventTracer. Every thread records into
+	// its own ring of the most recent events without taking a lock, so tracing can stay on under load.
+	// The rings are written out in the Chrome trace event format, which about:tracing and Perfetto load.
+	class RingTracer
+	{
+	public:
+		// Routes the trace events of WebRTC and Spitfire here, recording stays off until Start.
+		// Every call site looks its category up only once, so this must run before the first one does.
+		static void Install();
+
+		// Starts recording, keeping the last |events_per_thread| events of each thread.
+		// Previously recorded events are dropped, the ring size only applies to threads that record for the first time.
+		static void Start(uint32_t events_per_thread = 16384);
+		// Stops recording, the recorded events stay available to ToJson.
+		static void Stop();
+		static bool Enabled();
+
+		// Writes the recorded events as a Chrome trace, can be called while recording.
+		static std::string ToJson();
+		static bool WriteJson(const std::string& path);
+	};
+}
@@ -1,22 +1,34 @@
 #include "RtcConductor.h"
+#include "RingTracer.h"
 #include "p2p/client/basic_port_allocator.h"
+#include "rtc_base/trace_event.h"
+#include <algorithm>
 #include <iostream>
 
 using cricket::MediaEngineInterface;
 
 namespace Spitfire
 {
-	RtcConductor::RtcConductor()
+	static std::atomic<uint64_t> next_peer_id{ 1 };
+
+	RtcConductor::RtcConductor(std::shared_ptr<RtcEngine> engine) :
+		engine_(std::move(engine)),
+		affinity_key_(reinterpret_cast<uintptr_t>(this)),
+		peer_id_(next_peer_id++)
 	{
 		onSuccess = nullptr;
 		onFailure = nullptr;
 		onIceCandidate = nullptr;
+		onIceCandidateFields = nullptr;
+		onIceCandidates = nullptr;
 		onDataChannelState = nullptr;
 		onMessage = nullptr;
 		//dataObserver = new Observers::DataChannelObserver(this);
 		peerObserver = new Observers::PeerConnectionObserver(this);
 		sessionObserver = new Observers::CreateSessionDescriptionObserver(this);
-		setSessionObserver = new Observers::SetSessionDescriptionObserver(this);
+		setSessionObserver = new Observers::SetSessionDescriptionObserver(this, false);
+		setRemoteSessionObserver = new Observers::SetSessionDescriptionObserver(this, true);
+		sctp_observer_.reset(new Observers::SctpTransportObserver(this));
 	}
 
 	RtcConductor::~RtcConductor()
@@ -27,6 +39,11 @@ namespace Spitfire
 
 	void RtcConductor::DeletePeerConnection()
 	{
+		if (engine_)
+		{
+			// before anything goes away, a polling round may be asking this peer right now
+			engine_->RemoveStatsSource(peer_id_);
+		}
 		if (peerObserver)
 		{
 			if (peerObserver->peerConnection)
@@ -34,108 +51,147 @@ namespace Spitfire
 				peerObserver->peerConnection->Close();
 			}
 			delete peerObserver;
+			peerObserver = nullptr;
 		}
-		
-		pc_factory_ = nullptr;
-		delete default_socket_factory_.get();
-		delete default_network_manager_.get();
 
-		if (!dataObservers.empty())
+		// loop over all active data channel observers and close them
+		for (size_t handle = 0; handle < channels_.size(); ++handle)
 		{
-			// loop over all active data channel observers and close them
-			for (auto itr = dataObservers.begin(); itr != dataObservers.end(); )
+			if (channels_[handle])
 			{
-				const auto copy_itr = itr;
-				++itr;
-				FinalizeDataChannelClose(copy_itr->first, copy_itr->second);
+				FinalizeDataChannelClose(channels_[handle]);
 			}
-			dataObservers.clear();
 		}
 		serverConfigs.clear();
 
-		RTC_DCHECK(network_thread_ && worker_thread_ && signaling_thread_);
-		network_thread_->Quit();
-		worker_thread_->Quit();
-		signaling_thread_->Quit();
-
-		delete network_thread_.get();
-		delete worker_thread_.get();;
-		delete signaling_thread_.get();;
+		if (scheduler_)
+		{
+			// a pump still posted to the signaling thread only holds a weak reference
+			scheduler_->Stop();
+			scheduler_.reset();
+		}
+		if (candidate_batcher_)
+		{
+			candidate_batcher_->Stop();
+			candidate_batcher_.reset();
+		}
 
+		// hand the borrowed network thread back, the engine itself goes away with its last conductor
+		if (processing_thread_)
+		{
+			processing_thread_->thread->Invoke<void>(RTC_FROM_HERE, [this]
+			{
+				lease_check_.Stop();
+			});
+			if (leases_ && leases_->GetStats().outstanding > 0)
+			{
+				RTC_LOG(WARNING) << leases_->GetStats().outstanding << " leases still outstanding when the peer was deleted";
+			}
+			engine_->ReleaseProcessingThread(processing_thread_);
+			processing_thread_ = nullptr;
+		}
+		closed_.Set();
+		NotifyActivity();
+		engine_.reset();
 
 		delete sessionObserver;
+		sessionObserver = nullptr;
 		delete setSessionObserver;
-		rtc::Thread* current_thread = rtc::ThreadManager::Instance()->CurrentThread();
-		if(current_thread)
-			current_thread->Quit();
+		setSessionObserver = nullptr;
+		delete setRemoteSessionObserver;
+		setRemoteSessionObserver = nullptr;
 
-	
+		if (pump_ == RtcMessagePump::Caller)
+		{
+			rtc::Thread* current_thread = rtc::ThreadManager::Instance()->CurrentThread();
+			if(current_thread)
+				current_thread->Quit();
+		}
 	}
 
-	void RtcConductor::FinalizeDataChannelClose(const std::string& label, Observers::DataChannelObserver* observer)
+	void RtcConductor::FinalizeDataChannelClose(std::shared_ptr<Observers::DataChannelObserver> observer)
 	{
+		{
+			rtc::CritScope lock(&channels_crit_);
+			// closed by another thread in the meantime
+			if (channels_[observer->handle()] != observer)
+				return;
+			dataObservers.erase(observer->label());
+			channels_[observer->handle()] = nullptr;
+		}
+		if (scheduler_)
+		{
+			scheduler_->RemoveChannel(observer->handle());
+		}
+		if (observer->coalescer)
+		{
+			observer->coalescer->Stop();
+		}
+		if (observer->fragmenter)
+		{
+			observer->fragmenter->Stop();
+		}
 		if (observer->dataChannel != nullptr)
 		{
 			// sends the close notification to the remote peer
 			observer->dataChannel->Close();
 			// unregisters the the observer which needs to be done before disposing 
 			observer->dataChannel->UnregisterObserver();
-			delete observer;
 		}
-		dataObservers.erase(label);
+		// no more buffered amount changes arrive, the channel leaves the peer's total
+		observer->SetBufferedAmount(0);
+		// freed once the last sender that found it lets go
 	}
 
 	bool RtcConductor::InitializePeerConnection(uint16_t min_port, uint16_t max_port)
 	{
-		rtc::ThreadManager::Instance()->WrapCurrentThread();
-		RTC_DCHECK(!pc_factory_);
+		if (processing_thread_ && peerObserver && peerObserver->peerConnection)
+		{
+			return true;
+		}
+		if (pump_ == RtcMessagePump::Caller)
+		{
+			rtc::ThreadManager::Instance()->WrapCurrentThread();
+		}
+		RTC_DCHECK(!processing_thread_);
 		RTC_DCHECK(peerObserver && !peerObserver->peerConnection);
 
-		RTC_DCHECK(!network_thread_ && !worker_thread_ && !signaling_thread_);
-		
-		network_thread_ = rtc::Thread::CreateWithSocketServer();
-		network_thread_->SetName("network_thread", nullptr);
-		RTC_CHECK(network_thread_->Start()) << "Failed to start network thread";
-		
-		worker_thread_ = rtc::Thread::Create();
-		worker_thread_->SetName("worker_thread", nullptr);
-		RTC_CHECK(worker_thread_->Start()) << "Failed to start worker thread";
-		
-		signaling_thread_ = rtc::Thread::Create();
-		signaling_thread_->SetName("signaling_thread", nullptr);
-		RTC_CHECK(signaling_thread_->Start()) << "Failed to start signaling thread";
-		
-		
-
-		webrtc::PeerConnectionFactoryDependencies factory_deps;
-		factory_deps.network_thread = network_thread_.get();
-		factory_deps.worker_thread = worker_thread_.get();
-		factory_deps.signaling_thread = signaling_thread_.get();
-
-		pc_factory_ = CreateModularPeerConnectionFactory(std::move(factory_deps));
-		if(pc_factory_)
+		if (!engine_)
 		{
-			default_network_manager_.reset(new rtc::BasicNetworkManager());
-			if(default_network_manager_)
+			engine_ = RtcEngine::Shared();
+		}
+		if (engine_)
+		{
+			processing_thread_ = engine_->AcquireProcessingThread(affinity_key_);
+			if (CreatePeerConnection(min_port, max_port))
 			{
-				default_socket_factory_.reset(new rtc::BasicPacketSocketFactory(network_thread_.get()));
-				if(default_socket_factory_)
+				RTC_DCHECK(peerObserver->peerConnection);
+				if (peerObserver->peerConnection)
 				{
-					default_relay_port_factory_.reset(new cricket::TurnPortFactory());
-					if(default_relay_port_factory_)
+					if (scheduler_budget_ > 0)
 					{
-						webrtc::PeerConnectionFactoryInterface::Options opt;
-						pc_factory_->SetOptions(opt);
-						if(CreatePeerConnection(min_port, max_port))
+						// data channels are proxied to the signaling thread, sending from there skips a hop per message
+						scheduler_ = std::make_shared<SendScheduler>(engine_->SignalingThread(), scheduler_budget_);
+					}
+					if (candidate_batching_)
+					{
+						candidate_batcher_ = std::make_shared<CandidateBatcher>(engine_->SignalingThread(), candidate_batching_options_,
+							[this](const RtcIceCandidate* candidates, uint32_t count, bool complete)
 						{
-							RTC_DCHECK(peerObserver->peerConnection);
-							if(peerObserver->peerConnection)
+							if (onIceCandidates)
 							{
-								RTC_LOG(INFO) << "Peer connection created completed";
-								return true;
+								onIceCandidates(candidates, count, complete);
 							}
-						}
+							NotifyActivity();
+						});
 					}
+					StartLeaseCheck();
+					engine_->AddStatsSource(peer_id_, [this](std::function<void(const RtcPeerStats&)> done)
+					{
+						return GetStats(std::move(done));
+					});
+					RTC_LOG(INFO) << "Peer connection created completed";
+					return true;
 				}
 			}
 		}
@@ -144,9 +200,26 @@ namespace Spitfire
 		return false;
 	}
 
+	void RtcConductor::StartLeaseCheck()
+	{
+		if (!leases_)
+		{
+			return;
+		}
+		const auto interval_ms = lease_check_interval_ms_;
+		processing_thread_->thread->Invoke<void>(RTC_FROM_HERE, [this, interval_ms]
+		{
+			lease_check_ = webrtc::RepeatingTaskHandle::DelayedStart(processing_thread_->thread.get(), webrtc::TimeDelta::ms(interval_ms), [this, interval_ms]
+			{
+				leases_->CheckForLeaks();
+				return webrtc::TimeDelta::ms(interval_ms);
+			});
+		});
+	}
+
 	bool RtcConductor::CreatePeerConnection(uint16_t minPort, uint16_t maxPort)
 	{
-		RTC_DCHECK(pc_factory_);
+		RTC_DCHECK(processing_thread_ && processing_thread_->factory);
 		RTC_DCHECK(peerObserver && !peerObserver->peerConnection);
 
 		webrtc::PeerConnectionInterface::RTCConfiguration config;
@@ -159,27 +232,47 @@ namespace Spitfire
 		config.network_preference = absl::optional<rtc::AdapterType>(rtc::AdapterType::ADAPTER_TYPE_ETHERNET);
 		
 		config.rtcp_mux_policy = webrtc::PeerConnectionInterface::kRtcpMuxPolicyRequire;
+		config.ice_candidate_pool_size = ice_candidate_pool_size_;
 
-		for each (auto server in serverConfigs)
+		for (const auto& server : serverConfigs)
 		{
 			config.servers.push_back(server);
 		}	
 		
 		std::unique_ptr<cricket::PortAllocator> allocator = std::make_unique<cricket::BasicPortAllocator>(
-			default_network_manager_.get(),
-			default_socket_factory_.get(),
+			processing_thread_->networkManager.get(),
+			processing_thread_->socketFactory.get(),
 			config.turn_customizer,
-			default_relay_port_factory_.get());
+			engine_->RelayPortFactory());
 
 		allocator->set_flags(allocator->flags() | cricket::PORTALLOCATOR_DISABLE_TCP);
 		allocator->set_allow_tcp_listen(false);
 		allocator->SetPortRange(minPort, maxPort);
-		peerObserver->peerConnection = pc_factory_->CreatePeerConnection(config, std::move(allocator), nullptr, peerObserver);
+
+		const auto certificate = engine_->SharedCertificate();
+		if (certificate)
+		{
+			config.certificates.push_back(certificate);
+		}
+		peerObserver->peerConnection = processing_thread_->factory->CreatePeerConnection(config, std::move(allocator), engine_->CreateCertificateGenerator(), peerObserver);
 		return peerObserver->peerConnection != nullptr;
 	}
 
 	
 
+	bool RtcConductor::GetStats(std::function<void(const RtcPeerStats&)> done)
+	{
+		if (!peerObserver || !peerObserver->peerConnection)
+			return false;
+
+		RtcPeerStats stats{};
+		stats.peer = peer_id_;
+		// the amounts tracked by the observers, asking the channels would block on the signaling thread
+		stats.bufferedAmount = buffered_amount_;
+		peerObserver->peerConnection->GetStats(new rtc::RefCountedObject<Observers::StatsCollectorObserver>(stats, std::move(done)));
+		return true;
+	}
+
 	void RtcConductor::AddServerConfig(std::string uri, std::string username, std::string password)
 	{
 		webrtc::PeerConnectionInterface::IceServer server;
@@ -195,6 +288,10 @@ namespace Spitfire
 		if (!peerObserver->peerConnection)
 			return;
 
+		TRACE_EVENT0(kTraceCategory, "CreateOffer");
+		MarkMilestone(RtcMilestone::Started);
+		TRACE_EVENT_ASYNC_BEGIN0(kTraceCategory, "CreateSessionDescription", this);
+
 		webrtc::PeerConnectionInterface::RTCOfferAnswerOptions options;
 		options.offer_to_receive_audio = false;
 		options.offer_to_receive_video = false;
@@ -207,6 +304,8 @@ namespace Spitfire
 		if (!peerObserver->peerConnection)
 			return;
 
+		TRACE_EVENT0(kTraceCategory, "SetRemoteDescription");
+
 		webrtc::SdpParseError error;
 		webrtc::SessionDescriptionInterface* session_description(CreateSessionDescription(type, sdp, &error));
 		if (!session_description)
@@ -214,7 +313,8 @@ namespace Spitfire
 			RTC_LOG(WARNING) << "Can't parse received session description message. " << "SdpParseError was: " << error.description;
 			return;
 		}
-		peerObserver->peerConnection->SetRemoteDescription(setSessionObserver, session_description);
+		MarkMilestone(RtcMilestone::DescriptionParsed);
+		peerObserver->peerConnection->SetRemoteDescription(setRemoteSessionObserver, session_description);
 	}
 	
 	void RtcConductor::OnOfferRequest(std::string sdp)
@@ -222,6 +322,9 @@ namespace Spitfire
 		if (!peerObserver->peerConnection)
 			return;
 
+		TRACE_EVENT0(kTraceCategory, "SetRemoteOffer");
+		MarkMilestone(RtcMilestone::Started);
+
 		webrtc::SdpParseError error;
 		webrtc::SessionDescriptionInterface* session_description(CreateSessionDescription("offer", sdp, &error));
 		if (!session_description)
@@ -229,18 +332,46 @@ namespace Spitfire
 			RTC_LOG(WARNING) << "Can't parse received session description message. " << "SdpParseError was: " << error.description;
 			return;
 		}
-		peerObserver->peerConnection->SetRemoteDescription(setSessionObserver, session_description);
+		MarkMilestone(RtcMilestone::DescriptionParsed);
+		peerObserver->peerConnection->SetRemoteDescription(setRemoteSessionObserver, session_description);
 		webrtc::PeerConnectionInterface::RTCOfferAnswerOptions o;
 		{
 			o.voice_activity_detection = false;
 			o.offer_to_receive_audio = false;
 			o.offer_to_receive_video = false;
 		}
+		TRACE_EVENT_ASYNC_BEGIN0(kTraceCategory, "CreateSessionDescription", this);
 		peerObserver->peerConnection->CreateAnswer(sessionObserver, o);
 	}
 
+	void RtcConductor::WatchSctpTransport()
+	{
+		if (sctp_watched_ || !processing_thread_ || !peerObserver || !peerObserver->peerConnection)
+		{
+			return;
+		}
+		// there is no transport until a description with a data section was applied
+		auto transport = peerObserver->peerConnection->GetSctpTransport();
+		if (!transport)
+		{
+			return;
+		}
+		sctp_watched_ = true;
+		auto* observer = sctp_observer_.get();
+		// the transport belongs to the network thread
+		processing_thread_->thread->Invoke<void>(RTC_FROM_HERE, [this, transport, observer]
+		{
+			transport->RegisterObserver(observer);
+			if (transport->Information().state() == webrtc::SctpTransportState::kConnected)
+			{
+				MarkMilestone(RtcMilestone::SctpConnected);
+			}
+		});
+	}
+
 	bool RtcConductor::AddIceCandidate(std::string sdp_mid, int32_t sdp_mlineindex, std::string sdp)
 	{
+		TRACE_EVENT0(kTraceCategory, "AddIceCandidate");
 		webrtc::SdpParseError error;
 		webrtc::IceCandidateInterface * candidate = CreateIceCandidate(sdp_mid, sdp_mlineindex, sdp, &error);
 		if (!candidate)
@@ -261,36 +392,199 @@ namespace Spitfire
 		return true;
 	}
 
-	void RtcConductor::CreateDataChannel(const std::string & label, const webrtc::DataChannelInit dc_options)
+	uint32_t RtcConductor::AddIceCandidates(const RtcIceCandidate* candidates, uint32_t count)
+	{
+		TRACE_EVENT1(kTraceCategory, "AddIceCandidates", "count", count);
+		if (!peerObserver || !peerObserver->peerConnection || !engine_)
+			return 0;
+
+		// parsed on the calling thread, the signaling thread only applies them
+		std::vector<std::unique_ptr<webrtc::IceCandidateInterface>> parsed;
+		parsed.reserve(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			webrtc::SdpParseError error;
+			std::unique_ptr<webrtc::IceCandidateInterface> candidate(CreateIceCandidate(candidates[i].sdpMid ? candidates[i].sdpMid : "",
+				candidates[i].sdpMlineIndex, candidates[i].sdp ? candidates[i].sdp : "", &error));
+			if (!candidate)
+			{
+				RTC_LOG(WARNING) << "Can't parse received candidate message. " << "SdpParseError was: " << error.description;
+				continue;
+			}
+			parsed.push_back(std::move(candidate));
+		}
+
+		// every call on the peer connection proxy is a hop of its own, unless it is made on the signaling thread
+		uint32_t applied = 0;
+		engine_->SignalingThread()->Invoke<void>(RTC_FROM_HERE, [this, &parsed, &applied]
+		{
+			for (const auto& candidate : parsed)
+			{
+				if (peerObserver && peerObserver->peerConnection && peerObserver->peerConnection->AddIceCandidate(candidate.get()))
+				{
+					++applied;
+				}
+				else
+				{
+					RTC_LOG(WARNING) << "Failed to apply the received candidate";
+				}
+			}
+		});
+		return applied;
+	}
+
+	void RtcConductor::EnableCandidateBatching(const RtcCandidateBatchingOptions& options)
+	{
+		candidate_batching_ = true;
+		candidate_batching_options_ = options;
+	}
+
+	bool RtcConductor::BatchIceCandidate(const std::string& sdp_mid, int32_t sdp_mline_index, const std::string& sdp, const RtcCandidateFields* fields)
+	{
+		if (!candidate_batcher_)
+		{
+			return false;
+		}
+		candidate_batcher_->Add(sdp_mid, sdp_mline_index, sdp, fields);
+		return true;
+	}
+
+	void RtcConductor::OnGatheringComplete()
+	{
+		if (candidate_batcher_)
+		{
+			candidate_batcher_->Complete();
+		}
+	}
+
+	int32_t RtcConductor::CreateDataChannel(const std::string & label, const webrtc::DataChannelInit dc_options)
 	{
 		if (!peerObserver->peerConnection)
-			return;
+			return kInvalidChannel;
+
+		TRACE_EVENT0(kTraceCategory, "CreateDataChannel");
+
+		const auto existing = FindDataChannelHandle(label);
+		if (existing != kInvalidChannel)
+			return existing;
 
-		if (dataObservers.find(label) == dataObservers.end()) {
-			dataObservers[label] = new Observers::DataChannelObserver(this);
-			dataObservers[label]->dataChannel = peerObserver->peerConnection->CreateDataChannel(label, &dc_options);
-			dataObservers[label]->dataChannel->RegisterObserver(dataObservers[label]);
-			RTC_LOG(INFO) << "Created data channel " << label;
+		auto channel = peerObserver->peerConnection->CreateDataChannel(label, &dc_options);
+		if (!channel)
+		{
+			RTC_LOG(WARNING) << "Unable to create data channel " << label;
+			return kInvalidChannel;
 		}
+		const auto handle = RegisterDataChannel(channel);
+		RTC_LOG(INFO) << "Created data channel " << label;
+		return handle;
 	}
 
-	void RtcConductor::DataChannelSendText(const std::string & label, const std::string & text)
+	int32_t RtcConductor::RegisterDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel)
 	{
+		// read before channels_crit_, a proxy call waits for the signaling thread which may be registering a channel itself
+		const auto label = channel->label();
+		const auto protocol = channel->protocol();
+
+		std::shared_ptr<ChannelMetrics> metrics;
+		if (channel_metrics_)
+		{
+			metrics = std::make_shared<ChannelMetrics>();
+		}
+		std::shared_ptr<ChannelFragmenter> fragmenter;
+		if (protocol.find(kFragmentedProtocol) != std::string::npos)
+		{
+			// the fragments go out from the signaling thread, where the channel lives
+			fragmenter = std::make_shared<ChannelFragmenter>(engine_->SignalingThread(), channel, fragmentation_options_, metrics);
+		}
+		std::shared_ptr<MessageCoalescer> coalescer;
+		if (protocol.find(kCoalescedProtocol) != std::string::npos)
+		{
+			coalescer = std::make_shared<MessageCoalescer>(engine_->SignalingThread(), channel, channel->ordered(), channel->reliable(), fragmenter, coalescing_options_, metrics);
+		}
+		std::shared_ptr<ChannelCompressor> compressor;
+		if (protocol.find(kDeflateProtocol) != std::string::npos)
+		{
+			compressor = std::make_shared<ChannelCompressor>(compression_options_);
+		}
+
+		std::shared_ptr<Observers::DataChannelObserver> observer;
+		{
+			rtc::CritScope lock(&channels_crit_);
+			const auto existing = dataObservers.find(label);
+			if (existing != dataObservers.end())
+				return existing->second->handle();
+
+			// handles are never reused, so a stale handle can not reach a newer channel
+			const auto handle = static_cast<int32_t>(channels_.size());
+			observer = std::make_shared<Observers::DataChannelObserver>(this, handle, label);
+			observer->dataChannel = channel;
+			observer->metrics = metrics;
+			observer->fragmenter = fragmenter;
+			observer->coalescer = coalescer;
+			observer->compressor = compressor;
+			channels_.push_back(observer);
+			dataObservers[label] = observer;
+		}
+		observer->dataChannel->RegisterObserver(observer.get());
+		if (scheduler_)
+		{
+			scheduler_->AddChannel(observer->handle(), observer->MakeSender(), observer->MakePendingAmount());
+		}
+		// a state change seen by the observer in the meantime is newer than this one
+		const auto state = channel->state();
+		auto connecting = webrtc::DataChannelInterface::kConnecting;
+		observer->channelState.compare_exchange_strong(connecting, state);
+		// after AddChannel, an open event that came earlier did not find the channel in the scheduler
+		if (scheduler_ && state == webrtc::DataChannelInterface::kOpen)
+		{
+			scheduler_->OpenChannel(observer->handle());
+		}
+		return observer->handle();
+	}
+
+	int32_t RtcConductor::FindDataChannelHandle(const std::string& label) const
+	{
+		rtc::CritScope lock(&channels_crit_);
 		const auto observer = dataObservers.find(label);
-		if (observer != dataObservers.end()) {
-			observer->second->dataChannel->Send(webrtc::DataBuffer(text));
+		return observer != dataObservers.end() ? observer->second->handle() : kInvalidChannel;
+	}
+
+	std::shared_ptr<Observers::DataChannelObserver> RtcConductor::FindDataChannel(int32_t channel) const
+	{
+		rtc::CritScope lock(&channels_crit_);
+		if (channel < 0 || static_cast<size_t>(channel) >= channels_.size())
+			return nullptr;
+		return channels_[channel];
+	}
+
+	bool RtcConductor::DataChannelSendText(const std::string & label, const std::string & text)
+	{
+		return DataChannelSendText(FindDataChannelHandle(label), text);
+	}
+
+	bool RtcConductor::DataChannelSendText(int32_t channel, const std::string & text)
+	{
+		const auto observer = FindDataChannel(channel);
+		if (observer) {
+			return observer->Send(webrtc::DataBuffer(text));
 		}
+		return false;
 	}
 
 	RtcDataChannelInfo RtcConductor::GetDataChannelInfo(const std::string& label)
+	{
+		return GetDataChannelInfo(FindDataChannelHandle(label));
+	}
+
+	RtcDataChannelInfo RtcConductor::GetDataChannelInfo(int32_t channel)
 	{
 		auto info = RtcDataChannelInfo();
 
-		const auto observer = dataObservers.find(label);
+		const auto observer = FindDataChannel(channel);
 		
-		if (observer != dataObservers.end()) {
+		if (observer) {
 
-			const auto data_channel = observer->second->dataChannel;
+			const auto data_channel = observer->dataChannel;
 
 			info.id = data_channel->id();
 			info.currentBuffer = data_channel->buffered_amount();
@@ -318,30 +612,388 @@ namespace Spitfire
 
 	webrtc::DataChannelInterface::DataState RtcConductor::GetDataChannelState(const std::string& label)
 	{
-		const auto observer = dataObservers.find(label);
-		if (observer != dataObservers.end()) {
-			return observer->second->dataChannel->state();
+		return GetDataChannelState(FindDataChannelHandle(label));
+	}
+
+	webrtc::DataChannelInterface::DataState RtcConductor::GetDataChannelState(int32_t channel)
+	{
+		const auto observer = FindDataChannel(channel);
+		if (observer) {
+			return observer->dataChannel->state();
 		}
 		return {};
 	}
 
-	
-	void RtcConductor::DataChannelSendData(const std::string& label, uint8_t* data, const uint32_t length)
+	bool RtcConductor::DataChannelSendData(const std::string& label, uint8_t* data, const uint32_t length)
 	{
-		const auto observer = dataObservers.find(label);
-		if (observer != dataObservers.end()) {
+		return DataChannelSendData(FindDataChannelHandle(label), data, length);
+	}
+
+	bool RtcConductor::DataChannelSendData(int32_t channel, uint8_t* data, const uint32_t length)
+	{
+		const auto observer = FindDataChannel(channel);
+		if (observer) {
 			const rtc::CopyOnWriteBuffer write_buffer(data, length);
-			observer->second->dataChannel->Send(webrtc::DataBuffer(write_buffer, true));
+			return observer->Send(webrtc::DataBuffer(write_buffer, true));
 		}
+		return false;
 	}
-	
+
+	void RtcConductor::EnableSendScheduler(uint64_t budget_bytes)
+	{
+		RTC_DCHECK(!peerObserver || !peerObserver->peerConnection);
+		scheduler_budget_ = std::max<uint64_t>(budget_bytes, 1);
+	}
+
+	bool RtcConductor::SetDataChannelPriority(int32_t channel, RtcSendPriority priority, uint32_t weight)
+	{
+		return scheduler_ && scheduler_->SetPriority(channel, priority, weight);
+	}
+
+	bool RtcConductor::ScheduleSend(int32_t channel, const uint8_t* data, uint32_t length, bool binary)
+	{
+		return scheduler_ && scheduler_->Enqueue(channel, webrtc::DataBuffer(rtc::CopyOnWriteBuffer(data, length), binary));
+	}
+
+	RtcSendClassStats RtcConductor::GetSendClassStats(RtcSendPriority priority) const
+	{
+		return scheduler_ ? scheduler_->GetClassStats(priority) : RtcSendClassStats{};
+	}
+
+	void RtcConductor::SetFragmentationOptions(const RtcFragmentationOptions& options)
+	{
+		fragmentation_options_ = options;
+		fragmentation_options_.fragmentSize = std::max(fragmentation_options_.fragmentSize, 1u);
+	}
+
+	RtcFragmentationStats RtcConductor::GetFragmentationStats(int32_t channel) const
+	{
+		const auto observer = FindDataChannel(channel);
+		return observer && observer->fragmenter ? observer->fragmenter->GetStats() : RtcFragmentationStats{};
+	}
+
+	void RtcConductor::SetCoalescingOptions(const RtcCoalescingOptions& options)
+	{
+		coalescing_options_ = options;
+		coalescing_options_.windowMs = std::max(coalescing_options_.windowMs, 0);
+	}
+
+	RtcCoalescingStats RtcConductor::GetCoalescingStats(int32_t channel) const
+	{
+		const auto observer = FindDataChannel(channel);
+		return observer && observer->coalescer ? observer->coalescer->GetStats() : RtcCoalescingStats{};
+	}
+
+	void RtcConductor::SetCompressionOptions(const RtcCompressionOptions& options)
+	{
+		compression_options_ = options;
+		compression_options_.level = std::min(std::max(compression_options_.level, 1), 9);
+	}
+
+	RtcCompressionStats RtcConductor::GetCompressionStats(int32_t channel) const
+	{
+		const auto observer = FindDataChannel(channel);
+		return observer && observer->compressor ? observer->compressor->GetStats() : RtcCompressionStats{};
+	}
+
+	bool RtcConductor::GetChannelMetrics(int32_t channel, RtcChannelMetrics* metrics) const
+	{
+		const auto observer = FindDataChannel(channel);
+		if (!observer || !observer->metrics)
+		{
+			return false;
+		}
+		*metrics = observer->metrics->Drain();
+		metrics->channel = channel;
+		return true;
+	}
+
+	size_t RtcConductor::DrainChannelMetrics(std::vector<RtcChannelMetrics>& metrics, size_t max_count) const
+	{
+		metrics.clear();
+		rtc::CritScope lock(&channels_crit_);
+		const auto count = static_cast<size_t>(std::count_if(channels_.begin(), channels_.end(), [](const std::shared_ptr<Observers::DataChannelObserver>& observer)
+		{
+			return observer && observer->metrics;
+		}));
+		if (count > max_count)
+		{
+			return count;
+		}
+		for (const auto& observer : channels_)
+		{
+			if (observer && observer->metrics)
+			{
+				metrics.push_back(observer->metrics->Drain());
+				metrics.back().channel = observer->handle();
+			}
+		}
+		return count;
+	}
+
+	bool RtcConductor::SetDataChannelWatermarks(int32_t channel, uint64_t high, uint64_t low)
+	{
+		const auto observer = FindDataChannel(channel);
+		if (!observer || low > high)
+		{
+			return false;
+		}
+		observer->highWatermark = high;
+		observer->lowWatermark = low;
+		return true;
+	}
+
+	RtcSendResult RtcConductor::TrySend(int32_t channel, const uint8_t* data, uint32_t length, bool binary)
+	{
+		const auto observer = FindDataChannel(channel);
+		const auto admission = AdmitSend(observer.get(), length);
+		if (admission != RtcSendResult::Sent)
+		{
+			return admission;
+		}
+		return SendAdmitted(observer.get(), webrtc::DataBuffer(rtc::CopyOnWriteBuffer(data, length), binary));
+	}
+
+	RtcSendResult RtcConductor::TrySendBuffer(int32_t channel, int32_t buffer, uint32_t length)
+	{
+		const auto observer = FindDataChannel(channel);
+		const auto admission = AdmitSend(observer.get(), length);
+		if (admission != RtcSendResult::Sent)
+		{
+			if (admission == RtcSendResult::Closed)
+			{
+				ReturnSendBuffer(buffer);
+			}
+			return admission;
+		}
+		rtc::CopyOnWriteBuffer payload;
+		if (!send_pool_ || !send_pool_->Take(buffer, length, &payload))
+		{
+			return RtcSendResult::Closed;
+		}
+		return SendAdmitted(observer.get(), webrtc::DataBuffer(payload, true));
+	}
+
+	RtcSendResult RtcConductor::AdmitSend(Observers::DataChannelObserver* observer, uint32_t length)
+	{
+		// a connecting channel reports its opening through onDataChannelState
+		if (!observer || observer->channelState != webrtc::DataChannelInterface::kOpen)
+		{
+			return RtcSendResult::Closed;
+		}
+		if (observer->PendingAmount() + length <= observer->highWatermark)
+		{
+			return RtcSendResult::Sent;
+		}
+		// arm the writable event before looking again, a drain racing with us then either
+		// shows up in the amount the observer stored before checking the flag or fires the event
+		observer->blocked = true;
+		if (observer->PendingAmount() + length <= observer->highWatermark)
+		{
+			observer->blocked = false;
+			return RtcSendResult::Sent;
+		}
+		return RtcSendResult::WouldBlock;
+	}
+
+	RtcSendResult RtcConductor::SendAdmitted(Observers::DataChannelObserver* observer, const webrtc::DataBuffer& buffer)
+	{
+		if (observer->fragmenter || observer->coalescer)
+		{
+			return observer->Send(buffer) ? RtcSendResult::Queued : RtcSendResult::Closed;
+		}
+		// anything the channel buffered already means this message queues up behind it, taken from the
+		// observer since asking the channel would be another round trip to the signaling thread
+		const auto queued = observer->bufferedAmount > 0;
+		// a compressor alone still sends right away. Send only fails on an open channel when the SCTP send
+		// buffer overflowed, the channel is closing then and no writable event would follow a WouldBlock.
+		if (!observer->Send(buffer))
+		{
+			return RtcSendResult::Closed;
+		}
+		return queued ? RtcSendResult::Queued : RtcSendResult::Sent;
+	}
+
+	void RtcConductor::EnableSendBufferPool(uint32_t buffers, uint32_t buffer_size)
+	{
+		RTC_DCHECK(!peerObserver || !peerObserver->peerConnection);
+		send_pool_.reset(new SendBufferPool(buffers, buffer_size));
+	}
+
+	int32_t RtcConductor::AcquireSendBuffer(uint32_t size, uint8_t** data, uint32_t* capacity)
+	{
+		if (!send_pool_)
+		{
+			return SendBufferPool::kInvalidBuffer;
+		}
+		return send_pool_->Acquire(size, data, capacity);
+	}
+
+	bool RtcConductor::DataChannelSendBuffer(int32_t channel, int32_t buffer, uint32_t length)
+	{
+		rtc::CopyOnWriteBuffer payload;
+		if (!send_pool_ || !send_pool_->Take(buffer, length, &payload))
+		{
+			return false;
+		}
+		const auto observer = FindDataChannel(channel);
+		if (observer) {
+			// the data buffer shares the pool memory, SCTP makes the only copy
+			return observer->Send(webrtc::DataBuffer(payload, true));
+		}
+		return false;
+	}
+
+	void RtcConductor::ReturnSendBuffer(int32_t buffer)
+	{
+		if (send_pool_)
+		{
+			send_pool_->Return(buffer);
+		}
+	}
+
+	RtcSendBufferPoolStats RtcConductor::GetSendBufferPoolStats() const
+	{
+		return send_pool_ ? send_pool_->GetStats() : RtcSendBufferPoolStats{};
+	}
+
 	void RtcConductor::CloseDataChannel(const std::string & label)
 	{
-		const auto observer = dataObservers.find(label);
-		if (observer != dataObservers.end()) {
-			FinalizeDataChannelClose(observer->first, observer->second);
-			RTC_LOG(INFO) << "Closed data channel " << label;
+		CloseDataChannel(FindDataChannelHandle(label));
+	}
+
+	void RtcConductor::CloseDataChannel(int32_t channel)
+	{
+		const auto observer = FindDataChannel(channel);
+		if (observer) {
+			TRACE_EVENT1(kTraceCategory, "CloseDataChannel", "channel", channel);
+			RTC_LOG(INFO) << "Closed data channel " << observer->label();
+			FinalizeDataChannelClose(observer);
 		}
 	}
 
-}
\ No newline at end of file
+	void RtcConductor::EnableInboundQueue(uint32_t capacity, RtcOverflowPolicy policy)
+	{
+		RTC_DCHECK(!peerObserver || !peerObserver->peerConnection);
+		inbound_.reset(new MessageRing<RtcInboundMessage>(capacity));
+		inbound_policy_ = policy;
+	}
+
+	bool RtcConductor::EnqueueInbound(int32_t channel, const webrtc::DataBuffer& buffer)
+	{
+		if (!inbound_)
+		{
+			return false;
+		}
+
+		RtcInboundMessage message;
+		message.channel = channel;
+		message.data = buffer.data;
+		message.binary = buffer.binary;
+
+		const auto deadline_ms = rtc::TimeMillis() + kInboundBlockTimeoutMs;
+		while (!inbound_->TryPush(std::move(message)))
+		{
+			if (inbound_policy_ == RtcOverflowPolicy::DropOldest)
+			{
+				RtcInboundMessage oldest;
+				if (inbound_->TryPop(oldest))
+				{
+					++inbound_dropped_;
+				}
+				continue;
+			}
+			if (inbound_policy_ == RtcOverflowPolicy::Block && !inbound_stalled_)
+			{
+				const auto remaining_ms = deadline_ms - rtc::TimeMillis();
+				if (remaining_ms > 0)
+				{
+					inbound_drained_.Wait(static_cast<int>(remaining_ms));
+					continue;
+				}
+				// the other peers of the engine would stall behind every further message otherwise
+				inbound_stalled_ = true;
+				RTC_LOG(WARNING) << "Inbound queue not drained for " << kInboundBlockTimeoutMs << "ms, dropping messages until it is";
+			}
+			++inbound_dropped_;
+			return true;
+		}
+		++inbound_enqueued_;
+
+		// cheap while the engine has not been woken up yet, so every message can ring it
+		NotifyActivity();
+		return true;
+	}
+
+	void RtcConductor::EnableLeasedReceive(uint32_t max_leases, uint64_t max_bytes, int32_t leak_timeout_ms)
+	{
+		RTC_DCHECK(!peerObserver || !peerObserver->peerConnection);
+		leases_.reset(new LeaseTable(max_leases, max_bytes, leak_timeout_ms));
+		// a leak is noticed within a fraction of the timeout without scanning the table on every message
+		lease_check_interval_ms_ = std::max(leak_timeout_ms / 4, 100);
+	}
+
+	bool RtcConductor::ReleaseLease(uint64_t lease)
+	{
+		return leases_ && leases_->Release(lease);
+	}
+
+	RtcLeaseStats RtcConductor::GetLeaseStats() const
+	{
+		return leases_ ? leases_->GetStats() : RtcLeaseStats{};
+	}
+
+	bool RtcConductor::DeliverLeased(int32_t channel, const webrtc::DataBuffer& buffer)
+	{
+		if (!leases_ || !onLeasedMessage)
+		{
+			return false;
+		}
+		const auto lease = leases_->Lease(buffer.data);
+		if (lease == LeaseTable::kInvalidLease)
+		{
+			// over the limit, the message is only valid for the duration of onMessage
+			return false;
+		}
+		onLeasedMessage(channel, lease, buffer.data.cdata(), static_cast<uint32_t>(buffer.size()), buffer.binary);
+		return true;
+	}
+
+	size_t RtcConductor::DrainMessages(size_t max_count, std::vector<RtcInboundMessage>& batch)
+	{
+		batch.clear();
+		if (!inbound_)
+		{
+			return 0;
+		}
+		if (batch.capacity() < max_count)
+		{
+			batch.reserve(std::min(max_count, inbound_->Capacity()));
+		}
+
+		RtcInboundMessage message;
+		while (batch.size() < max_count && inbound_->TryPop(message))
+		{
+			batch.push_back(std::move(message));
+		}
+		if (inbound_policy_ == RtcOverflowPolicy::Block && !batch.empty())
+		{
+			inbound_stalled_ = false;
+			inbound_drained_.Set();
+		}
+		return batch.size();
+	}
+
+	RtcInboundQueueStats RtcConductor::GetInboundQueueStats() const
+	{
+		RtcInboundQueueStats stats{};
+		if (inbound_)
+		{
+			stats.capacity = static_cast<uint32_t>(inbound_->Capacity());
+			stats.depth = static_cast<uint32_t>(inbound_->Size());
+			stats.enqueued = inbound_enqueued_;
+			stats.dropped = inbound_dropped_;
+		}
+		return stats;
+	}
+}
@@ -7,20 +7,24 @@
 #include "PeerConnectionObserver.h"
 #include "CreateSessionDescriptionObserver.h"
 #include "SetSessionDescriptionObserver.h"
+#include "SctpTransportObserver.h"
+#include "ConnectionTimeline.h"
+#include "CandidateBatcher.h"
+#include "CandidateParser.h"
+#include "RtcEngine.h"
+#include "MessageRing.h"
+#include "SendBufferPool.h"
+#include "LeaseTable.h"
+#include "SendScheduler.h"
 #include "api/peer_connection_interface.h"
-#include "p2p/client/relay_port_factory_interface.h"
-#include "p2p/base/basic_packet_socket_factory.h"
 #include "rtc_base/logging.h"
 #include "rtc_base/log_sinks.h"
 
+#include <cstdint>
+#include <functional>
+
 namespace Spitfire
 {
-	struct ProcessingThread 
-	{
-		std::unique_ptr<rtc::Thread> thread;
-		rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory;
-	};
-
 	struct RtcDataChannelInfo 
 	{
 		uint64_t currentBuffer;
@@ -42,58 +46,297 @@ namespace Spitfire
 		webrtc::DataChannelInterface::DataState state;
 	};
 
+	enum class RtcOverflowPolicy
+	{
+		// The message that does not fit is dropped.
+		DropNewest = 0,
+		// The oldest queued message is dropped to make room.
+		DropOldest = 1,
+		// The WebRTC thread waits up to kInboundBlockTimeoutMs for the application to drain, then drops the message.
+		// After a timeout messages are dropped without waiting until the application drains again.
+		Block = 2
+	};
+
+	// The signaling thread is shared by every peer of an engine, a queue that does not drain may only hold it this long.
+	static const int kInboundBlockTimeoutMs = 10;
+
+	// A received message waiting in the inbound queue, |data| shares the buffer WebRTC handed us.
+	struct RtcInboundMessage
+	{
+		int32_t channel = -1;
+		rtc::CopyOnWriteBuffer data;
+		bool binary = false;
+	};
+
+	struct RtcInboundQueueStats
+	{
+		uint32_t capacity;
+		uint32_t depth;
+		uint64_t enqueued;
+		uint64_t dropped;
+	};
+
+	enum class RtcSendResult
+	{
+		// SCTP took the message.
+		Sent = 0,
+		// The message waits in the data channel queue behind earlier ones.
+		Queued = 1,
+		// The message was not sent because the channel is above its high watermark, wait for onWritable.
+		WouldBlock = 2,
+		// The channel is gone, not open yet or no longer open.
+		Closed = 3
+	};
+
+#if !defined(_WIN32) && !defined(__stdcall)
+	// the calling convention only matters to the managed wrapper, which is Windows only
+#define __stdcall
+#endif
+
 	typedef void(__stdcall *OnErrorCallbackNative)();
 	typedef void(__stdcall *OnSuccessCallbackNative)(const char * type, const char * sdp);
 	typedef void(__stdcall *OnFailureCallbackNative)(const char * error);
 	typedef void(__stdcall *OnIceCandidateCallbackNative)(const char * sdpMid, int32_t sdpIndex, const char * sdp);
-	typedef void(__stdcall *OnMessageCallbackNative)(const char* label, const uint8_t* msg, uint32_t size, bool is_binary);
+	typedef void(__stdcall *OnIceCandidateFieldsCallbackNative)(const char * sdpMid, int32_t sdpIndex, const char * sdp, const RtcCandidateFields* fields);
+	typedef void(__stdcall *OnIceCandidatesCallbackNative)(const RtcIceCandidate* candidates, uint32_t count, bool complete);
+	typedef void(__stdcall *OnMessageCallbackNative)(int32_t channel, const uint8_t* msg, uint32_t size, bool is_binary);
+	typedef void(__stdcall *OnLeasedMessageCallbackNative)(int32_t channel, uint64_t lease, const uint8_t* msg, uint32_t size, bool is_binary);
 	typedef void(__stdcall *OnIceStateChangeCallbackNative)(webrtc::PeerConnectionInterface::IceConnectionState state);
 	typedef void(__stdcall* OnIceGatheringStateCallbackNative)(webrtc::PeerConnectionInterface::IceGatheringState state);
-	typedef void(__stdcall *OnDataChannelStateCallbackNative)(const char * label, webrtc::DataChannelInterface::DataState state);
-	typedef void(__stdcall *OnBufferAmountCallbackNative)(const char * label, uint64_t previousAmount, uint64_t currentAmount, uint64_t bytesSent, uint64_t bytesReceived);
+	typedef void(__stdcall *OnDataChannelStateCallbackNative)(int32_t channel, const char * label, webrtc::DataChannelInterface::DataState state);
+	typedef void(__stdcall *OnWritableCallbackNative)(int32_t channel);
+	typedef void(__stdcall *OnBufferAmountCallbackNative)(int32_t channel, uint64_t previousAmount, uint64_t currentAmount, uint64_t bytesSent, uint64_t bytesReceived);
+	typedef void(__stdcall *OnStatsCallbackNative)(const RtcPeerStats* stats);
+
+	enum class RtcMessagePump
+	{
+		// The application wraps one of its threads and keeps calling ProcessMessages on it.
+		Caller = 0,
+		// Callbacks are driven by the engine threads, ProcessMessages only waits for the peer to close.
+		Engine = 1
+	};
 
 	class RtcConductor
 	{
 	public:
-		RtcConductor();
+		// Peers borrow their threads and factory from |engine|, or from the process-wide engine when none is given.
+		explicit RtcConductor(std::shared_ptr<RtcEngine> engine = nullptr);
 		~RtcConductor();
 
+		// Data channels are addressed by a small integer handle, the label overloads only look it up.
+		static const int32_t kInvalidChannel = -1;
+
+		// Returns true right away when the peer connection already exists, as for peers taken from a PeerPool.
 		bool InitializePeerConnection(uint16_t min_port, uint16_t max_port);
+
+		// Picks the engine network thread when the engine shards by hash, set before InitializePeerConnection.
+		void SetAffinityKey(uint64_t key) { affinity_key_ = key; }
+
 		void CreateOffer();
 		void OnOfferReply(std::string type, std::string sdp);
 		void OnOfferRequest(std::string sdp);
 		bool AddIceCandidate(std::string sdp_mid, int32_t sdp_mlineindex, std::string sdp);
+		// Applies remote candidates with one hop to the signaling thread for all of them, returns how many were applied.
+		uint32_t AddIceCandidates(const RtcIceCandidate* candidates, uint32_t count);
+
+		// Delivers local candidates in batches through onIceCandidates instead of one at a time through
+		// onIceCandidate, the last batch marks the end of candidates. With onIceCandidateFields set as well,
+		// every batched candidate carries its fields. Set before InitializePeerConnection.
+		void EnableCandidateBatching(const RtcCandidateBatchingOptions& options);
+		// Called by the peer connection observer, returns false when the candidate should go to onIceCandidate.
+		bool BatchIceCandidate(const std::string& sdp_mid, int32_t sdp_mline_index, const std::string& sdp, const RtcCandidateFields* fields);
+		// Called by the peer connection observer once gathering completed.
+		void OnGatheringComplete();
+
+		// When this peer reached each milestone of connecting, offsets are relative to the offer arriving
+		// for an answering peer and to CreateOffer for an offering one.
+		RtcConnectionTimeline GetConnectionTimeline() const { return timeline_.Get(); }
+		// Called by the observers as the connection comes up.
+		void MarkMilestone(RtcMilestone milestone) { timeline_.Mark(milestone); }
+		// Starts listening to the SCTP transport once a description created it, called on the signaling thread.
+		void WatchSctpTransport();
+
+		// Selects who drives this peer, set before InitializePeerConnection.
+		void SetMessagePump(RtcMessagePump pump) { pump_ = pump; }
+
+		// Gathers candidates for |size| allocator sessions as soon as the peer connection exists instead of
+		// once the first description is set, so answering an offer does not wait for gathering to start.
+		// Set before InitializePeerConnection, 0 turns it off.
+		void SetIceCandidatePoolSize(int32_t size) { ice_candidate_pool_size_ = size; }
 
 		bool ProcessMessages(int32_t delay)
 		{
+			if (pump_ == RtcMessagePump::Engine)
+			{
+				// nothing to pump, report whether the peer is still alive once it closes or the delay passes
+				return !closed_.Wait(delay < 0 ? rtc::Event::kForever : delay);
+			}
 			return rtc::ThreadManager::Instance()->WrapCurrentThread()->ProcessMessages(delay);
 		}
 
+		// Wakes the engine's WaitForActivity, called by the observers after a callback was delivered.
+		void NotifyActivity()
+		{
+			if (engine_)
+			{
+				engine_->SignalActivity();
+			}
+		}
+
 		void AddServerConfig(std::string uri, std::string username, std::string password);
 
-		void CreateDataChannel(const std::string & label, webrtc::DataChannelInit dc_options);
-		void DataChannelSendText(const std::string & label, const std::string & text);
+		// Identifies the peer in stats reports, unique within the process.
+		uint64_t PeerId() const { return peer_id_; }
+
+		// Collects the stats of the peer connection and hands them to |done| on the signaling thread.
+		// Returns false when there is no peer connection. RtcEngine::StartStatsPolling covers every peer at once.
+		bool GetStats(std::function<void(const RtcPeerStats&)> done);
+		// Same as GetStats, but delivers to onStats.
+		bool RequestStats() { return GetStats(onStats); }
+
+		int32_t CreateDataChannel(const std::string & label, webrtc::DataChannelInit dc_options);
+		bool DataChannelSendText(const std::string & label, const std::string & text);
 		RtcDataChannelInfo GetDataChannelInfo(const std::string& label);
 		webrtc::DataChannelInterface::DataState GetDataChannelState(const std::string& label);
 		void CloseDataChannel(const std::string& label);
-		void DataChannelSendData(const std::string& label, uint8_t* data, uint32_t length);
+		bool DataChannelSendData(const std::string& label, uint8_t* data, uint32_t length);
 
-		
-		OnSuccessCallbackNative onSuccess;
-		OnFailureCallbackNative onFailure;
-		OnIceStateChangeCallbackNative onIceStateChange{};
-		OnIceGatheringStateCallbackNative onIceGatheringStateChange{};
-		OnIceCandidateCallbackNative onIceCandidate;
-		OnDataChannelStateCallbackNative onDataChannelState;
-		OnBufferAmountCallbackNative onBufferAmountChange{};
-		OnMessageCallbackNative onMessage;
+		bool DataChannelSendText(int32_t channel, const std::string & text);
+		RtcDataChannelInfo GetDataChannelInfo(int32_t channel);
+		webrtc::DataChannelInterface::DataState GetDataChannelState(int32_t channel);
+		void CloseDataChannel(int32_t channel);
+		bool DataChannelSendData(int32_t channel, uint8_t* data, uint32_t length);
+
+		// TrySend turns messages away once the channel buffers more than |high| bytes and raises onWritable
+		// when it drained to |low| again, keep |high| well below the 16MB at which the channel closes itself.
+		bool SetDataChannelWatermarks(int32_t channel, uint64_t high, uint64_t low);
+		RtcSendResult TrySend(int32_t channel, const uint8_t* data, uint32_t length, bool binary);
+
+		// Like TrySend for a pool buffer, the buffer stays acquired when the result is WouldBlock.
+		RtcSendResult TrySendBuffer(int32_t channel, int32_t buffer, uint32_t length);
+
+		// Keeps |buffers| send buffers of |buffer_size| bytes the application can write its payload into,
+		// so DataChannelSendBuffer hands the payload to WebRTC without copying it.
+		void EnableSendBufferPool(uint32_t buffers, uint32_t buffer_size);
+
+		// Returns the id of a pool buffer with room for at least |size| bytes and where to write into it,
+		// or SendBufferPool::kInvalidBuffer when the pool is disabled or exhausted.
+		int32_t AcquireSendBuffer(uint32_t size, uint8_t** data, uint32_t* capacity);
+
+		// Sends the first |length| bytes of an acquired buffer, the buffer goes back to the pool either way.
+		bool DataChannelSendBuffer(int32_t channel, int32_t buffer, uint32_t length);
+
+		// Gives back an acquired buffer that will not be sent.
+		void ReturnSendBuffer(int32_t buffer);
+		RtcSendBufferPoolStats GetSendBufferPoolStats() const;
+
+		// Sends of every channel go through a scheduler which serves the priority classes in strict order and
+		// channels within a class by weight. It holds messages back while the channels together buffer more
+		// than |budget_bytes|, so a small critical message never waits behind megabytes of queued bulk data.
+		// Set before InitializePeerConnection.
+		void EnableSendScheduler(uint64_t budget_bytes);
+		bool SetDataChannelPriority(int32_t channel, RtcSendPriority priority, uint32_t weight);
+		bool ScheduleSend(int32_t channel, const uint8_t* data, uint32_t length, bool binary);
+		RtcSendClassStats GetSendClassStats(RtcSendPriority priority) const;
+
+		// Called by the data channel observers, lets the scheduler release more messages.
+		void OnChannelDrained(int32_t channel)
+		{
+			if (scheduler_)
+			{
+				scheduler_->OnBufferedAmountChange(channel);
+			}
+		}
+		// Called by the data channel observers whenever the amount one of them tracks changed.
+		void OnBufferedAmount(uint64_t previous, uint64_t amount)
+		{
+			// wraps around when the amount shrank, the total still ends up right
+			buffered_amount_ += amount - previous;
+		}
+		// Called by the data channel observers, the scheduler holds the messages of a channel until it opened.
+		void OnChannelOpen(int32_t channel)
+		{
+			if (scheduler_)
+			{
+				scheduler_->OpenChannel(channel);
+			}
+		}
+
+		// Channels whose protocol contains kFragmentedProtocol split messages of any size into fragments and
+		// put them back together on receive, both ends must use the token. Applies to channels registered later.
+		void SetFragmentationOptions(const RtcFragmentationOptions& options);
+		RtcFragmentationStats GetFragmentationStats(int32_t channel) const;
+
+		// Channels whose protocol contains kCoalescedProtocol pack small messages sent within a short window
+		// into one data channel message, both ends must use the token. Applies to channels registered later.
+		void SetCoalescingOptions(const RtcCoalescingOptions& options);
+		RtcCoalescingStats GetCoalescingStats(int32_t channel) const;
+
+		// Channels whose protocol contains kDeflateProtocol deflate messages which compress well enough,
+		// both ends must use the token. Applies to channels registered later.
+		void SetCompressionOptions(const RtcCompressionOptions& options);
+		RtcCompressionStats GetCompressionStats(int32_t channel) const;
+
+		// Keeps latency histograms and rates for every channel, set before InitializePeerConnection.
+		void EnableChannelMetrics() { channel_metrics_ = true; }
+		// Summarizes what |channel| recorded since its previous drain, false when it has no metrics.
+		bool GetChannelMetrics(int32_t channel, RtcChannelMetrics* metrics) const;
+		// Drains the metrics of every open channel into |metrics|, which is cleared first,
+		// reuse it between calls to avoid allocating. Returns how many channels have metrics, when
+		// those are more than |max_count| nothing is drained so a larger buffer can get them all.
+		size_t DrainChannelMetrics(std::vector<RtcChannelMetrics>& metrics, size_t max_count = SIZE_MAX) const;
+
+		// Returns the handle of the channel with |label|, or kInvalidChannel.
+		int32_t FindDataChannelHandle(const std::string& label) const;
+
+		// Gives a channel its handle and starts observing it, used for local and remote channels alike.
+		int32_t RegisterDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel);
+
+		// Queues received messages instead of calling onMessage for each of them, set before InitializePeerConnection.
+		// The application collects them in batches with DrainMessages.
+		void EnableInboundQueue(uint32_t capacity, RtcOverflowPolicy policy);
+
+		// Moves up to |max_count| queued messages into |batch| and returns how many were moved.
+		// |batch| is cleared first, reuse it between calls to avoid allocating.
+		size_t DrainMessages(size_t max_count, std::vector<RtcInboundMessage>& batch);
+		RtcInboundQueueStats GetInboundQueueStats() const;
+
+		// Called by the data channel observers, returns false when the message should go to onMessage.
+		bool EnqueueInbound(int32_t channel, const webrtc::DataBuffer& buffer);
+
+		// Delivers received messages through onLeasedMessage, their memory stays valid until ReleaseLease.
+		// At most |max_leases| are outstanding and they keep at most |max_bytes| of receive buffers alive, 0 for no
+		// byte limit. Once either limit is reached further messages go to onMessage until some are released.
+		// Leases held longer than |leak_timeout_ms| are logged. Set before InitializePeerConnection.
+		void EnableLeasedReceive(uint32_t max_leases, uint64_t max_bytes, int32_t leak_timeout_ms);
+		bool ReleaseLease(uint64_t lease);
+		RtcLeaseStats GetLeaseStats() const;
+
+		// Called by the data channel observers, returns false when the message should go to onMessage.
+		bool DeliverLeased(int32_t channel, const webrtc::DataBuffer& buffer);
+
+		// std::function so the C API can bind its user data, the managed wrapper assigns the plain function pointers above
+		std::function<void(const char* type, const char* sdp)> onSuccess;
+		std::function<void(const char* error)> onFailure;
+		std::function<void(webrtc::PeerConnectionInterface::IceConnectionState state)> onIceStateChange;
+		std::function<void(webrtc::PeerConnectionInterface::IceGatheringState state)> onIceGatheringStateChange;
+		std::function<void(const char* sdpMid, int32_t sdpIndex, const char* sdp)> onIceCandidate;
+		// replaces onIceCandidate when set, the candidate comes with its fields already parsed. Batched
+		// candidates still go to onIceCandidates, with their fields
+		std::function<void(const char* sdpMid, int32_t sdpIndex, const char* sdp, const RtcCandidateFields* fields)> onIceCandidateFields;
+		std::function<void(const RtcIceCandidate* candidates, uint32_t count, bool complete)> onIceCandidates;
+		std::function<void(int32_t channel, const char* label, webrtc::DataChannelInterface::DataState state)> onDataChannelState;
+		std::function<void(int32_t channel, uint64_t previousAmount, uint64_t currentAmount, uint64_t bytesSent, uint64_t bytesReceived)> onBufferAmountChange;
+		std::function<void(int32_t channel)> onWritable;
+		std::function<void(int32_t channel, const uint8_t* msg, uint32_t size, bool is_binary)> onMessage;
+		std::function<void(int32_t channel, uint64_t lease, const uint8_t* msg, uint32_t size, bool is_binary)> onLeasedMessage;
+		std::function<void(const RtcPeerStats& stats)> onStats;
 
 		//rtc::scoped_refptr<Observers::DataChannelObserver> dataObserver;
 		rtc::scoped_refptr<Observers::PeerConnectionObserver> peerObserver;
 		rtc::scoped_refptr<Observers::CreateSessionDescriptionObserver> sessionObserver;
 		rtc::scoped_refptr<Observers::SetSessionDescriptionObserver> setSessionObserver;
-
-		std::unordered_map<std::string, Observers::DataChannelObserver*> dataObservers;
+		rtc::scoped_refptr<Observers::SetSessionDescriptionObserver> setRemoteSessionObserver;
 
 		void DeletePeerConnection();
 
@@ -108,18 +351,63 @@ namespace Spitfire
 		};
 
 	private:
-		std::unique_ptr<rtc::Thread> worker_thread_;
-		std::unique_ptr<rtc::Thread> signaling_thread_;
-		std::unique_ptr<rtc::Thread> network_thread_;
-		std::unique_ptr<rtc::BasicNetworkManager> default_network_manager_;
-		std::unique_ptr<rtc::BasicPacketSocketFactory> default_socket_factory_;
+		std::shared_ptr<RtcEngine> engine_;
+		ProcessingThread* processing_thread_ = nullptr;
+		uint64_t affinity_key_;
+		const uint64_t peer_id_;
+		RtcMessagePump pump_ = RtcMessagePump::Caller;
+		int32_t ice_candidate_pool_size_ = 0;
+		rtc::Event closed_{ true, false };
+
+		ConnectionTimeline timeline_;
+		// outlives the peer connection, closing it reports the transport closed
+		std::unique_ptr<Observers::SctpTransportObserver> sctp_observer_;
+		bool sctp_watched_ = false;
+
+		std::unique_ptr<MessageRing<RtcInboundMessage>> inbound_;
+		RtcOverflowPolicy inbound_policy_ = RtcOverflowPolicy::DropNewest;
+		std::atomic<uint64_t> inbound_enqueued_{ 0 };
+		std::atomic<uint64_t> inbound_dropped_{ 0 };
+		// set by every drain while the policy is Block
+		rtc::Event inbound_drained_{ false, false };
+		// a Block wait timed out and the application has not drained since
+		std::atomic<bool> inbound_stalled_{ false };
+
+		std::unique_ptr<SendBufferPool> send_pool_;
+
+		// outlives the peer connection, the application may still be reading leased buffers
+		std::unique_ptr<LeaseTable> leases_;
+		webrtc::RepeatingTaskHandle lease_check_;
+		int32_t lease_check_interval_ms_ = 0;
+
+		RtcFragmentationOptions fragmentation_options_;
+		RtcCoalescingOptions coalescing_options_;
+		RtcCompressionOptions compression_options_;
+		bool channel_metrics_ = false;
+
+		uint64_t scheduler_budget_ = 0;
+		std::shared_ptr<SendScheduler> scheduler_;
+
+		bool candidate_batching_ = false;
+		RtcCandidateBatchingOptions candidate_batching_options_;
+		std::shared_ptr<CandidateBatcher> candidate_batcher_;
 
 		bool CreatePeerConnection(uint16_t minPort, uint16_t maxPort);
-		void FinalizeDataChannelClose(const std::string& label, Observers::DataChannelObserver* observer);
+		void StartLeaseCheck();
+		// the caller keeps the observer alive, a concurrent close only takes it out of |channels_|
+		std::shared_ptr<Observers::DataChannelObserver> FindDataChannel(int32_t channel) const;
+		void FinalizeDataChannelClose(std::shared_ptr<Observers::DataChannelObserver> observer);
+		RtcSendResult AdmitSend(Observers::DataChannelObserver* observer, uint32_t length);
+		RtcSendResult SendAdmitted(Observers::DataChannelObserver* observer, const webrtc::DataBuffer& buffer);
+
+		// indexed by channel handle, closed channels leave a nullptr behind
+		std::vector<std::shared_ptr<Observers::DataChannelObserver>> channels_;
+		std::unordered_map<std::string, std::shared_ptr<Observers::DataChannelObserver>> dataObservers;
+		rtc::CriticalSection channels_crit_;
+		// what the channels in |channels_| buffer together, GetStats reads it on the signaling thread without the lock
+		std::atomic<uint64_t> buffered_amount_{ 0 };
 
-		rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> pc_factory_;
 		std::vector<webrtc::PeerConnectionInterface::IceServer> serverConfigs;
-		std::unique_ptr<cricket::RelayPortFactoryInterface> default_relay_port_factory_;
 	};
 }
 #endif  // WEBRTC_NET_CONDUCTOR_H_
\ No newline at end of file
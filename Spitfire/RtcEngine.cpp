@@ -0,0 +1,443 @@
+#include "RtcEngine.h"
+#include "RingTracer.h"
+#include "p2p/client/basic_port_allocator.h"
+#include "rtc_base/cpu_time.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+namespace Spitfire
+{
+	namespace
+	{
+		std::mutex shared_lock;
+		// never destroyed, stopping the engine from a static destructor would join its threads
+		// while the process exits, under the loader lock on Windows
+		std::shared_ptr<RtcEngine>& SharedEngine()
+		{
+			static auto* engine = new std::shared_ptr<RtcEngine>();
+			return *engine;
+		}
+	}
+
+	std::shared_ptr<RtcEngine> RtcEngine::Shared()
+	{
+		std::lock_guard<std::mutex> lock(shared_lock);
+		auto& engine = SharedEngine();
+		if (!engine)
+		{
+			engine = Create();
+		}
+		return engine;
+	}
+
+	void RtcEngine::ShutdownShared()
+	{
+		std::shared_ptr<RtcEngine> engine;
+		{
+			std::lock_guard<std::mutex> lock(shared_lock);
+			engine.swap(SharedEngine());
+		}
+		// stops here unless conductors still reference it
+	}
+
+	std::shared_ptr<RtcEngine> RtcEngine::Create(const RtcEngineOptions& options)
+	{
+		std::shared_ptr<RtcEngine> engine(new RtcEngine(options), [](RtcEngine* engine)
+		{
+			// Shutdown joins the engine threads, which a thread can not do to itself
+			if (engine->IsEngineThread())
+			{
+				std::thread([engine] { delete engine; }).detach();
+				return;
+			}
+			delete engine;
+		});
+		if (!engine->Initialize())
+		{
+			RTC_LOG(LS_ERROR) << "Unable to create engine";
+			return nullptr;
+		}
+		return engine;
+	}
+
+	RtcEngine::RtcEngine(const RtcEngineOptions& options) :
+		options_(options)
+	{
+		if (options_.networkThreads == 0)
+		{
+			options_.networkThreads = std::max(1u, std::thread::hardware_concurrency());
+		}
+	}
+
+	RtcEngine::~RtcEngine()
+	{
+		Shutdown();
+	}
+
+	bool RtcEngine::Initialize()
+	{
+		// before any thread starts, so every trace call site finds the tracer
+		RingTracer::Install();
+
+		worker_thread_ = rtc::Thread::Create();
+		worker_thread_->SetName("worker_thread", nullptr);
+		RTC_CHECK(worker_thread_->Start()) << "Failed to start worker thread";
+
+		signaling_thread_ = rtc::Thread::Create();
+		signaling_thread_->SetName("signaling_thread", nullptr);
+		RTC_CHECK(signaling_thread_->Start()) << "Failed to start signaling thread";
+
+		relay_port_factory_.reset(new cricket::TurnPortFactory());
+
+		for (uint32_t i = 0; i < options_.networkThreads; ++i)
+		{
+			if (!StartProcessingThread(i))
+			{
+				return false;
+			}
+		}
+		RTC_LOG(INFO) << "Engine started with " << processing_threads_.size() << " network threads";
+		return true;
+	}
+
+	bool RtcEngine::StartProcessingThread(uint32_t index)
+	{
+		std::unique_ptr<ProcessingThread> processing_thread(new ProcessingThread());
+		processing_thread->index = index;
+		// a PhysicalSocketServer, which waits on epoll on Linux and on WSAEventSelect events on Windows
+		processing_thread->thread = rtc::Thread::CreateWithSocketServer();
+		processing_thread->thread->SetName("network_thread_" + std::to_string(index), nullptr);
+		RTC_CHECK(processing_thread->thread->Start()) << "Failed to start network thread";
+
+		webrtc::PeerConnectionFactoryDependencies factory_deps;
+		factory_deps.network_thread = processing_thread->thread.get();
+		factory_deps.worker_thread = worker_thread_.get();
+		factory_deps.signaling_thread = signaling_thread_.get();
+
+		processing_thread->factory = CreateModularPeerConnectionFactory(std::move(factory_deps));
+		if (!processing_thread->factory)
+		{
+			processing_thread->thread->Stop();
+			return false;
+		}
+		webrtc::PeerConnectionFactoryInterface::Options opt;
+		processing_thread->factory->SetOptions(opt);
+
+		processing_thread->networkManager.reset(new rtc::BasicNetworkManager());
+		processing_thread->socketFactory.reset(new rtc::BasicPacketSocketFactory(processing_thread->thread.get()));
+
+		// samples how busy the shard is from the shard itself, a late sample means a long queue
+		const auto interval_ms = options_.metricsIntervalMs;
+		auto* shard = processing_thread.get();
+		shard->thread->Invoke<void>(RTC_FROM_HERE, [shard, interval_ms]
+		{
+			shard->lastSampleWallNs = rtc::TimeNanos();
+			shard->lastSampleCpuNs = rtc::GetThreadCpuTimeNanos();
+			shard->sampler = webrtc::RepeatingTaskHandle::DelayedStart(shard->thread.get(), webrtc::TimeDelta::ms(interval_ms), [shard, interval_ms]
+			{
+				const auto wall_ns = rtc::TimeNanos();
+				const auto cpu_ns = rtc::GetThreadCpuTimeNanos();
+				const auto wall_delta = wall_ns - shard->lastSampleWallNs;
+				if (wall_delta > 0)
+				{
+					const auto permille = (cpu_ns - shard->lastSampleCpuNs) * 1000 / wall_delta;
+					shard->busyPermille = static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(permille, 0), 1000));
+					const auto delay_us = (wall_delta - interval_ms * rtc::kNumNanosecsPerMillisec) / rtc::kNumNanosecsPerMicrosec;
+					shard->schedulingDelayUs = std::max<int64_t>(delay_us, 0);
+				}
+				shard->lastSampleWallNs = wall_ns;
+				shard->lastSampleCpuNs = cpu_ns;
+				return webrtc::TimeDelta::ms(interval_ms);
+			});
+		});
+
+		processing_threads_.push_back(std::move(processing_thread));
+		return true;
+	}
+
+	bool RtcEngine::IsEngineThread() const
+	{
+		if ((worker_thread_ && worker_thread_->IsCurrent()) || (signaling_thread_ && signaling_thread_->IsCurrent()))
+		{
+			return true;
+		}
+		for (auto& processing_thread : processing_threads_)
+		{
+			if (processing_thread->thread->IsCurrent())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void RtcEngine::Shutdown()
+	{
+		StopStatsPolling();
+		{
+			rtc::CritScope lock(&certificates_crit_);
+			certificates_.reset();
+			shared_certificate_ = nullptr;
+		}
+		for (auto& processing_thread : processing_threads_)
+		{
+			RTC_DCHECK(processing_thread->peers == 0);
+			processing_thread->factory = nullptr;
+			// the sampler, network manager and socket factory are used by the network thread, so they go away there
+			auto* shard = processing_thread.get();
+			shard->thread->Invoke<void>(RTC_FROM_HERE, [shard]
+			{
+				shard->sampler.Stop();
+				shard->socketFactory.reset();
+				shard->networkManager.reset();
+			});
+			shard->thread->Stop();
+		}
+		processing_threads_.clear();
+		relay_port_factory_.reset();
+
+		if (worker_thread_)
+		{
+			worker_thread_->Stop();
+			worker_thread_.reset();
+		}
+		if (signaling_thread_)
+		{
+			signaling_thread_->Stop();
+			signaling_thread_.reset();
+		}
+	}
+
+	ProcessingThread* RtcEngine::AcquireProcessingThread(uint64_t affinity_key)
+	{
+		rtc::CritScope lock(&crit_);
+		RTC_DCHECK(!processing_threads_.empty());
+
+		ProcessingThread* selected = nullptr;
+		if (options_.shardPolicy == RtcShardPolicy::Hash)
+		{
+			// fold the key so sequential ids still spread over every shard
+			auto hash = affinity_key * 0x9E3779B97F4A7C15ull;
+			hash ^= hash >> 32;
+			selected = processing_threads_[hash % processing_threads_.size()].get();
+		}
+		else
+		{
+			for (auto& processing_thread : processing_threads_)
+			{
+				if (!selected || processing_thread->peers < selected->peers)
+				{
+					selected = processing_thread.get();
+				}
+			}
+		}
+		++selected->peers;
+		return selected;
+	}
+
+	void RtcEngine::ReleaseProcessingThread(ProcessingThread* processing_thread)
+	{
+		rtc::CritScope lock(&crit_);
+		RTC_DCHECK(processing_thread->peers > 0);
+		--processing_thread->peers;
+	}
+
+	uint32_t RtcEngine::PeerCount() const
+	{
+		rtc::CritScope lock(&crit_);
+		uint32_t peers = 0;
+		for (auto& processing_thread : processing_threads_)
+		{
+			peers += processing_thread->peers;
+		}
+		return peers;
+	}
+
+	std::vector<RtcShardMetrics> RtcEngine::GetShardMetrics() const
+	{
+		rtc::CritScope lock(&crit_);
+		std::vector<RtcShardMetrics> metrics;
+		metrics.reserve(processing_threads_.size());
+		for (auto& processing_thread : processing_threads_)
+		{
+			RtcShardMetrics shard{};
+			shard.index = processing_thread->index;
+			shard.peers = processing_thread->peers;
+			shard.queueDepth = static_cast<uint32_t>(processing_thread->thread->size());
+			shard.busyPermille = processing_thread->busyPermille;
+			shard.schedulingDelayUs = processing_thread->schedulingDelayUs;
+			metrics.push_back(shard);
+		}
+		return metrics;
+	}
+
+	void RtcEngine::SignalActivity()
+	{
+		// only the first callback since the last wake up pays for setting the event
+		if (!activity_pending_.exchange(true))
+		{
+			activity_.Set();
+		}
+	}
+
+	bool RtcEngine::WaitForActivity(int32_t give_up_after_ms)
+	{
+		const auto signaled = activity_.Wait(give_up_after_ms < 0 ? rtc::Event::kForever : give_up_after_ms);
+		activity_pending_ = false;
+		return signaled;
+	}
+
+	// One polling round, the last peer to answer delivers the batch.
+	struct StatsRound
+	{
+		rtc::CriticalSection crit;
+		std::vector<RtcPeerStats> stats;
+		size_t pending = 0;
+		std::function<void(const std::vector<RtcPeerStats>&)> onReport;
+
+		// |peer_stats| is null for a peer that had nothing to report
+		void Complete(const RtcPeerStats* peer_stats)
+		{
+			{
+				rtc::CritScope lock(&crit);
+				if (peer_stats)
+				{
+					stats.push_back(*peer_stats);
+				}
+				if (--pending > 0)
+				{
+					return;
+				}
+			}
+			if (onReport)
+			{
+				onReport(stats);
+			}
+		}
+	};
+
+	void RtcEngine::AddStatsSource(uint64_t peer, StatsSource source)
+	{
+		rtc::CritScope lock(&stats_crit_);
+		stats_sources_[peer] = std::move(source);
+	}
+
+	void RtcEngine::RemoveStatsSource(uint64_t peer)
+	{
+		// waits for a running round, the source is not called once this returns
+		rtc::CritScope lock(&stats_crit_);
+		stats_sources_.erase(peer);
+	}
+
+	void RtcEngine::StartStatsPolling(int32_t interval_ms, std::function<void(const std::vector<RtcPeerStats>&)> on_report)
+	{
+		signaling_thread_->Invoke<void>(RTC_FROM_HERE, [this, interval_ms, &on_report]
+		{
+			stats_poller_.Stop();
+			on_stats_report_ = std::move(on_report);
+			stats_poller_ = webrtc::RepeatingTaskHandle::DelayedStart(signaling_thread_.get(), webrtc::TimeDelta::ms(interval_ms), [this, interval_ms]
+			{
+				PollStats();
+				return webrtc::TimeDelta::ms(interval_ms);
+			});
+		});
+	}
+
+	void RtcEngine::StopStatsPolling()
+	{
+		if (!signaling_thread_)
+		{
+			return;
+		}
+		signaling_thread_->Invoke<void>(RTC_FROM_HERE, [this]
+		{
+			stats_poller_.Stop();
+			on_stats_report_ = nullptr;
+		});
+	}
+
+	void RtcEngine::EnableCertificatePool(uint32_t pool_size, bool shared)
+	{
+		rtc::CritScope lock(&certificates_crit_);
+		certificates_ = std::make_shared<CertificatePool>(std::max(pool_size, 1u));
+		share_certificate_ = shared;
+		shared_certificate_ = nullptr;
+	}
+
+	std::unique_ptr<rtc::RTCCertificateGeneratorInterface> RtcEngine::CreateCertificateGenerator()
+	{
+		rtc::CritScope lock(&certificates_crit_);
+		if (!certificates_)
+		{
+			return nullptr;
+		}
+		return CertificatePool::CreateGenerator(certificates_);
+	}
+
+	rtc::scoped_refptr<rtc::RTCCertificate> RtcEngine::SharedCertificate()
+	{
+		// renewed a day ahead, so a peer connection never starts with a certificate about to expire
+		static const int64_t kRenewAheadMs = 24 * 60 * 60 * 1000;
+
+		const auto renew_at_ms = rtc::TimeUTCMillis() + kRenewAheadMs;
+		std::shared_ptr<CertificatePool> pool;
+		{
+			rtc::CritScope lock(&certificates_crit_);
+			if (!share_certificate_)
+			{
+				return nullptr;
+			}
+			if (shared_certificate_ && !shared_certificate_->HasExpired(renew_at_ms))
+			{
+				return shared_certificate_;
+			}
+			pool = certificates_;
+		}
+
+		// generated outside the lock, every peer of the engine being set up would wait for it otherwise
+		auto certificate = pool->Take();
+		if (!certificate)
+		{
+			certificate = rtc::RTCCertificateGenerator::GenerateCertificate(rtc::KeyParams::ECDSA(rtc::EC_NIST_P256), absl::nullopt);
+		}
+
+		rtc::CritScope lock(&certificates_crit_);
+		// a peer renewing at the same time may have been first, then its certificate is the shared one
+		if (certificate && (!shared_certificate_ || shared_certificate_->HasExpired(renew_at_ms)))
+		{
+			shared_certificate_ = certificate;
+		}
+		return shared_certificate_;
+	}
+
+	RtcCertificatePoolStats RtcEngine::GetCertificatePoolStats() const
+	{
+		rtc::CritScope lock(&certificates_crit_);
+		return certificates_ ? certificates_->GetStats() : RtcCertificatePoolStats{};
+	}
+
+	void RtcEngine::PollStats()
+	{
+		auto round = std::make_shared<StatsRound>();
+		round->onReport = on_stats_report_;
+
+		{
+			rtc::CritScope lock(&stats_crit_);
+			round->stats.reserve(stats_sources_.size());
+			// one extra, so peers answering right away can not deliver before every request went out
+			round->pending = stats_sources_.size() + 1;
+			for (auto& source : stats_sources_)
+			{
+				if (!source.second([round](const RtcPeerStats& stats) { round->Complete(&stats); }))
+				{
+					round->Complete(nullptr);
+				}
+			}
+		}
+		round->Complete(nullptr);
+	}
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#ifndef WEBRTC_NET_ENGINE_H_
+#define WEBRTC_NET_ENGINE_H_
+
+#include "CertificatePool.h"
+#include "StatsCollectorObserver.h"
+#include "api/peer_connection_interface.h"
+#include "p2p/client/relay_port_factory_interface.h"
+#include "p2p/base/basic_packet_socket_factory.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/event.h"
+#include "rtc_base/network.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/task_utils/repeating_task.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Spitfire
+{
+	// A network thread together with the factory and socket plumbing bound to it.
+	// Peer connections created from |factory| run their ICE, DTLS and SCTP work on |thread|.
+	struct ProcessingThread
+	{
+		uint32_t index = 0;
+		std::unique_ptr<rtc::Thread> thread;
+		rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory;
+		std::unique_ptr<rtc::BasicNetworkManager> networkManager;
+		std::unique_ptr<rtc::BasicPacketSocketFactory> socketFactory;
+		uint32_t peers = 0;
+
+		// updated on |thread| by the engine's sampler
+		webrtc::RepeatingTaskHandle sampler;
+		int64_t lastSampleWallNs = 0;
+		int64_t lastSampleCpuNs = 0;
+		std::atomic<uint32_t> busyPermille{ 0 };
+		std::atomic<int64_t> schedulingDelayUs{ 0 };
+	};
+
+	enum class RtcShardPolicy
+	{
+		// New peers go to the network thread with the fewest peers.
+		LeastLoaded = 0,
+		// New peers go to the network thread picked by their affinity key.
+		Hash = 1
+	};
+
+	struct RtcEngineOptions
+	{
+		// Number of network threads, each with its own factory. Zero picks one per hardware thread.
+		uint32_t networkThreads = 1;
+		RtcShardPolicy shardPolicy = RtcShardPolicy::LeastLoaded;
+		// How often the per shard metrics are refreshed.
+		int32_t metricsIntervalMs = 1000;
+	};
+
+	struct RtcShardMetrics
+	{
+		uint32_t index;
+		uint32_t peers;
+		// messages waiting on the network thread right now
+		uint32_t queueDepth;
+		// share of the last interval the network thread spent on CPU, 0-1000
+		uint32_t busyPermille;
+		// how late the last metrics sample ran compared to when it was due
+		int64_t schedulingDelayUs;
+	};
+
+	// Owns the threads and the peer connection factories shared by every RtcConductor in the process.
+	// Conductors borrow a ProcessingThread when they create their peer connection and hand it back
+	// when they are deleted, so the number of OS threads no longer grows with the number of peers.
+	class RtcEngine
+	{
+	public:
+		// Returns the process-wide engine, creating it on first use. It keeps running while no conductor
+		// references it, so peers coming and going do not restart its threads, until ShutdownShared.
+		static std::shared_ptr<RtcEngine> Shared();
+		// Lets go of the process-wide engine, it stops once the last conductor referencing it has been deleted.
+		// A later Shared starts a new one.
+		static void ShutdownShared();
+
+		// Creates an engine that is independent of the process-wide one. When the last reference goes away on
+		// one of the engine's own threads, for example in a callback, the engine is stopped from another thread.
+		static std::shared_ptr<RtcEngine> Create(const RtcEngineOptions& options = RtcEngineOptions());
+
+		~RtcEngine();
+
+		RtcEngine(const RtcEngine&) = delete;
+		RtcEngine& operator=(const RtcEngine&) = delete;
+
+		// Assigns a network thread to a new peer, must be paired with ReleaseProcessingThread.
+		// |affinity_key| is only used by RtcShardPolicy::Hash.
+		ProcessingThread* AcquireProcessingThread(uint64_t affinity_key);
+		void ReleaseProcessingThread(ProcessingThread* processing_thread);
+
+		rtc::Thread* WorkerThread() const { return worker_thread_.get(); }
+		rtc::Thread* SignalingThread() const { return signaling_thread_.get(); }
+		cricket::RelayPortFactoryInterface* RelayPortFactory() const { return relay_port_factory_.get(); }
+
+		// Number of peers currently borrowing from this engine.
+		uint32_t PeerCount() const;
+
+		size_t ShardCount() const { return processing_threads_.size(); }
+		std::vector<RtcShardMetrics> GetShardMetrics() const;
+
+		// Wakes whoever waits in WaitForActivity, conductors call this after delivering a callback.
+		void SignalActivity();
+
+		// Blocks until a peer of this engine delivered a callback or |give_up_after_ms| expired.
+		// Lets one application thread service every peer instead of one ProcessMessages loop each.
+		bool WaitForActivity(int32_t give_up_after_ms);
+
+		// Starts a GetStats call for one peer and returns true, or false when the peer has no connection yet.
+		typedef std::function<bool(std::function<void(const RtcPeerStats&)> done)> StatsSource;
+
+		// Conductors register while they have a peer connection, so polling reaches every live peer.
+		void AddStatsSource(uint64_t peer, StatsSource source);
+		void RemoveStatsSource(uint64_t peer);
+
+		// Collects the stats of every peer each |interval_ms| and hands them to |on_report| as one batch,
+		// on the signaling thread once the last peer answered. Replaces a previous poll.
+		void StartStatsPolling(int32_t interval_ms, std::function<void(const std::vector<RtcPeerStats>&)> on_report);
+		void StopStatsPolling();
+
+		// Keeps |pool_size| DTLS certificates generated ahead of time for peers initialized from now on.
+		// With |shared| every new peer connection uses one certificate instead, which skips generation altogether
+		// but lets the remote peers tell that the connections share an endpoint.
+		void EnableCertificatePool(uint32_t pool_size, bool shared);
+		// Null while there is no pool, the factory generates certificates itself then.
+		std::unique_ptr<rtc::RTCCertificateGeneratorInterface> CreateCertificateGenerator();
+		// Null unless the pool was enabled as shared.
+		rtc::scoped_refptr<rtc::RTCCertificate> SharedCertificate();
+		RtcCertificatePoolStats GetCertificatePoolStats() const;
+
+	private:
+		explicit RtcEngine(const RtcEngineOptions& options);
+
+		bool Initialize();
+		bool StartProcessingThread(uint32_t index);
+		// true on the worker, signaling and network threads, which Shutdown can not stop from themselves
+		bool IsEngineThread() const;
+		void Shutdown();
+		void PollStats();
+
+		RtcEngineOptions options_;
+
+		std::unique_ptr<rtc::Thread> worker_thread_;
+		std::unique_ptr<rtc::Thread> signaling_thread_;
+		std::vector<std::unique_ptr<ProcessingThread>> processing_threads_;
+		std::unique_ptr<cricket::RelayPortFactoryInterface> relay_port_factory_;
+
+		rtc::CriticalSection crit_;
+
+		std::unordered_map<uint64_t, StatsSource> stats_sources_;
+		std::function<void(const std::vector<RtcPeerStats>&)> on_stats_report_;
+		// only touched on the signaling thread
+		webrtc::RepeatingTaskHandle stats_poller_;
+		rtc::CriticalSection stats_crit_;
+
+		std::shared_ptr<CertificatePool> certificates_;
+		bool share_certificate_ = false;
+		rtc::scoped_refptr<rtc::RTCCertificate> shared_certificate_;
+		rtc::CriticalSection certificates_crit_;
+
+		rtc::Event activity_{ false, false };
+		std::atomic<bool> activity_pending_{ false };
+	};
+}
+#endif  // WEBRTC_NET_ENGINE_H_
@@ -0,0 +1,10 @@
+#include "SctpTransportObserver.h"
+#include "RtcConductor.h"
+
+void Spitfire::Observers::SctpTransportObserver::OnStateChange(webrtc::SctpTransportInformation info)
+{
+	if (info.state() == webrtc::SctpTransportState::kConnected)
+	{
+		conductor_->MarkMilestone(RtcMilestone::SctpConnected);
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "api/sctp_transport_interface.h"
+
+namespace Spitfire
+{
+	class RtcConductor;
+
+	namespace Observers
+	{
+		// Called on the network thread, only the connection timeline listens.
+		class SctpTransportObserver : public webrtc::SctpTransportObserverInterface
+		{
+		public:
+			explicit SctpTransportObserver(RtcConductor* conductor) :
+				conductor_(conductor)
+			{
+			}
+			~SctpTransportObserver() = default;
+
+			void OnStateChange(webrtc::SctpTransportInformation info) override;
+
+		private:
+			RtcConductor* conductor_;
+		};
+	}
+}
@@ -0,0 +1,102 @@
+#include "SendBufferPool.h"
+#include "rtc_base/checks.h"
+
+#include <algorithm>
+
+namespace Spitfire
+{
+	SendBufferPool::SendBufferPool(uint32_t buffers, uint32_t buffer_size) :
+		slots_(buffers)
+	{
+		free_.reserve(buffers);
+		for (uint32_t i = 0; i < buffers; ++i)
+		{
+			slots_[i].buffer = rtc::CopyOnWriteBuffer(0, std::max<uint32_t>(buffer_size, 1));
+			// hand out the lowest index first, its memory is the most likely to still be warm
+			free_.push_back(static_cast<int32_t>(buffers - 1 - i));
+		}
+	}
+
+	int32_t SendBufferPool::Acquire(uint32_t size, uint8_t** data, uint32_t* capacity)
+	{
+		rtc::CritScope lock(&crit_);
+		if (free_.empty())
+		{
+			++exhausted_;
+			return kInvalidBuffer;
+		}
+		const auto buffer = free_.back();
+		free_.pop_back();
+
+		auto& slot = slots_[buffer];
+		slot.outstanding = true;
+		++acquired_;
+
+		// Clear keeps the memory when we hold the only reference and swaps in a fresh, empty block
+		// when a queued send still shares it, so nothing is ever copied here
+		const auto previous = slot.buffer.cdata();
+		slot.buffer.Clear();
+		if (slot.buffer.cdata() == previous)
+		{
+			++recycled_;
+		}
+		else
+		{
+			++reallocated_;
+		}
+		if (slot.buffer.capacity() < size)
+		{
+			slot.buffer.EnsureCapacity(size);
+		}
+		slot.buffer.SetSize(slot.buffer.capacity());
+
+		*data = slot.buffer.data();
+		*capacity = static_cast<uint32_t>(slot.buffer.size());
+		return buffer;
+	}
+
+	bool SendBufferPool::Take(int32_t buffer, uint32_t length, rtc::CopyOnWriteBuffer* payload)
+	{
+		rtc::CritScope lock(&crit_);
+		if (!IsOutstanding(buffer))
+		{
+			return false;
+		}
+		auto& slot = slots_[buffer];
+		RTC_DCHECK_LE(length, slot.buffer.size());
+		slot.buffer.SetSize(std::min<size_t>(length, slot.buffer.size()));
+		*payload = slot.buffer;
+		slot.outstanding = false;
+		free_.push_back(buffer);
+		return true;
+	}
+
+	void SendBufferPool::Return(int32_t buffer)
+	{
+		rtc::CritScope lock(&crit_);
+		if (!IsOutstanding(buffer))
+		{
+			return;
+		}
+		slots_[buffer].outstanding = false;
+		free_.push_back(buffer);
+	}
+
+	bool SendBufferPool::IsOutstanding(int32_t buffer) const
+	{
+		return buffer >= 0 && static_cast<size_t>(buffer) < slots_.size() && slots_[buffer].outstanding;
+	}
+
+	RtcSendBufferPoolStats SendBufferPool::GetStats() const
+	{
+		rtc::CritScope lock(&crit_);
+		RtcSendBufferPoolStats stats{};
+		stats.buffers = static_cast<uint32_t>(slots_.size());
+		stats.outstanding = static_cast<uint32_t>(slots_.size() - free_.size());
+		stats.acquired = acquired_;
+		stats.recycled = recycled_;
+		stats.reallocated = reallocated_;
+		stats.exhausted = exhausted_;
+		return stats;
+	}
+}
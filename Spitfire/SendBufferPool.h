@@ -0,0 +1,67 @@
+#pragma once
+
+#include "rtc_base/copy_on_write_buffer.h"
+#include "rtc_base/critical_section.h"
+
+#include <vector>
+
+namespace Spitfire
+{
+	struct RtcSendBufferPoolStats
+	{
+		uint32_t buffers;
+		// buffers handed to the application and not yet sent or returned
+		uint32_t outstanding;
+		uint64_t acquired;
+		// acquisitions that reused the memory of an earlier send
+		uint64_t recycled;
+		// acquisitions that needed fresh memory because WebRTC still queued the earlier send
+		uint64_t reallocated;
+		// acquisitions refused because every buffer was outstanding
+		uint64_t exhausted;
+	};
+
+	// A fixed set of send buffers the application writes its payload into directly.
+	// Sending shares the buffer with WebRTC instead of copying it, the memory is reused for the
+	// next acquisition once WebRTC dropped its reference, which happens as soon as SCTP took the message.
+	class SendBufferPool
+	{
+	public:
+		static const int32_t kInvalidBuffer = -1;
+
+		SendBufferPool(uint32_t buffers, uint32_t buffer_size);
+
+		SendBufferPool(const SendBufferPool&) = delete;
+		SendBufferPool& operator=(const SendBufferPool&) = delete;
+
+		// Hands out a buffer with room for at least |size| bytes, or kInvalidBuffer when all of them are outstanding.
+		// |data| stays writable until the buffer is taken or returned.
+		int32_t Acquire(uint32_t size, uint8_t** data, uint32_t* capacity);
+
+		// Trims the buffer to |length| bytes, shares it into |payload| and puts the buffer back into the pool.
+		bool Take(int32_t buffer, uint32_t length, rtc::CopyOnWriteBuffer* payload);
+
+		// Puts an acquired buffer back without sending it.
+		void Return(int32_t buffer);
+
+		RtcSendBufferPoolStats GetStats() const;
+
+	private:
+		struct Slot
+		{
+			rtc::CopyOnWriteBuffer buffer;
+			bool outstanding = false;
+		};
+
+		bool IsOutstanding(int32_t buffer) const;
+
+		std::vector<Slot> slots_;
+		std::vector<int32_t> free_;
+		rtc::CriticalSection crit_;
+
+		uint64_t acquired_ = 0;
+		uint64_t recycled_ = 0;
+		uint64_t reallocated_ = 0;
+		uint64_t exhausted_ = 0;
+	};
+}
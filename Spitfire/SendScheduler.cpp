@@ -0,0 +1,281 @@
+#include "SendScheduler.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+
+namespace Spitfire
+{
+	// bytes a channel of weight one may send per round, about one large SCTP message
+	static const uint64_t kQuantumBytes = 16 * 1024;
+
+	SendScheduler::SendScheduler(rtc::Thread* thread, uint64_t budget_bytes) :
+		thread_(thread),
+		budget_bytes_(budget_bytes)
+	{
+	}
+
+	void SendScheduler::AddChannel(int32_t handle, std::function<bool(const webrtc::DataBuffer&)> send, std::function<uint64_t()> pending)
+	{
+		rtc::CritScope lock(&crit_);
+		auto& flow = flows_[handle];
+		flow.send = std::move(send);
+		flow.pending = std::move(pending);
+	}
+
+	void SendScheduler::OpenChannel(int32_t handle)
+	{
+		{
+			rtc::CritScope lock(&crit_);
+			const auto found = flows_.find(handle);
+			if (stopped_ || found == flows_.end() || found->second.open)
+			{
+				return;
+			}
+			auto& flow = found->second;
+			flow.open = true;
+			if (!flow.queue.empty())
+			{
+				Activate(handle, flow);
+			}
+		}
+		SchedulePump();
+	}
+
+	void SendScheduler::OnBufferedAmountChange(int32_t handle)
+	{
+		{
+			rtc::CritScope lock(&crit_);
+			const auto found = flows_.find(handle);
+			if (found != flows_.end())
+			{
+				RefreshBuffered(found->second);
+			}
+		}
+		SchedulePump();
+	}
+
+	void SendScheduler::RemoveChannel(int32_t handle)
+	{
+		rtc::CritScope lock(&crit_);
+		const auto flow = flows_.find(handle);
+		if (flow == flows_.end())
+		{
+			return;
+		}
+		DropQueue(flow->second);
+		buffered_ -= flow->second.buffered;
+		flows_.erase(flow);
+	}
+
+	bool SendScheduler::SetPriority(int32_t handle, RtcSendPriority priority, uint32_t weight)
+	{
+		rtc::CritScope lock(&crit_);
+		const auto found = flows_.find(handle);
+		if (found == flows_.end())
+		{
+			return false;
+		}
+		auto& flow = found->second;
+		if (flow.priority != priority)
+		{
+			// move the backlog over to the new class, held messages of a channel that is not open yet as well
+			auto& previous = classes_[static_cast<size_t>(flow.priority)];
+			for (auto& pending : flow.queue)
+			{
+				--previous.stats.queuedMessages;
+				previous.stats.queuedBytes -= pending.buffer.size();
+				++classes_[static_cast<size_t>(priority)].stats.queuedMessages;
+				classes_[static_cast<size_t>(priority)].stats.queuedBytes += pending.buffer.size();
+			}
+			if (flow.active)
+			{
+				previous.active.erase(std::remove(previous.active.begin(), previous.active.end(), handle), previous.active.end());
+				classes_[static_cast<size_t>(priority)].active.push_back(handle);
+			}
+		}
+		flow.priority = priority;
+		flow.weight = std::max(weight, 1u);
+		return true;
+	}
+
+	bool SendScheduler::Enqueue(int32_t handle, webrtc::DataBuffer buffer)
+	{
+		{
+			rtc::CritScope lock(&crit_);
+			const auto found = flows_.find(handle);
+			if (stopped_ || found == flows_.end())
+			{
+				return false;
+			}
+			auto& flow = found->second;
+			auto& klass = classes_[static_cast<size_t>(flow.priority)];
+			++klass.stats.queuedMessages;
+			klass.stats.queuedBytes += buffer.size();
+			flow.queue.push_back(PendingSend{ std::move(buffer), rtc::TimeMicros() });
+			// a channel that is not open yet keeps its messages until OpenChannel, they would only fail to send
+			if (!flow.open)
+			{
+				return true;
+			}
+			if (!flow.active)
+			{
+				Activate(handle, flow);
+			}
+		}
+		SchedulePump();
+		return true;
+	}
+
+	void SendScheduler::Stop()
+	{
+		rtc::CritScope lock(&crit_);
+		stopped_ = true;
+		for (auto& flow : flows_)
+		{
+			DropQueue(flow.second);
+		}
+		flows_.clear();
+		buffered_ = 0;
+	}
+
+	void SendScheduler::Activate(int32_t handle, Flow& flow)
+	{
+		// crit_ is held
+		flow.active = true;
+		flow.deficit = 0;
+		classes_[static_cast<size_t>(flow.priority)].active.push_back(handle);
+	}
+
+	void SendScheduler::RefreshBuffered(Flow& flow)
+	{
+		// crit_ is held
+		buffered_ -= flow.buffered;
+		flow.buffered = flow.pending();
+		buffered_ += flow.buffered;
+	}
+
+	void SendScheduler::SchedulePump()
+	{
+		// one pending pump is enough, it sends until the budget or the queues run out
+		if (pump_scheduled_.exchange(true))
+		{
+			return;
+		}
+		std::weak_ptr<SendScheduler> weak_self = shared_from_this();
+		thread_->PostTask(RTC_FROM_HERE, [weak_self]
+		{
+			if (auto self = weak_self.lock())
+			{
+				self->pump_scheduled_ = false;
+				self->Pump();
+			}
+		});
+	}
+
+	void SendScheduler::Pump()
+	{
+		RTC_DCHECK(thread_->IsCurrent());
+		PendingSend next{ webrtc::DataBuffer(std::string()), 0 };
+		int32_t handle = 0;
+		std::function<bool(const webrtc::DataBuffer&)> send;
+		size_t klass = 0;
+
+		// the next OnBufferedAmountChange pumps again once the channels drained below the budget
+		while (Next(&next, &handle, &send, &klass))
+		{
+			const auto sent = send(next.buffer);
+
+			const auto delay_us = rtc::TimeMicros() - next.queuedAtUs;
+			rtc::CritScope lock(&crit_);
+			// only the channel that just sent buffers more
+			const auto flow = flows_.find(handle);
+			if (flow != flows_.end())
+			{
+				RefreshBuffered(flow->second);
+			}
+			auto& stats = classes_[klass].stats;
+			if (sent)
+			{
+				++stats.sentMessages;
+				stats.lastDelayUs = delay_us;
+				stats.averageDelayUs += (delay_us - stats.averageDelayUs) / 8;
+				stats.maxDelayUs = std::max(stats.maxDelayUs, delay_us);
+			}
+			else
+			{
+				++stats.droppedMessages;
+			}
+		}
+	}
+
+	bool SendScheduler::Next(PendingSend* next, int32_t* channel, std::function<bool(const webrtc::DataBuffer&)>* send, size_t* klass)
+	{
+		rtc::CritScope lock(&crit_);
+		if (buffered_ >= budget_bytes_)
+		{
+			return false;
+		}
+		for (size_t index = 0; index < kSendPriorityClasses; ++index)
+		{
+			auto& active = classes_[index].active;
+			while (!active.empty())
+			{
+				const auto handle = active.front();
+				const auto found = flows_.find(handle);
+				if (found == flows_.end() || found->second.queue.empty())
+				{
+					active.pop_front();
+					continue;
+				}
+				auto& flow = found->second;
+				const auto size = flow.queue.front().buffer.size();
+				if (flow.deficit < size)
+				{
+					// not enough credit for its next message, top it up and let the next channel go first
+					flow.deficit += kQuantumBytes * flow.weight;
+					active.pop_front();
+					active.push_back(handle);
+					continue;
+				}
+				flow.deficit -= size;
+				*next = std::move(flow.queue.front());
+				flow.queue.pop_front();
+				*channel = found->first;
+				*send = flow.send;
+				*klass = index;
+
+				auto& stats = classes_[index].stats;
+				--stats.queuedMessages;
+				stats.queuedBytes -= size;
+				if (flow.queue.empty())
+				{
+					flow.active = false;
+					flow.deficit = 0;
+					active.pop_front();
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void SendScheduler::DropQueue(Flow& flow)
+	{
+		auto& klass = classes_[static_cast<size_t>(flow.priority)];
+		for (auto& pending : flow.queue)
+		{
+			--klass.stats.queuedMessages;
+			klass.stats.queuedBytes -= pending.buffer.size();
+			++klass.stats.droppedMessages;
+		}
+		flow.queue.clear();
+		// the entry left in the round-robin list is skipped by Next
+		flow.active = false;
+	}
+
+	RtcSendClassStats SendScheduler::GetClassStats(RtcSendPriority priority) const
+	{
+		rtc::CritScope lock(&crit_);
+		return classes_[static_cast<size_t>(priority)].stats;
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "api/data_channel_interface.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/thread.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+namespace Spitfire
+{
+	enum class RtcSendPriority
+	{
+		// Always sent first, for small latency critical messages such as input.
+		Critical = 0,
+		High = 1,
+		Normal = 2,
+		// Only sent while no other class has anything waiting.
+		Bulk = 3
+	};
+
+	static const size_t kSendPriorityClasses = 4;
+
+	struct RtcSendClassStats
+	{
+		uint32_t queuedMessages;
+		uint64_t queuedBytes;
+		uint64_t sentMessages;
+		uint64_t droppedMessages;
+		// time messages of the class spent in the scheduler before reaching the data channel
+		int64_t lastDelayUs;
+		int64_t averageDelayUs;
+		int64_t maxDelayUs;
+	};
+
+	// Orders the sends of all data channels of a peer before they reach WebRTC.
+	// Classes are served in strict priority, channels within a class share it by deficit round-robin
+	// according to their weight. Messages are only released while the channels together buffer less
+	// than |budget_bytes|, whatever WebRTC queued already can no longer be reordered.
+	// All sending happens on |thread|, the thread the data channels live on.
+	class SendScheduler : public std::enable_shared_from_this<SendScheduler>
+	{
+	public:
+		SendScheduler(rtc::Thread* thread, uint64_t budget_bytes);
+
+		SendScheduler(const SendScheduler&) = delete;
+		SendScheduler& operator=(const SendScheduler&) = delete;
+
+		// New channels start in RtcSendPriority::Normal with a weight of one, their messages are held until OpenChannel.
+		// |send| takes a message of the channel, |pending| tells how much of its data waits to go out.
+		void AddChannel(int32_t handle, std::function<bool(const webrtc::DataBuffer&)> send, std::function<uint64_t()> pending);
+		// Starts releasing the messages of the channel, calling it again does nothing.
+		void OpenChannel(int32_t handle);
+		void RemoveChannel(int32_t handle);
+		bool SetPriority(int32_t handle, RtcSendPriority priority, uint32_t weight);
+
+		// Queues |buffer| for the channel, can be called from any thread. Messages of a channel that is not
+		// open yet wait until it opens and are dropped if it closes first.
+		bool Enqueue(int32_t handle, webrtc::DataBuffer buffer);
+
+		// Lets the scheduler release more messages once the channel drained.
+		void OnBufferedAmountChange(int32_t handle);
+
+		// Drops everything queued, the scheduler does nothing afterwards.
+		void Stop();
+
+		RtcSendClassStats GetClassStats(RtcSendPriority priority) const;
+
+	private:
+		struct PendingSend
+		{
+			webrtc::DataBuffer buffer;
+			int64_t queuedAtUs;
+		};
+
+		struct Flow
+		{
+			std::function<bool(const webrtc::DataBuffer&)> send;
+			std::function<uint64_t()> pending;
+			RtcSendPriority priority = RtcSendPriority::Normal;
+			uint32_t weight = 1;
+			uint64_t deficit = 0;
+			bool open = false;
+			bool active = false;
+			// what |pending| said last time, part of buffered_
+			uint64_t buffered = 0;
+			std::deque<PendingSend> queue;
+		};
+
+		struct ClassState
+		{
+			// channels of the class with queued messages, in round-robin order
+			std::deque<int32_t> active;
+			RtcSendClassStats stats{};
+		};
+
+		void SchedulePump();
+		void Pump();
+		bool Next(PendingSend* next, int32_t* channel, std::function<bool(const webrtc::DataBuffer&)>* send, size_t* klass);
+		void Activate(int32_t handle, Flow& flow);
+		void RefreshBuffered(Flow& flow);
+		void DropQueue(Flow& flow);
+
+		rtc::Thread* thread_;
+		const uint64_t budget_bytes_;
+
+		std::unordered_map<int32_t, Flow> flows_;
+		ClassState classes_[kSendPriorityClasses];
+		// sum of Flow::buffered, so the budget check does not ask every channel on every message
+		uint64_t buffered_ = 0;
+		rtc::CriticalSection crit_;
+
+		std::atomic<bool> pump_scheduled_{ false };
+		bool stopped_ = false;
+	};
+}
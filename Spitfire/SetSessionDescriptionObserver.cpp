@@ -8,4 +8,9 @@ void Spitfire::Observers::SetSessionDescriptionObserver::OnFailure(const std::st
 void Spitfire::Observers::SetSessionDescriptionObserver::OnSuccess()
 {
 	//RTC_LOG(INFO) << __FUNCTION__;
+	if (remote_)
+	{
+		conductor_->MarkMilestone(RtcMilestone::RemoteDescriptionSet);
+	}
+	conductor_->WatchSctpTransport();
 }
\ No newline at end of file
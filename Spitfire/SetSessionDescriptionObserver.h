@@ -13,8 +13,10 @@ namespace Spitfire
 		class SetSessionDescriptionObserver : public webrtc::SetSessionDescriptionObserver
 		{
 		public:
-			explicit SetSessionDescriptionObserver(RtcConductor* conductor) :
-				conductor_(conductor)
+			// |remote| observers are handed to SetRemoteDescription
+			SetSessionDescriptionObserver(RtcConductor* conductor, bool remote) :
+				conductor_(conductor),
+				remote_(remote)
 			{
 			}
 			~SetSessionDescriptionObserver() = default;
@@ -40,6 +42,7 @@ namespace Spitfire
 		private:
 			mutable webrtc::webrtc_impl::RefCounter ref_count_{ 0 };
 			RtcConductor* conductor_;
+			const bool remote_;
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,731 @@
+#include "SpitfireApi.h"
+#include "AsyncLogSink.h"
+#include "PeerPool.h"
+#include "RtcConductor.h"
+#include "RingTracer.h"
+#include "rtc_base/helpers.h"
+#include "rtc_base/ssl_adapter.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(WEBRTC_WIN)
+#include "rtc_base/win32_socket_init.h"
+#endif
+
+struct spitfire_engine
+{
+	std::shared_ptr<Spitfire::RtcEngine> engine;
+};
+
+struct spitfire_peer
+{
+	std::unique_ptr<Spitfire::RtcConductor> conductor;
+	uint16_t min_port = 0;
+	uint16_t max_port = 0;
+	// holds the drained messages so their data outlives spitfire_peer_drain_messages
+	std::vector<Spitfire::RtcInboundMessage> drained;
+};
+
+struct spitfire_peer_pool
+{
+	std::unique_ptr<Spitfire::PeerPool> pool;
+};
+
+static std::string ToString(const char* text)
+{
+	return text ? std::string(text) : std::string();
+}
+
+static void CopySummary(const Spitfire::RtcLatencySummary& from, spitfire_latency_summary* to)
+{
+	to->count = from.count;
+	to->mean_ns = from.meanNs;
+	to->p50_ns = from.p50Ns;
+	to->p90_ns = from.p90Ns;
+	to->p99_ns = from.p99Ns;
+	to->p999_ns = from.p999Ns;
+	to->max_ns = from.maxNs;
+}
+
+static void CopyCandidate(const Spitfire::RtcCandidateInfo& from, spitfire_candidate_info* to)
+{
+	to->type = static_cast<int32_t>(from.type);
+	to->is_tcp = from.tcp ? 1 : 0;
+	to->port = from.port;
+	static_assert(sizeof(to->address) == sizeof(from.address), "candidate addresses must match");
+	std::memcpy(to->address, from.address, sizeof(to->address));
+}
+
+static void CopyFields(const Spitfire::RtcCandidateFields& from, spitfire_candidate_fields* to)
+{
+	static_assert(sizeof(to->foundation) == sizeof(from.foundation) && sizeof(to->address) == sizeof(from.address)
+		&& sizeof(to->related_address) == sizeof(from.relatedAddress) && sizeof(to->ufrag) == sizeof(from.ufrag), "candidate fields must match");
+	std::memcpy(to->foundation, from.foundation, sizeof(to->foundation));
+	to->component = from.component;
+	to->is_tcp = from.tcp ? 1 : 0;
+	to->priority = from.priority;
+	std::memcpy(to->address, from.address, sizeof(to->address));
+	to->port = from.port;
+	to->type = static_cast<int32_t>(from.type);
+	std::memcpy(to->related_address, from.relatedAddress, sizeof(to->related_address));
+	to->related_port = from.relatedPort;
+	to->generation = from.generation;
+	std::memcpy(to->ufrag, from.ufrag, sizeof(to->ufrag));
+	to->network_id = from.networkId;
+	to->network_cost = from.networkCost;
+}
+
+static spitfire_peer_stats ToPeerStats(const Spitfire::RtcPeerStats& from)
+{
+	spitfire_peer_stats to{};
+	to.peer = from.peer;
+	to.timestamp_us = from.timestampUs;
+	to.has_selected_pair = from.hasSelectedPair ? 1 : 0;
+	CopyCandidate(from.localCandidate, &to.local_candidate);
+	CopyCandidate(from.remoteCandidate, &to.remote_candidate);
+	to.current_round_trip_time_ms = from.currentRoundTripTimeMs;
+	to.total_round_trip_time_ms = from.totalRoundTripTimeMs;
+	to.available_outgoing_bitrate = from.availableOutgoingBitrate;
+	to.pair_bytes_sent = from.pairBytesSent;
+	to.pair_bytes_received = from.pairBytesReceived;
+	to.requests_sent = from.requestsSent;
+	to.responses_received = from.responsesReceived;
+	to.candidate_pairs = from.candidatePairs;
+	to.dtls_state = static_cast<int32_t>(from.dtlsState);
+	to.transport_bytes_sent = from.transportBytesSent;
+	to.transport_bytes_received = from.transportBytesReceived;
+	to.selected_candidate_pair_changes = from.selectedCandidatePairChanges;
+	to.data_channels_opened = from.dataChannelsOpened;
+	to.data_channels_closed = from.dataChannelsClosed;
+	to.messages_sent = from.messagesSent;
+	to.messages_received = from.messagesReceived;
+	to.bytes_sent = from.bytesSent;
+	to.bytes_received = from.bytesReceived;
+	to.buffered_amount = from.bufferedAmount;
+	return to;
+}
+
+static void AppendProtocol(std::string& protocol, const char* token)
+{
+	protocol += protocol.empty() ? token : std::string(" ") + token;
+}
+
+void SPITFIRE_CALL spitfire_initialize(void)
+{
+#if defined(WEBRTC_WIN)
+	static rtc::WinsockInitializer winsock;
+#endif
+	rtc::InitializeSSL();
+	rtc::InitRandom(static_cast<int>(rtc::Time()));
+}
+
+void SPITFIRE_CALL spitfire_cleanup(void)
+{
+	rtc::CleanupSSL();
+}
+
+int32_t SPITFIRE_CALL spitfire_logging_enable(int32_t verbosity, const char* directory, uint64_t max_log_size, uint32_t max_files,
+	uint32_t records, int32_t binary)
+{
+	if (!directory)
+	{
+		return 0;
+	}
+	Spitfire::RtcLogSinkOptions options;
+	if (records > 0)
+	{
+		options.records = records;
+	}
+	options.binary = binary != 0;
+	return Spitfire::AsyncLogSink::Enable(directory, "spitfire", max_log_size, max_files, static_cast<rtc::LoggingSeverity>(verbosity), options) ? 1 : 0;
+}
+
+void SPITFIRE_CALL spitfire_logging_disable(void)
+{
+	Spitfire::AsyncLogSink::Disable();
+}
+
+int32_t SPITFIRE_CALL spitfire_logging_get_stats(spitfire_log_stats* stats)
+{
+	Spitfire::RtcLogSinkStats native_stats{};
+	if (!stats || !Spitfire::AsyncLogSink::GetEnabledStats(&native_stats))
+	{
+		return 0;
+	}
+	stats->written = native_stats.written;
+	stats->dropped = native_stats.dropped;
+	stats->truncated = native_stats.truncated;
+	stats->bytes_written = native_stats.bytesWritten;
+	stats->high_watermark = native_stats.highWatermark;
+	return 1;
+}
+
+void SPITFIRE_CALL spitfire_tracing_start(uint32_t events_per_thread)
+{
+	Spitfire::RingTracer::Start(events_per_thread);
+}
+
+void SPITFIRE_CALL spitfire_tracing_stop(void)
+{
+	Spitfire::RingTracer::Stop();
+}
+
+int32_t SPITFIRE_CALL spitfire_tracing_write(const char* path)
+{
+	return path && Spitfire::RingTracer::WriteJson(path) ? 1 : 0;
+}
+
+spitfire_engine* SPITFIRE_CALL spitfire_engine_create(uint32_t network_threads, int32_t shard_policy)
+{
+	Spitfire::RtcEngineOptions options;
+	options.networkThreads = network_threads;
+	options.shardPolicy = static_cast<Spitfire::RtcShardPolicy>(shard_policy);
+	auto engine = Spitfire::RtcEngine::Create(options);
+	return engine ? new spitfire_engine{ std::move(engine) } : nullptr;
+}
+
+spitfire_engine* SPITFIRE_CALL spitfire_engine_shared(void)
+{
+	auto engine = Spitfire::RtcEngine::Shared();
+	return engine ? new spitfire_engine{ std::move(engine) } : nullptr;
+}
+
+void SPITFIRE_CALL spitfire_engine_shutdown_shared(void)
+{
+	Spitfire::RtcEngine::ShutdownShared();
+}
+
+void SPITFIRE_CALL spitfire_engine_release(spitfire_engine* engine)
+{
+	delete engine;
+}
+
+uint32_t SPITFIRE_CALL spitfire_engine_peer_count(const spitfire_engine* engine)
+{
+	return engine ? engine->engine->PeerCount() : 0;
+}
+
+int32_t SPITFIRE_CALL spitfire_engine_wait_for_activity(spitfire_engine* engine, int32_t give_up_after_ms)
+{
+	return engine && engine->engine->WaitForActivity(give_up_after_ms) ? 1 : 0;
+}
+
+void SPITFIRE_CALL spitfire_engine_start_stats_polling(spitfire_engine* engine, int32_t interval_ms, spitfire_stats_callback callback, void* user_data)
+{
+	if (!engine || !callback)
+	{
+		return;
+	}
+	// reused between rounds, they are delivered one at a time on the signaling thread
+	auto report = std::make_shared<std::vector<spitfire_peer_stats>>();
+	engine->engine->StartStatsPolling(interval_ms, [callback, user_data, report](const std::vector<Spitfire::RtcPeerStats>& stats)
+	{
+		report->clear();
+		for (const auto& peer_stats : stats)
+		{
+			report->push_back(ToPeerStats(peer_stats));
+		}
+		callback(user_data, report->data(), static_cast<uint32_t>(report->size()));
+	});
+}
+
+void SPITFIRE_CALL spitfire_engine_stop_stats_polling(spitfire_engine* engine)
+{
+	if (engine)
+	{
+		engine->engine->StopStatsPolling();
+	}
+}
+
+void SPITFIRE_CALL spitfire_engine_enable_certificate_pool(spitfire_engine* engine, uint32_t pool_size, int32_t shared)
+{
+	if (engine)
+	{
+		engine->engine->EnableCertificatePool(pool_size, shared != 0);
+	}
+}
+
+void SPITFIRE_CALL spitfire_engine_get_certificate_pool_stats(const spitfire_engine* engine, spitfire_certificate_pool_stats* stats)
+{
+	if (!engine || !stats)
+	{
+		return;
+	}
+	const auto native_stats = engine->engine->GetCertificatePoolStats();
+	stats->available = native_stats.available;
+	stats->generated = native_stats.generated;
+	stats->hits = native_stats.hits;
+	stats->misses = native_stats.misses;
+	stats->generate_mean_us = native_stats.generateMeanUs;
+}
+
+spitfire_peer* SPITFIRE_CALL spitfire_peer_create(spitfire_engine* engine, uint16_t min_port, uint16_t max_port)
+{
+	auto peer = new spitfire_peer();
+	peer->conductor.reset(new Spitfire::RtcConductor(engine ? engine->engine : std::shared_ptr<Spitfire::RtcEngine>()));
+	peer->min_port = min_port;
+	peer->max_port = max_port;
+	return peer;
+}
+
+void SPITFIRE_CALL spitfire_peer_destroy(spitfire_peer* peer)
+{
+	if (!peer)
+	{
+		return;
+	}
+	peer->conductor->DeletePeerConnection();
+	delete peer;
+}
+
+spitfire_peer_pool* SPITFIRE_CALL spitfire_peer_pool_create(spitfire_engine* engine, uint32_t peers, uint16_t min_port, uint16_t max_port,
+	int32_t ice_candidate_pool_size, const spitfire_ice_server* servers, uint32_t server_count)
+{
+	Spitfire::RtcPeerPoolOptions options;
+	options.peers = peers;
+	options.minPort = min_port;
+	options.maxPort = max_port;
+	options.iceCandidatePoolSize = ice_candidate_pool_size;
+	for (uint32_t i = 0; servers && i < server_count; ++i)
+	{
+		webrtc::PeerConnectionInterface::IceServer server;
+		server.uri = ToString(servers[i].uri);
+		server.username = ToString(servers[i].username);
+		server.password = ToString(servers[i].password);
+		options.servers.push_back(server);
+	}
+	auto pool = new spitfire_peer_pool();
+	pool->pool.reset(new Spitfire::PeerPool(engine ? engine->engine : std::shared_ptr<Spitfire::RtcEngine>(), options));
+	return pool;
+}
+
+void SPITFIRE_CALL spitfire_peer_pool_destroy(spitfire_peer_pool* pool)
+{
+	delete pool;
+}
+
+spitfire_peer* SPITFIRE_CALL spitfire_peer_pool_acquire(spitfire_peer_pool* pool)
+{
+	auto conductor = pool->pool->Acquire();
+	if (!conductor)
+	{
+		return nullptr;
+	}
+	auto peer = new spitfire_peer();
+	peer->conductor = std::move(conductor);
+	return peer;
+}
+
+void SPITFIRE_CALL spitfire_peer_pool_get_stats(const spitfire_peer_pool* pool, spitfire_peer_pool_stats* stats)
+{
+	if (!pool || !stats)
+	{
+		return;
+	}
+	const auto native_stats = pool->pool->GetStats();
+	stats->available = native_stats.available;
+	stats->built = native_stats.built;
+	stats->hits = native_stats.hits;
+	stats->misses = native_stats.misses;
+	stats->expired = native_stats.expired;
+	stats->build_mean_us = native_stats.buildMeanUs;
+}
+
+void SPITFIRE_CALL spitfire_peer_set_callbacks(spitfire_peer* peer, const spitfire_callbacks* callbacks)
+{
+	// every binding captures its own copy, so nothing refers back to |callbacks|
+	const auto c = callbacks ? *callbacks : spitfire_callbacks{};
+	auto conductor = peer->conductor.get();
+	conductor->onSuccess = nullptr;
+	if (c.on_sdp)
+	{
+		conductor->onSuccess = [c](const char* type, const char* sdp) { c.on_sdp(c.user_data, type, sdp); };
+	}
+	conductor->onFailure = nullptr;
+	if (c.on_failure)
+	{
+		conductor->onFailure = [c](const char* error) { c.on_failure(c.user_data, error); };
+	}
+	conductor->onIceCandidate = nullptr;
+	if (c.on_ice_candidate)
+	{
+		conductor->onIceCandidate = [c](const char* sdp_mid, int32_t sdp_mline_index, const char* sdp)
+		{
+			c.on_ice_candidate(c.user_data, sdp_mid, sdp_mline_index, sdp);
+		};
+	}
+	conductor->onIceCandidateFields = nullptr;
+	if (c.on_ice_candidate_fields)
+	{
+		conductor->onIceCandidateFields = [c](const char* sdp_mid, int32_t sdp_mline_index, const char* sdp, const Spitfire::RtcCandidateFields* fields)
+		{
+			spitfire_candidate_fields copy;
+			CopyFields(*fields, &copy);
+			c.on_ice_candidate_fields(c.user_data, sdp_mid, sdp_mline_index, sdp, &copy);
+		};
+	}
+	conductor->onIceCandidates = nullptr;
+	if (c.on_ice_candidates)
+	{
+		conductor->onIceCandidates = [c](const Spitfire::RtcIceCandidate* candidates, uint32_t count, bool complete)
+		{
+			const auto with_fields = std::any_of(candidates, candidates + count, [](const Spitfire::RtcIceCandidate& candidate)
+			{
+				return candidate.fields != nullptr;
+			});
+			if (!with_fields)
+			{
+				c.on_ice_candidates(c.user_data, reinterpret_cast<const spitfire_ice_candidate*>(candidates), count, complete ? 1 : 0);
+				return;
+			}
+			// the fields differ in layout, so the candidates pointing at them are copied as well
+			std::vector<spitfire_candidate_fields> fields(count);
+			std::vector<spitfire_ice_candidate> batch(count);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				if (candidates[i].fields)
+				{
+					CopyFields(*candidates[i].fields, &fields[i]);
+				}
+				batch[i] = spitfire_ice_candidate{ candidates[i].sdpMid, candidates[i].sdpMlineIndex, candidates[i].sdp, candidates[i].fields ? &fields[i] : nullptr };
+			}
+			c.on_ice_candidates(c.user_data, batch.data(), count, complete ? 1 : 0);
+		};
+	}
+	conductor->onIceStateChange = nullptr;
+	if (c.on_ice_state)
+	{
+		conductor->onIceStateChange = [c](webrtc::PeerConnectionInterface::IceConnectionState state)
+		{
+			c.on_ice_state(c.user_data, static_cast<int32_t>(state));
+		};
+	}
+	conductor->onIceGatheringStateChange = nullptr;
+	if (c.on_ice_gathering_state)
+	{
+		conductor->onIceGatheringStateChange = [c](webrtc::PeerConnectionInterface::IceGatheringState state)
+		{
+			c.on_ice_gathering_state(c.user_data, static_cast<int32_t>(state));
+		};
+	}
+	conductor->onDataChannelState = nullptr;
+	if (c.on_channel_state)
+	{
+		conductor->onDataChannelState = [c](int32_t channel, const char* label, webrtc::DataChannelInterface::DataState state)
+		{
+			c.on_channel_state(c.user_data, channel, label, static_cast<int32_t>(state));
+		};
+	}
+	conductor->onMessage = nullptr;
+	if (c.on_message)
+	{
+		conductor->onMessage = [c](int32_t channel, const uint8_t* data, uint32_t length, bool is_binary)
+		{
+			c.on_message(c.user_data, channel, data, length, is_binary ? 1 : 0);
+		};
+	}
+	conductor->onLeasedMessage = nullptr;
+	if (c.on_leased_message)
+	{
+		conductor->onLeasedMessage = [c](int32_t channel, uint64_t lease, const uint8_t* data, uint32_t length, bool is_binary)
+		{
+			c.on_leased_message(c.user_data, channel, lease, data, length, is_binary ? 1 : 0);
+		};
+	}
+	conductor->onBufferAmountChange = nullptr;
+	if (c.on_buffered_amount)
+	{
+		conductor->onBufferAmountChange = [c](int32_t channel, uint64_t previous_amount, uint64_t current_amount, uint64_t bytes_sent, uint64_t bytes_received)
+		{
+			c.on_buffered_amount(c.user_data, channel, previous_amount, current_amount, bytes_sent, bytes_received);
+		};
+	}
+	conductor->onWritable = nullptr;
+	if (c.on_writable)
+	{
+		conductor->onWritable = [c](int32_t channel) { c.on_writable(c.user_data, channel); };
+	}
+}
+
+void SPITFIRE_CALL spitfire_peer_set_affinity_key(spitfire_peer* peer, uint64_t key)
+{
+	peer->conductor->SetAffinityKey(key);
+}
+
+void SPITFIRE_CALL spitfire_peer_set_message_pump(spitfire_peer* peer, int32_t pump)
+{
+	peer->conductor->SetMessagePump(static_cast<Spitfire::RtcMessagePump>(pump));
+}
+
+void SPITFIRE_CALL spitfire_peer_set_ice_candidate_pool_size(spitfire_peer* peer, int32_t size)
+{
+	peer->conductor->SetIceCandidatePoolSize(size);
+}
+
+void SPITFIRE_CALL spitfire_peer_add_server_config(spitfire_peer* peer, const char* uri, const char* username, const char* password)
+{
+	peer->conductor->AddServerConfig(ToString(uri), ToString(username), ToString(password));
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_initialize(spitfire_peer* peer)
+{
+	return peer->conductor->InitializePeerConnection(peer->min_port, peer->max_port) ? 1 : 0;
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_process_messages(spitfire_peer* peer, int32_t delay_ms)
+{
+	return peer->conductor->ProcessMessages(delay_ms) ? 1 : 0;
+}
+
+uint64_t SPITFIRE_CALL spitfire_peer_id(const spitfire_peer* peer)
+{
+	return peer->conductor->PeerId();
+}
+
+void SPITFIRE_CALL spitfire_peer_get_connection_timeline(const spitfire_peer* peer, spitfire_connection_timeline* timeline)
+{
+	if (!timeline)
+	{
+		return;
+	}
+	static_assert(SPITFIRE_MILESTONE_COUNT == Spitfire::kMilestoneCount, "milestones of the C API and the conductor differ");
+	const auto native_timeline = peer->conductor->GetConnectionTimeline();
+	timeline->start_us = native_timeline.startUs;
+	std::copy(std::begin(native_timeline.offsetUs), std::end(native_timeline.offsetUs), timeline->offset_us);
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_request_stats(spitfire_peer* peer, spitfire_stats_callback callback, void* user_data)
+{
+	if (!callback)
+	{
+		return 0;
+	}
+	return peer->conductor->GetStats([callback, user_data](const Spitfire::RtcPeerStats& stats)
+	{
+		const auto flat = ToPeerStats(stats);
+		callback(user_data, &flat, 1);
+	}) ? 1 : 0;
+}
+
+void SPITFIRE_CALL spitfire_peer_create_offer(spitfire_peer* peer)
+{
+	peer->conductor->CreateOffer();
+}
+
+void SPITFIRE_CALL spitfire_peer_set_offer_reply(spitfire_peer* peer, const char* type, const char* sdp)
+{
+	peer->conductor->OnOfferReply(ToString(type), ToString(sdp));
+}
+
+void SPITFIRE_CALL spitfire_peer_set_offer_request(spitfire_peer* peer, const char* sdp)
+{
+	peer->conductor->OnOfferRequest(ToString(sdp));
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_add_ice_candidate(spitfire_peer* peer, const char* sdp_mid, int32_t sdp_mline_index, const char* sdp)
+{
+	return peer->conductor->AddIceCandidate(ToString(sdp_mid), sdp_mline_index, ToString(sdp)) ? 1 : 0;
+}
+
+uint32_t SPITFIRE_CALL spitfire_peer_add_ice_candidates(spitfire_peer* peer, const spitfire_ice_candidate* candidates, uint32_t count)
+{
+	static_assert(sizeof(spitfire_ice_candidate) == sizeof(Spitfire::RtcIceCandidate), "spitfire_ice_candidate must match RtcIceCandidate");
+	if (!candidates)
+	{
+		return 0;
+	}
+	return peer->conductor->AddIceCandidates(reinterpret_cast<const Spitfire::RtcIceCandidate*>(candidates), count);
+}
+
+int32_t SPITFIRE_CALL spitfire_parse_candidate(const char* sdp, uint32_t length, spitfire_candidate_fields* fields)
+{
+	Spitfire::RtcCandidateFields parsed;
+	const auto valid = Spitfire::CandidateParser::Parse(sdp, length, &parsed);
+	if (fields)
+	{
+		CopyFields(parsed, fields);
+	}
+	return valid ? 1 : 0;
+}
+
+void SPITFIRE_CALL spitfire_peer_enable_candidate_batching(spitfire_peer* peer, int32_t window_ms, uint32_t max_candidates)
+{
+	Spitfire::RtcCandidateBatchingOptions options;
+	options.windowMs = window_ms;
+	options.maxCandidates = max_candidates;
+	peer->conductor->EnableCandidateBatching(options);
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_create_data_channel(spitfire_peer* peer, const char* label, const spitfire_channel_options* options)
+{
+	webrtc::DataChannelInit dc_options;
+	if (options)
+	{
+		dc_options.id = options->id;
+		dc_options.ordered = options->ordered != 0;
+		dc_options.reliable = options->reliable != 0;
+		dc_options.negotiated = options->negotiated != 0;
+		if (options->max_retransmits >= 0)
+		{
+			dc_options.maxRetransmits.emplace(options->max_retransmits);
+		}
+		if (options->max_retransmit_time >= 0)
+		{
+			dc_options.maxRetransmitTime.emplace(options->max_retransmit_time);
+		}
+		dc_options.protocol = ToString(options->protocol);
+		if (options->features & SPITFIRE_CHANNEL_FRAGMENTED)
+		{
+			AppendProtocol(dc_options.protocol, Spitfire::kFragmentedProtocol);
+		}
+		if (options->features & SPITFIRE_CHANNEL_COALESCED)
+		{
+			AppendProtocol(dc_options.protocol, Spitfire::kCoalescedProtocol);
+		}
+		if (options->features & SPITFIRE_CHANNEL_COMPRESSED)
+		{
+			AppendProtocol(dc_options.protocol, Spitfire::kDeflateProtocol);
+		}
+	}
+	return peer->conductor->CreateDataChannel(ToString(label), dc_options);
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_find_data_channel(spitfire_peer* peer, const char* label)
+{
+	return peer->conductor->FindDataChannelHandle(ToString(label));
+}
+
+void SPITFIRE_CALL spitfire_peer_close_data_channel(spitfire_peer* peer, int32_t channel)
+{
+	peer->conductor->CloseDataChannel(channel);
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_get_data_channel_state(spitfire_peer* peer, int32_t channel)
+{
+	return static_cast<int32_t>(peer->conductor->GetDataChannelState(channel));
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_get_data_channel_info(spitfire_peer* peer, int32_t channel, spitfire_channel_info* info)
+{
+	const auto rtc_info = peer->conductor->GetDataChannelInfo(channel);
+	// an unknown channel reports this protocol, see RtcConductor::GetDataChannelInfo
+	if (rtc_info.protocol == "unknown")
+	{
+		return 0;
+	}
+	info->current_buffer = rtc_info.currentBuffer;
+	info->bytes_sent = rtc_info.bytesSent;
+	info->bytes_received = rtc_info.bytesReceived;
+	info->messages_sent = rtc_info.messagesSent;
+	info->messages_received = rtc_info.messagesReceived;
+	info->id = rtc_info.id;
+	info->state = static_cast<int32_t>(rtc_info.state);
+	info->reliable = rtc_info.reliable ? 1 : 0;
+	info->ordered = rtc_info.ordered ? 1 : 0;
+	info->negotiated = rtc_info.negotiated ? 1 : 0;
+	info->max_retransmits = rtc_info.maxRetransmits;
+	info->max_retransmit_time = rtc_info.maxRetransmitTime;
+	return 1;
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_send_text(spitfire_peer* peer, int32_t channel, const char* text, uint32_t length)
+{
+	return peer->conductor->DataChannelSendText(channel, std::string(text, length)) ? 1 : 0;
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_send_data(spitfire_peer* peer, int32_t channel, const uint8_t* data, uint32_t length)
+{
+	return peer->conductor->DataChannelSendData(channel, const_cast<uint8_t*>(data), length) ? 1 : 0;
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_try_send(spitfire_peer* peer, int32_t channel, const uint8_t* data, uint32_t length, int32_t is_binary)
+{
+	return static_cast<int32_t>(peer->conductor->TrySend(channel, data, length, is_binary != 0));
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_set_watermarks(spitfire_peer* peer, int32_t channel, uint64_t high, uint64_t low)
+{
+	return peer->conductor->SetDataChannelWatermarks(channel, high, low) ? 1 : 0;
+}
+
+void SPITFIRE_CALL spitfire_peer_enable_send_buffer_pool(spitfire_peer* peer, uint32_t buffers, uint32_t buffer_size)
+{
+	peer->conductor->EnableSendBufferPool(buffers, buffer_size);
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_acquire_send_buffer(spitfire_peer* peer, uint32_t size, uint8_t** data, uint32_t* capacity)
+{
+	return peer->conductor->AcquireSendBuffer(size, data, capacity);
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_send_buffer(spitfire_peer* peer, int32_t channel, int32_t buffer, uint32_t length)
+{
+	return peer->conductor->DataChannelSendBuffer(channel, buffer, length) ? 1 : 0;
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_try_send_buffer(spitfire_peer* peer, int32_t channel, int32_t buffer, uint32_t length)
+{
+	return static_cast<int32_t>(peer->conductor->TrySendBuffer(channel, buffer, length));
+}
+
+void SPITFIRE_CALL spitfire_peer_return_send_buffer(spitfire_peer* peer, int32_t buffer)
+{
+	peer->conductor->ReturnSendBuffer(buffer);
+}
+
+void SPITFIRE_CALL spitfire_peer_enable_inbound_queue(spitfire_peer* peer, uint32_t capacity, int32_t overflow_policy)
+{
+	peer->conductor->EnableInboundQueue(capacity, static_cast<Spitfire::RtcOverflowPolicy>(overflow_policy));
+}
+
+uint32_t SPITFIRE_CALL spitfire_peer_drain_messages(spitfire_peer* peer, spitfire_message* messages, uint32_t max_count)
+{
+	const auto count = peer->conductor->DrainMessages(max_count, peer->drained);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto& drained = peer->drained[i];
+		messages[i].channel = drained.channel;
+		messages[i].is_binary = drained.binary ? 1 : 0;
+		messages[i].data = drained.data.cdata();
+		messages[i].length = static_cast<uint32_t>(drained.data.size());
+	}
+	return static_cast<uint32_t>(count);
+}
+
+void SPITFIRE_CALL spitfire_peer_enable_leased_receive(spitfire_peer* peer, uint32_t max_leases, uint64_t max_bytes, int32_t leak_timeout_ms)
+{
+	peer->conductor->EnableLeasedReceive(max_leases, max_bytes, leak_timeout_ms);
+}
+
+int32_t SPITFIRE_CALL spitfire_peer_release_lease(spitfire_peer* peer, uint64_t lease)
+{
+	return peer->conductor->ReleaseLease(lease) ? 1 : 0;
+}
+
+void SPITFIRE_CALL spitfire_peer_enable_channel_metrics(spitfire_peer* peer)
+{
+	peer->conductor->EnableChannelMetrics();
+}
+
+uint32_t SPITFIRE_CALL spitfire_peer_drain_channel_metrics(spitfire_peer* peer, spitfire_channel_metrics* metrics, uint32_t max_count)
+{
+	// local, callers on several threads would share a vector of the peer
+	std::vector<Spitfire::RtcChannelMetrics> channels;
+	const auto count = peer->conductor->DrainChannelMetrics(channels, max_count);
+	for (size_t i = 0; i < channels.size(); ++i)
+	{
+		const auto& drained = channels[i];
+		metrics[i].channel = drained.channel;
+		CopySummary(drained.handoff, &metrics[i].handoff);
+		CopySummary(drained.buffered, &metrics[i].buffered);
+		CopySummary(drained.receive, &metrics[i].receive);
+		metrics[i].interval_ms = drained.intervalMs;
+		metrics[i].messages_sent_per_second = drained.messagesSentPerSecond;
+		metrics[i].bytes_sent_per_second = drained.bytesSentPerSecond;
+		metrics[i].messages_received_per_second = drained.messagesReceivedPerSecond;
+		metrics[i].bytes_received_per_second = drained.bytesReceivedPerSecond;
+	}
+	return static_cast<uint32_t>(count);
+}
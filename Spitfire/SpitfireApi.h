@@ -0,0 +1,436 @@
+#pragma once
+
+#ifndef SPITFIRE_API_H_
+#define SPITFIRE_API_H_
+
+// Flat C interface to the native engine, for callers that do not go through the C++/CLI SpitfireRtc class.
+// Every struct is blittable and every callback receives the user_data it was registered with,
+// so it can be bound from C, Rust, Go or .NET function pointers without any marshalling.
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(SPITFIRE_API_EXPORTS)
+#define SPITFIRE_API __declspec(dllexport)
+#else
+#define SPITFIRE_API __declspec(dllimport)
+#endif
+#define SPITFIRE_CALL __cdecl
+#else
+#define SPITFIRE_API __attribute__((visibility("default")))
+#define SPITFIRE_CALL
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spitfire_engine spitfire_engine;
+typedef struct spitfire_peer spitfire_peer;
+typedef struct spitfire_peer_pool spitfire_peer_pool;
+
+// Values match the managed enums of the same name.
+enum
+{
+	SPITFIRE_SHARD_LEAST_LOADED = 0,
+	SPITFIRE_SHARD_HASH = 1
+};
+
+enum
+{
+	SPITFIRE_PUMP_CALLER = 0,
+	SPITFIRE_PUMP_ENGINE = 1
+};
+
+enum
+{
+	SPITFIRE_CHANNEL_CONNECTING = 0,
+	SPITFIRE_CHANNEL_OPEN = 1,
+	SPITFIRE_CHANNEL_CLOSING = 2,
+	SPITFIRE_CHANNEL_CLOSED = 3
+};
+
+enum
+{
+	SPITFIRE_SEND_SENT = 0,
+	SPITFIRE_SEND_QUEUED = 1,
+	SPITFIRE_SEND_WOULD_BLOCK = 2,
+	SPITFIRE_SEND_CLOSED = 3
+};
+
+enum
+{
+	SPITFIRE_OVERFLOW_DROP_NEWEST = 0,
+	SPITFIRE_OVERFLOW_DROP_OLDEST = 1,
+	SPITFIRE_OVERFLOW_BLOCK = 2
+};
+
+// Features a channel negotiates through its protocol, both ends must ask for the same ones.
+enum
+{
+	SPITFIRE_CHANNEL_FRAGMENTED = 1,
+	SPITFIRE_CHANNEL_COALESCED = 2,
+	SPITFIRE_CHANNEL_COMPRESSED = 4
+};
+
+enum
+{
+	SPITFIRE_CANDIDATE_UNKNOWN = 0,
+	SPITFIRE_CANDIDATE_HOST = 1,
+	SPITFIRE_CANDIDATE_SERVER_REFLEXIVE = 2,
+	SPITFIRE_CANDIDATE_PEER_REFLEXIVE = 3,
+	SPITFIRE_CANDIDATE_RELAY = 4
+};
+
+enum
+{
+	SPITFIRE_DTLS_UNKNOWN = 0,
+	SPITFIRE_DTLS_NEW = 1,
+	SPITFIRE_DTLS_CONNECTING = 2,
+	SPITFIRE_DTLS_CONNECTED = 3,
+	SPITFIRE_DTLS_CLOSED = 4,
+	SPITFIRE_DTLS_FAILED = 5
+};
+
+// Values match RtcMilestone, they index spitfire_connection_timeline::offset_us.
+enum
+{
+	SPITFIRE_MILESTONE_STARTED = 0,
+	SPITFIRE_MILESTONE_DESCRIPTION_PARSED = 1,
+	SPITFIRE_MILESTONE_REMOTE_DESCRIPTION_SET = 2,
+	SPITFIRE_MILESTONE_LOCAL_DESCRIPTION_CREATED = 3,
+	SPITFIRE_MILESTONE_FIRST_LOCAL_CANDIDATE = 4,
+	SPITFIRE_MILESTONE_ICE_CHECKING = 5,
+	SPITFIRE_MILESTONE_ICE_CONNECTED = 6,
+	SPITFIRE_MILESTONE_DTLS_CONNECTED = 7,
+	SPITFIRE_MILESTONE_SCTP_CONNECTED = 8,
+	SPITFIRE_MILESTONE_CHANNEL_OPEN = 9,
+	SPITFIRE_MILESTONE_COUNT = 10
+};
+
+// Values match RtcLogVerbosity.
+enum
+{
+	SPITFIRE_LOG_VERBOSE = 0,
+	SPITFIRE_LOG_INFO = 1,
+	SPITFIRE_LOG_WARNING = 2,
+	SPITFIRE_LOG_ERROR = 3,
+	SPITFIRE_LOG_NONE = 4
+};
+
+static const int32_t SPITFIRE_INVALID_CHANNEL = -1;
+static const int32_t SPITFIRE_INVALID_BUFFER = -1;
+
+// The fields of one candidate line, see RtcCandidateFields. Strings are terminated, longer values are cut off.
+typedef struct spitfire_candidate_fields
+{
+	char foundation[36];
+	uint32_t component;
+	int32_t is_tcp;
+	uint32_t priority;
+	char address[48];
+	int32_t port;
+	// SPITFIRE_CANDIDATE_*
+	int32_t type;
+	char related_address[48];
+	int32_t related_port;
+	uint32_t generation;
+	char ufrag[64];
+	uint16_t network_id;
+	uint16_t network_cost;
+} spitfire_candidate_fields;
+
+// Each callback may be null. They run on the WebRTC threads, or in spitfire_peer_process_messages with SPITFIRE_PUMP_CALLER,
+// pointers handed to them are only valid for the duration of the call unless stated otherwise.
+// Same layout as RtcIceCandidate.
+typedef struct spitfire_ice_candidate
+{
+	const char* sdp_mid;
+	int32_t sdp_mline_index;
+	const char* sdp;
+	// set in on_ice_candidates when on_ice_candidate_fields is set too, ignored by spitfire_peer_add_ice_candidates
+	const spitfire_candidate_fields* fields;
+} spitfire_ice_candidate;
+
+typedef struct spitfire_callbacks
+{
+	void* user_data;
+	void (SPITFIRE_CALL *on_sdp)(void* user_data, const char* type, const char* sdp);
+	void (SPITFIRE_CALL *on_failure)(void* user_data, const char* error);
+	void (SPITFIRE_CALL *on_ice_candidate)(void* user_data, const char* sdp_mid, int32_t sdp_mline_index, const char* sdp);
+	void (SPITFIRE_CALL *on_ice_state)(void* user_data, int32_t state);
+	void (SPITFIRE_CALL *on_ice_gathering_state)(void* user_data, int32_t state);
+	void (SPITFIRE_CALL *on_channel_state)(void* user_data, int32_t channel, const char* label, int32_t state);
+	void (SPITFIRE_CALL *on_message)(void* user_data, int32_t channel, const uint8_t* data, uint32_t length, int32_t is_binary);
+	// the data stays valid until the lease is passed to spitfire_peer_release_lease
+	void (SPITFIRE_CALL *on_leased_message)(void* user_data, int32_t channel, uint64_t lease, const uint8_t* data, uint32_t length, int32_t is_binary);
+	void (SPITFIRE_CALL *on_buffered_amount)(void* user_data, int32_t channel, uint64_t previous_amount, uint64_t current_amount, uint64_t bytes_sent, uint64_t bytes_received);
+	void (SPITFIRE_CALL *on_writable)(void* user_data, int32_t channel);
+	// replaces on_ice_candidate once spitfire_peer_enable_candidate_batching was called, |complete| marks the end of candidates,
+	// the candidates carry their fields when on_ice_candidate_fields is set as well
+	void (SPITFIRE_CALL *on_ice_candidates)(void* user_data, const spitfire_ice_candidate* candidates, uint32_t count, int32_t complete);
+	// replaces on_ice_candidate when set, the candidate comes with its fields already parsed
+	void (SPITFIRE_CALL *on_ice_candidate_fields)(void* user_data, const char* sdp_mid, int32_t sdp_mline_index, const char* sdp, const spitfire_candidate_fields* fields);
+} spitfire_callbacks;
+
+typedef struct spitfire_channel_options
+{
+	int32_t id;
+	int32_t ordered;
+	int32_t reliable;
+	int32_t negotiated;
+	// negative leaves the limit unset
+	int32_t max_retransmits;
+	int32_t max_retransmit_time;
+	// SPITFIRE_CHANNEL_* flags
+	uint32_t features;
+	// may be null
+	const char* protocol;
+} spitfire_channel_options;
+
+typedef struct spitfire_channel_info
+{
+	uint64_t current_buffer;
+	uint64_t bytes_sent;
+	uint64_t bytes_received;
+	uint32_t messages_sent;
+	uint32_t messages_received;
+	int32_t id;
+	int32_t state;
+	int32_t reliable;
+	int32_t ordered;
+	int32_t negotiated;
+	int16_t max_retransmits;
+	int16_t max_retransmit_time;
+} spitfire_channel_info;
+
+// A message taken from the inbound queue, |data| stays valid until the next spitfire_peer_drain_messages.
+typedef struct spitfire_message
+{
+	int32_t channel;
+	int32_t is_binary;
+	const uint8_t* data;
+	uint32_t length;
+} spitfire_message;
+
+// Latencies in nanoseconds over one metrics interval, percentiles are at most 1/16 above the real value.
+typedef struct spitfire_latency_summary
+{
+	uint64_t count;
+	int64_t mean_ns;
+	int64_t p50_ns;
+	int64_t p90_ns;
+	int64_t p99_ns;
+	int64_t p999_ns;
+	int64_t max_ns;
+} spitfire_latency_summary;
+
+typedef struct spitfire_channel_metrics
+{
+	int32_t channel;
+	spitfire_latency_summary handoff;
+	spitfire_latency_summary buffered;
+	spitfire_latency_summary receive;
+	int64_t interval_ms;
+	double messages_sent_per_second;
+	double bytes_sent_per_second;
+	double messages_received_per_second;
+	double bytes_received_per_second;
+} spitfire_channel_metrics;
+
+typedef struct spitfire_candidate_info
+{
+	// SPITFIRE_CANDIDATE_*
+	int32_t type;
+	int32_t is_tcp;
+	int32_t port;
+	char address[48];
+} spitfire_candidate_info;
+
+// One peer's stats, see RtcPeerStats for what each field holds.
+typedef struct spitfire_peer_stats
+{
+	uint64_t peer;
+	int64_t timestamp_us;
+	int32_t has_selected_pair;
+	spitfire_candidate_info local_candidate;
+	spitfire_candidate_info remote_candidate;
+	double current_round_trip_time_ms;
+	double total_round_trip_time_ms;
+	double available_outgoing_bitrate;
+	uint64_t pair_bytes_sent;
+	uint64_t pair_bytes_received;
+	uint64_t requests_sent;
+	uint64_t responses_received;
+	uint32_t candidate_pairs;
+	// SPITFIRE_DTLS_*
+	int32_t dtls_state;
+	uint64_t transport_bytes_sent;
+	uint64_t transport_bytes_received;
+	uint32_t selected_candidate_pair_changes;
+	uint32_t data_channels_opened;
+	uint32_t data_channels_closed;
+	uint64_t messages_sent;
+	uint64_t messages_received;
+	uint64_t bytes_sent;
+	uint64_t bytes_received;
+	uint64_t buffered_amount;
+} spitfire_peer_stats;
+
+typedef struct spitfire_certificate_pool_stats
+{
+	uint32_t available;
+	uint64_t generated;
+	uint64_t hits;
+	uint64_t misses;
+	int64_t generate_mean_us;
+} spitfire_certificate_pool_stats;
+
+typedef struct spitfire_ice_server
+{
+	const char* uri;
+	const char* username;
+	const char* password;
+} spitfire_ice_server;
+
+typedef struct spitfire_peer_pool_stats
+{
+	uint32_t available;
+	uint64_t built;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t expired;
+	int64_t build_mean_us;
+} spitfire_peer_pool_stats;
+
+// See RtcConnectionTimeline, offsets are -1 for milestones that were not reached.
+typedef struct spitfire_connection_timeline
+{
+	int64_t start_us;
+	int64_t offset_us[SPITFIRE_MILESTONE_COUNT];
+} spitfire_connection_timeline;
+
+// Receives |count| stats, one for spitfire_peer_request_stats and one per peer when polling. Runs on the signaling thread.
+typedef void (SPITFIRE_CALL *spitfire_stats_callback)(void* user_data, const spitfire_peer_stats* stats, uint32_t count);
+
+// Process setup, call spitfire_initialize before creating engines or peers.
+SPITFIRE_API void SPITFIRE_CALL spitfire_initialize(void);
+SPITFIRE_API void SPITFIRE_CALL spitfire_cleanup(void);
+
+// Counters of the log enabled with spitfire_logging_enable, see RtcLogSinkStats.
+typedef struct spitfire_log_stats
+{
+	uint64_t written;
+	uint64_t dropped;
+	uint64_t truncated;
+	uint64_t bytes_written;
+	uint32_t high_watermark;
+} spitfire_log_stats;
+
+// Logs |verbosity| and above to rotating files in |directory|, written on a background thread. Replaces the previous log.
+// |records| preallocated records take the messages, 0 picks the default. Returns 0 when the files could not be opened.
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_logging_enable(int32_t verbosity, const char* directory, uint64_t max_log_size, uint32_t max_files,
+	uint32_t records, int32_t binary);
+SPITFIRE_API void SPITFIRE_CALL spitfire_logging_disable(void);
+// Returns 0 when logging is not enabled.
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_logging_get_stats(spitfire_log_stats* stats);
+
+// Records the trace events of every thread, see RingTracer. Tracing is process-wide and covers every engine.
+SPITFIRE_API void SPITFIRE_CALL spitfire_tracing_start(uint32_t events_per_thread);
+SPITFIRE_API void SPITFIRE_CALL spitfire_tracing_stop(void);
+// Writes the recorded events as Chrome trace JSON, returns 0 when |path| could not be written.
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_tracing_write(const char* path);
+
+// Engines are reference counted, peers keep their own reference so an engine may be released before its peers.
+SPITFIRE_API spitfire_engine* SPITFIRE_CALL spitfire_engine_create(uint32_t network_threads, int32_t shard_policy);
+SPITFIRE_API spitfire_engine* SPITFIRE_CALL spitfire_engine_shared(void);
+// The process-wide engine keeps running without peers until this, call it before spitfire_cleanup.
+SPITFIRE_API void SPITFIRE_CALL spitfire_engine_shutdown_shared(void);
+SPITFIRE_API void SPITFIRE_CALL spitfire_engine_release(spitfire_engine* engine);
+SPITFIRE_API uint32_t SPITFIRE_CALL spitfire_engine_peer_count(const spitfire_engine* engine);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_engine_wait_for_activity(spitfire_engine* engine, int32_t give_up_after_ms);
+// Collects the stats of every peer of |engine| each |interval_ms| and delivers them in one call.
+SPITFIRE_API void SPITFIRE_CALL spitfire_engine_start_stats_polling(spitfire_engine* engine, int32_t interval_ms, spitfire_stats_callback callback, void* user_data);
+SPITFIRE_API void SPITFIRE_CALL spitfire_engine_stop_stats_polling(spitfire_engine* engine);
+// Pre-generated DTLS certificates for peers initialized afterwards, see RtcEngine::EnableCertificatePool.
+SPITFIRE_API void SPITFIRE_CALL spitfire_engine_enable_certificate_pool(spitfire_engine* engine, uint32_t pool_size, int32_t shared);
+SPITFIRE_API void SPITFIRE_CALL spitfire_engine_get_certificate_pool_stats(const spitfire_engine* engine, spitfire_certificate_pool_stats* stats);
+
+// |engine| may be null to use the process-wide engine.
+SPITFIRE_API spitfire_peer* SPITFIRE_CALL spitfire_peer_create(spitfire_engine* engine, uint16_t min_port, uint16_t max_port);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_destroy(spitfire_peer* peer);
+
+// Keeps |peers| initialized peers ready on a thread of its own, see PeerPool. |engine| may be null to use the
+// process-wide engine, |servers| is copied.
+SPITFIRE_API spitfire_peer_pool* SPITFIRE_CALL spitfire_peer_pool_create(spitfire_engine* engine, uint32_t peers, uint16_t min_port, uint16_t max_port,
+	int32_t ice_candidate_pool_size, const spitfire_ice_server* servers, uint32_t server_count);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_pool_destroy(spitfire_peer_pool* pool);
+// Returns an initialized peer using SPITFIRE_PUMP_ENGINE, or null when the pool ran dry. Set its callbacks right away,
+// spitfire_peer_initialize returns 1 without doing anything. Destroy it with spitfire_peer_destroy.
+SPITFIRE_API spitfire_peer* SPITFIRE_CALL spitfire_peer_pool_acquire(spitfire_peer_pool* pool);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_pool_get_stats(const spitfire_peer_pool* pool, spitfire_peer_pool_stats* stats);
+
+// Set before spitfire_peer_initialize, |callbacks| is copied.
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_set_callbacks(spitfire_peer* peer, const spitfire_callbacks* callbacks);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_set_affinity_key(spitfire_peer* peer, uint64_t key);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_set_message_pump(spitfire_peer* peer, int32_t pump);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_set_ice_candidate_pool_size(spitfire_peer* peer, int32_t size);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_add_server_config(spitfire_peer* peer, const char* uri, const char* username, const char* password);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_initialize(spitfire_peer* peer);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_process_messages(spitfire_peer* peer, int32_t delay_ms);
+// Matches spitfire_peer_stats::peer in polled reports.
+SPITFIRE_API uint64_t SPITFIRE_CALL spitfire_peer_id(const spitfire_peer* peer);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_get_connection_timeline(const spitfire_peer* peer, spitfire_connection_timeline* timeline);
+// Returns 0 when the peer is not initialized, the callback is not called then.
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_request_stats(spitfire_peer* peer, spitfire_stats_callback callback, void* user_data);
+
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_create_offer(spitfire_peer* peer);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_set_offer_reply(spitfire_peer* peer, const char* type, const char* sdp);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_set_offer_request(spitfire_peer* peer, const char* sdp);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_add_ice_candidate(spitfire_peer* peer, const char* sdp_mid, int32_t sdp_mline_index, const char* sdp);
+// Applies |count| candidates with a single hop to the signaling thread, returns how many were applied.
+SPITFIRE_API uint32_t SPITFIRE_CALL spitfire_peer_add_ice_candidates(spitfire_peer* peer, const spitfire_ice_candidate* candidates, uint32_t count);
+// Parses a candidate line of |length| bytes from signaling without allocating, returns 0 and zeroes |fields| when it is malformed.
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_parse_candidate(const char* sdp, uint32_t length, spitfire_candidate_fields* fields);
+// Batches local candidates for up to |window_ms|, 0 until gathering completes, or |max_candidates|. Set before spitfire_peer_initialize.
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_enable_candidate_batching(spitfire_peer* peer, int32_t window_ms, uint32_t max_candidates);
+
+// Returns the channel handle, or SPITFIRE_INVALID_CHANNEL.
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_create_data_channel(spitfire_peer* peer, const char* label, const spitfire_channel_options* options);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_find_data_channel(spitfire_peer* peer, const char* label);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_close_data_channel(spitfire_peer* peer, int32_t channel);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_get_data_channel_state(spitfire_peer* peer, int32_t channel);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_get_data_channel_info(spitfire_peer* peer, int32_t channel, spitfire_channel_info* info);
+
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_send_text(spitfire_peer* peer, int32_t channel, const char* text, uint32_t length);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_send_data(spitfire_peer* peer, int32_t channel, const uint8_t* data, uint32_t length);
+// Returns one of SPITFIRE_SEND_*, on_writable follows a SPITFIRE_SEND_WOULD_BLOCK.
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_try_send(spitfire_peer* peer, int32_t channel, const uint8_t* data, uint32_t length, int32_t is_binary);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_set_watermarks(spitfire_peer* peer, int32_t channel, uint64_t high, uint64_t low);
+
+// Zero copy sends, see RtcConductor::EnableSendBufferPool.
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_enable_send_buffer_pool(spitfire_peer* peer, uint32_t buffers, uint32_t buffer_size);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_acquire_send_buffer(spitfire_peer* peer, uint32_t size, uint8_t** data, uint32_t* capacity);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_send_buffer(spitfire_peer* peer, int32_t channel, int32_t buffer, uint32_t length);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_try_send_buffer(spitfire_peer* peer, int32_t channel, int32_t buffer, uint32_t length);
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_return_send_buffer(spitfire_peer* peer, int32_t buffer);
+
+// Batched receive, set before spitfire_peer_initialize. Returns how many messages were written to |messages|.
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_enable_inbound_queue(spitfire_peer* peer, uint32_t capacity, int32_t overflow_policy);
+SPITFIRE_API uint32_t SPITFIRE_CALL spitfire_peer_drain_messages(spitfire_peer* peer, spitfire_message* messages, uint32_t max_count);
+
+// Leased receive, set before spitfire_peer_initialize. |max_bytes| caps the receive buffers kept alive, 0 for no cap.
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_enable_leased_receive(spitfire_peer* peer, uint32_t max_leases, uint64_t max_bytes, int32_t leak_timeout_ms);
+SPITFIRE_API int32_t SPITFIRE_CALL spitfire_peer_release_lease(spitfire_peer* peer, uint64_t lease);
+
+// Per channel latency and rates, set before spitfire_peer_initialize. Draining starts a new interval for every
+// channel and returns how many channels have metrics. When that is more than |max_count| nothing was drained
+// or written to |metrics|, call again with room for the returned count.
+SPITFIRE_API void SPITFIRE_CALL spitfire_peer_enable_channel_metrics(spitfire_peer* peer);
+SPITFIRE_API uint32_t SPITFIRE_CALL spitfire_peer_drain_channel_metrics(spitfire_peer* peer, spitfire_channel_metrics* metrics, uint32_t max_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SPITFIRE_API_H_
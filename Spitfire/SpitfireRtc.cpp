@@ -7,7 +7,10 @@
 #include "rtc_base\time_utils.h"
 #include "rtc_base\helpers.h"
 
+#include "AsyncLogSink.h"
+#include "PeerPool.h"
 #include "RtcConductor.h"
+#include "RingTracer.h"
 
 FILE _iob[] { *stdin, *stdout, *stderr };
 
@@ -253,6 +256,450 @@ namespace Spitfire
 		 ///  The stream id, or SID, for SCTP data channels. -1 if unset (see Negotiated).
 		 /// </summary>
 		int32_t Id = -1;
+
+		 /// <summary>
+		 /// Messages of any size are split into fragments and reassembled on the other end.
+		 /// Adds a token to Protocol, the remote end must be Spitfire as well.
+		 /// </summary>
+		bool Fragmented = false;
+
+		 /// <summary>
+		 /// Small messages sent within a short window are packed into one data channel message.
+		 /// Adds a token to Protocol, the remote end must be Spitfire as well.
+		 /// </summary>
+		bool Coalesced = false;
+
+		 /// <summary>
+		 /// Messages which compress well are deflated before they are sent.
+		 /// Adds a token to Protocol, the remote end must be Spitfire as well.
+		 /// </summary>
+		bool Compressed = false;
+	};
+
+	/// <summary>
+	/// What the inbound queue does with a message that does not fit.
+	/// </summary>
+	public enum class InboundOverflowPolicy
+	{
+		/// <summary>
+		/// The new message is dropped.
+		/// </summary>
+		DropNewest = 0,
+
+		/// <summary>
+		/// The oldest queued message is dropped to make room.
+		/// </summary>
+		DropOldest = 1,
+
+		/// <summary>
+		/// The WebRTC thread waits up to 10ms for you to drain messages, then drops the new one.
+		/// After such a timeout messages are dropped right away until you drain again, the thread is shared by every peer of the engine.
+		/// </summary>
+		Block = 2
+	};
+
+	/// <summary>
+	/// A message taken from the inbound queue.
+	/// Data stays valid until the next call to DrainMessages.
+	/// </summary>
+	public value class InboundMessage
+	{
+	public:
+		int32_t Channel;
+		String^ Label;
+		IntPtr Data;
+		uint32_t Length;
+		bool IsBinary;
+	};
+
+	public value class InboundQueueStats
+	{
+	public:
+		uint32_t Capacity;
+		uint32_t Depth;
+		uint64_t Enqueued;
+		uint64_t Dropped;
+	};
+
+	public value class FragmentationStats
+	{
+	public:
+		uint32_t SendingMessages;
+		uint64_t SendingBytes;
+		uint64_t FragmentsSent;
+		uint32_t ReassemblingMessages;
+		uint64_t ReassemblingBytes;
+		uint64_t MessagesReassembled;
+		uint64_t MessagesDropped;
+	};
+
+	public value class CoalescingStats
+	{
+	public:
+		uint64_t MessagesSent;
+		uint64_t BatchesSent;
+
+		/// <summary>
+		/// Time between a send and its batch reaching the data channel.
+		/// </summary>
+		int64_t AverageLatencyUs;
+		int64_t MaxLatencyUs;
+		uint64_t MessagesReceived;
+		uint64_t BatchesReceived;
+		uint64_t MalformedBatches;
+
+		property double MessagesPerBatch
+		{
+			double get() { return BatchesSent > 0 ? static_cast<double>(MessagesSent) / BatchesSent : 0.0; }
+		}
+	};
+
+	public value class CompressionStats
+	{
+	public:
+		uint64_t MessagesCompressed;
+
+		/// <summary>
+		/// Messages sent as they are, because they were small or compressed poorly.
+		/// </summary>
+		uint64_t MessagesSkipped;
+		uint64_t BytesIn;
+		uint64_t BytesOut;
+
+		/// <summary>
+		/// Compressed size over original size of the recent messages.
+		/// </summary>
+		double Ratio;
+		int64_t CompressUs;
+		uint64_t MessagesDecompressed;
+		uint64_t MessagesDropped;
+		int64_t DecompressUs;
+		uint64_t PoolHits;
+	};
+
+	public value class CertificatePoolStats
+	{
+	public:
+		uint32_t Available;
+		uint64_t Generated;
+
+		/// <summary>
+		/// Peer connections that got a pre-generated certificate.
+		/// </summary>
+		uint64_t Hits;
+
+		/// <summary>
+		/// Peer connections that had to wait for a certificate to be generated.
+		/// </summary>
+		uint64_t Misses;
+		int64_t GenerateMeanUs;
+	};
+
+	/// <summary>
+	/// When a peer reached each milestone of connecting, in microseconds since the offer arrived for an answering
+	/// peer or since CreateOffer for an offering one. -1 for milestones that were not reached.
+	/// </summary>
+	public value class SetupTimeline
+	{
+	public:
+		int64_t DescriptionParsedUs;
+		int64_t RemoteDescriptionSetUs;
+		int64_t LocalDescriptionCreatedUs;
+		int64_t FirstLocalCandidateUs;
+		int64_t IceCheckingUs;
+		int64_t IceConnectedUs;
+		int64_t DtlsConnectedUs;
+		int64_t SctpConnectedUs;
+		int64_t ChannelOpenUs;
+	};
+
+	public value class PeerPoolStats
+	{
+	public:
+		uint32_t Available;
+		uint64_t Built;
+
+		/// <summary>
+		/// Acquires that got an idle peer.
+		/// </summary>
+		uint64_t Hits;
+
+		/// <summary>
+		/// Acquires that found the pool empty.
+		/// </summary>
+		uint64_t Misses;
+
+		/// <summary>
+		/// Idle peers replaced for being older than the pool allows.
+		/// </summary>
+		uint64_t Expired;
+		int64_t BuildMeanUs;
+	};
+
+	/// <summary>
+	/// Counters of the log sink installed by SpitfireRtc.EnableLogging.
+	/// </summary>
+	public value class LogSinkStats
+	{
+	public:
+		uint64_t Written;
+
+		/// <summary>
+		/// Messages lost because the writer fell behind and every record was in use.
+		/// </summary>
+		uint64_t Dropped;
+
+		/// <summary>
+		/// Messages cut to the record size.
+		/// </summary>
+		uint64_t Truncated;
+		uint64_t BytesWritten;
+		uint32_t HighWatermark;
+	};
+
+	/// <summary>
+	/// Distribution of one kind of latency over a metrics interval, in nanoseconds.
+	/// Percentiles are at most 1/16 above the real value.
+	/// </summary>
+	public value class LatencySummary
+	{
+	public:
+		uint64_t Count;
+		int64_t MeanNs;
+		int64_t P50Ns;
+		int64_t P90Ns;
+		int64_t P99Ns;
+		int64_t P999Ns;
+		int64_t MaxNs;
+	};
+
+	public value class DataChannelMetrics
+	{
+	public:
+		int32_t Channel;
+
+		/// <summary>
+		/// Time between a send and WebRTC taking the message, after batching and fragmentation.
+		/// </summary>
+		LatencySummary Handoff;
+
+		/// <summary>
+		/// Estimated time data waits in the SCTP send buffer.
+		/// </summary>
+		LatencySummary Buffered;
+
+		/// <summary>
+		/// Time spent in the receive callback or queueing the message.
+		/// </summary>
+		LatencySummary Receive;
+		int64_t IntervalMs;
+		double MessagesSentPerSecond;
+		double BytesSentPerSecond;
+		double MessagesReceivedPerSecond;
+		double BytesReceivedPerSecond;
+	};
+
+	/// <summary>
+	/// Outcome of TrySend.
+	/// </summary>
+	public enum class SendResult
+	{
+		/// <summary>
+		/// SCTP took the message.
+		/// </summary>
+		Sent = 0,
+
+		/// <summary>
+		/// The message waits in the data channel queue behind earlier ones.
+		/// </summary>
+		Queued = 1,
+
+		/// <summary>
+		/// The message was not sent because the channel is above its high watermark.
+		/// OnChannelWritable is raised once it drained to the low watermark.
+		/// </summary>
+		WouldBlock = 2,
+
+		/// <summary>
+		/// The channel is gone, not open yet or no longer open. A channel that is not open yet raises OnDataChannelStateChange once it opens.
+		/// </summary>
+		Closed = 3
+	};
+
+	/// <summary>
+	/// Priority class of a data channel in the send scheduler, lower values are always served first.
+	/// </summary>
+	public enum class SendPriority
+	{
+		Critical = 0,
+		High = 1,
+		Normal = 2,
+		Bulk = 3
+	};
+
+	public value class SendClassStats
+	{
+	public:
+		uint32_t QueuedMessages;
+		uint64_t QueuedBytes;
+		uint64_t SentMessages;
+		uint64_t DroppedMessages;
+
+		/// <summary>
+		/// Time messages of the class waited in the scheduler before reaching the data channel.
+		/// </summary>
+		int64_t LastDelayUs;
+		int64_t AverageDelayUs;
+		int64_t MaxDelayUs;
+	};
+
+	/// <summary>
+	/// A send buffer borrowed from the peer's pool. Write the payload to Data and send it with
+	/// DataChannelSendBuffer, Data must not be touched afterwards.
+	/// </summary>
+	public value class PooledBuffer
+	{
+	public:
+		int32_t Id;
+		IntPtr Data;
+		uint32_t Capacity;
+
+		property bool IsValid
+		{
+			bool get() { return Id >= 0; }
+		}
+	};
+
+	public value class SendBufferPoolStats
+	{
+	public:
+		uint32_t Buffers;
+		uint32_t Outstanding;
+		uint64_t Acquired;
+		uint64_t Recycled;
+		uint64_t Reallocated;
+		uint64_t Exhausted;
+	};
+
+	public value class LeaseStats
+	{
+	public:
+		uint32_t Limit;
+		uint64_t LimitBytes;
+		uint32_t Outstanding;
+		uint64_t OutstandingBytes;
+		uint64_t Leased;
+		uint64_t Released;
+		uint64_t Fallbacks;
+		uint64_t Leaked;
+	};
+
+	/// <summary>
+	/// How an engine spreads new peers over its network threads.
+	/// </summary>
+	public enum class ShardPolicy
+	{
+		/// <summary>
+		/// Peers go to the network thread with the fewest peers.
+		/// </summary>
+		LeastLoaded = 0,
+
+		/// <summary>
+		/// Peers go to the network thread picked by their AffinityKey.
+		/// </summary>
+		Hash = 1
+	};
+
+	/// <summary>
+	/// A snapshot of how loaded one engine network thread is.
+	/// </summary>
+	public value class ShardMetrics
+	{
+	public:
+		uint32_t Index;
+		uint32_t Peers;
+		/// <summary>
+		/// Messages waiting on the network thread.
+		/// </summary>
+		uint32_t QueueDepth;
+		/// <summary>
+		/// Percentage of the last sampling interval the network thread was busy.
+		/// </summary>
+		double BusyPercent;
+		/// <summary>
+		/// How late, in microseconds, the last sample ran on the network thread.
+		/// </summary>
+		int64_t SchedulingDelayUs;
+	};
+
+	/// <summary>
+	/// Selects who drives a peer's callbacks.
+	/// </summary>
+	public enum class MessagePump
+	{
+		/// <summary>
+		/// The application keeps calling ProcessMessages on a thread it dedicates to the peer.
+		/// </summary>
+		Caller = 0,
+
+		/// <summary>
+		/// Callbacks are driven by the engine threads, no ProcessMessages loop is needed.
+		/// Use SpitfireEngine.WaitForActivity to wait on every peer at once.
+		/// </summary>
+		Engine = 1
+	};
+
+	public enum class CandidateType
+	{
+		Unknown = 0,
+		Host = 1,
+		ServerReflexive = 2,
+		PeerReflexive = 3,
+		Relay = 4
+	};
+
+	public enum class DtlsTransportState
+	{
+		Unknown = 0,
+		New = 1,
+		Connecting = 2,
+		Connected = 3,
+		Closed = 4,
+		Failed = 5
+	};
+
+	public value class CandidateInfo
+	{
+	public:
+		CandidateType Type;
+		bool Tcp;
+		String^ Address;
+		int32_t Port;
+	};
+
+	/// <summary>
+	/// The fields of a candidate line, parsed natively instead of with IceParser, see SpitfireRtc.ParseCandidate.
+	/// </summary>
+	public value class IceCandidateFields
+	{
+	public:
+		String^ Foundation;
+		uint32_t Component;
+		bool Tcp;
+		uint32_t Priority;
+		String^ Address;
+		int32_t Port;
+		CandidateType Type;
+
+		/// <summary>
+		/// Empty and 0 for host candidates.
+		/// </summary>
+		String^ RelatedAddress;
+		int32_t RelatedPort;
+		uint32_t Generation;
+		String^ UFrag;
+		uint16_t NetworkId;
+		uint16_t NetworkCost;
 	};
 
 	public ref class SpitfireIceCandidate
@@ -261,12 +708,346 @@ namespace Spitfire
 		String^ SdpMid;
 		int32_t SdpIndex;
 		String^ Sdp;
+
+		/// <summary>
+		/// Set for local candidates, from OnIceCandidate as well as OnIceCandidates.
+		/// </summary>
+		IceCandidateFields Fields;
+	};
+
+	/// <summary>
+	/// A snapshot of the WebRTC stats of one peer, see SpitfireRtc.RequestStats and SpitfireEngine.StartStatsPolling.
+	/// </summary>
+	public value class PeerStats
+	{
+	public:
+		/// <summary>
+		/// The SpitfireRtc.PeerId of the peer the stats belong to.
+		/// </summary>
+		uint64_t Peer;
+		int64_t TimestampUs;
+
+		/// <summary>
+		/// False until ICE selected a candidate pair, the pair fields are zero until then.
+		/// </summary>
+		bool HasSelectedPair;
+		CandidateInfo LocalCandidate;
+		CandidateInfo RemoteCandidate;
+		double CurrentRoundTripTimeMs;
+		double TotalRoundTripTimeMs;
+
+		/// <summary>
+		/// Bits per second the congestion controller estimates can be sent on the selected pair.
+		/// </summary>
+		double AvailableOutgoingBitrate;
+		uint64_t PairBytesSent;
+		uint64_t PairBytesReceived;
+		uint64_t RequestsSent;
+		uint64_t ResponsesReceived;
+		uint32_t CandidatePairs;
+
+		DtlsTransportState DtlsState;
+		uint64_t TransportBytesSent;
+		uint64_t TransportBytesReceived;
+		uint32_t SelectedCandidatePairChanges;
+
+		uint32_t DataChannelsOpened;
+		uint32_t DataChannelsClosed;
+
+		/// <summary>
+		/// Sums over all data channels.
+		/// </summary>
+		uint64_t MessagesSent;
+		uint64_t MessagesReceived;
+		uint64_t BytesSent;
+		uint64_t BytesReceived;
+
+		/// <summary>
+		/// Bytes waiting in the SCTP send buffers of all data channels.
+		/// </summary>
+		uint64_t BufferedAmount;
+	};
+
+	static CandidateInfo ToManagedCandidate(const Spitfire::RtcCandidateInfo& native_candidate)
+	{
+		CandidateInfo candidate;
+		candidate.Type = static_cast<CandidateType>(native_candidate.type);
+		candidate.Tcp = native_candidate.tcp;
+		candidate.Address = gcnew String(native_candidate.address);
+		candidate.Port = native_candidate.port;
+		return candidate;
+	}
+
+	static IceCandidateFields ToManagedFields(const Spitfire::RtcCandidateFields& native_fields)
+	{
+		IceCandidateFields fields;
+		fields.Foundation = gcnew String(native_fields.foundation);
+		fields.Component = native_fields.component;
+		fields.Tcp = native_fields.tcp;
+		fields.Priority = native_fields.priority;
+		fields.Address = gcnew String(native_fields.address);
+		fields.Port = native_fields.port;
+		fields.Type = static_cast<CandidateType>(native_fields.type);
+		fields.RelatedAddress = gcnew String(native_fields.relatedAddress);
+		fields.RelatedPort = native_fields.relatedPort;
+		fields.Generation = native_fields.generation;
+		fields.UFrag = gcnew String(native_fields.ufrag);
+		fields.NetworkId = native_fields.networkId;
+		fields.NetworkCost = native_fields.networkCost;
+		return fields;
+	}
+
+	static PeerStats ToManagedStats(const Spitfire::RtcPeerStats& native_stats)
+	{
+		PeerStats stats;
+		stats.Peer = native_stats.peer;
+		stats.TimestampUs = native_stats.timestampUs;
+		stats.HasSelectedPair = native_stats.hasSelectedPair;
+		stats.LocalCandidate = ToManagedCandidate(native_stats.localCandidate);
+		stats.RemoteCandidate = ToManagedCandidate(native_stats.remoteCandidate);
+		stats.CurrentRoundTripTimeMs = native_stats.currentRoundTripTimeMs;
+		stats.TotalRoundTripTimeMs = native_stats.totalRoundTripTimeMs;
+		stats.AvailableOutgoingBitrate = native_stats.availableOutgoingBitrate;
+		stats.PairBytesSent = native_stats.pairBytesSent;
+		stats.PairBytesReceived = native_stats.pairBytesReceived;
+		stats.RequestsSent = native_stats.requestsSent;
+		stats.ResponsesReceived = native_stats.responsesReceived;
+		stats.CandidatePairs = native_stats.candidatePairs;
+		stats.DtlsState = static_cast<DtlsTransportState>(native_stats.dtlsState);
+		stats.TransportBytesSent = native_stats.transportBytesSent;
+		stats.TransportBytesReceived = native_stats.transportBytesReceived;
+		stats.SelectedCandidatePairChanges = native_stats.selectedCandidatePairChanges;
+		stats.DataChannelsOpened = native_stats.dataChannelsOpened;
+		stats.DataChannelsClosed = native_stats.dataChannelsClosed;
+		stats.MessagesSent = native_stats.messagesSent;
+		stats.MessagesReceived = native_stats.messagesReceived;
+		stats.BytesSent = native_stats.bytesSent;
+		stats.BytesReceived = native_stats.bytesReceived;
+		stats.BufferedAmount = native_stats.bufferedAmount;
+		return stats;
+	}
+
+	/// <summary>
+	/// Owns the WebRTC threads and peer connection factory that peers share.
+	/// Peers created without an engine use a process-wide one, create your own to control its lifetime.
+	/// </summary>
+	public ref class SpitfireEngine
+	{
+	private:
+		std::shared_ptr<Spitfire::RtcEngine>* engine_;
+
+		delegate void _OnStatsReportCallback(const Spitfire::RtcPeerStats* stats, uint32_t count);
+		_OnStatsReportCallback^ onStatsReport;
+		GCHandle^ on_stats_report_handle_;
+
+		void _OnStatsReport(const Spitfire::RtcPeerStats* stats, uint32_t count)
+		{
+			auto report = gcnew array<PeerStats>(static_cast<int>(count));
+			for (int i = 0; i < report->Length; i++)
+			{
+				report[i] = ToManagedStats(stats[i]);
+			}
+			OnStatsReport(report);
+		}
+
+		SpitfireEngine(std::shared_ptr<Spitfire::RtcEngine> engine)
+		{
+			engine_ = new std::shared_ptr<Spitfire::RtcEngine>(engine);
+		}
+
+		void Start(uint32_t network_threads, ShardPolicy policy)
+		{
+			Spitfire::RtcEngineOptions options;
+			options.networkThreads = network_threads;
+			options.shardPolicy = static_cast<Spitfire::RtcShardPolicy>(policy);
+			engine_ = new std::shared_ptr<Spitfire::RtcEngine>(Spitfire::RtcEngine::Create(options));
+			if (!*engine_)
+			{
+				delete engine_;
+				engine_ = nullptr;
+				throw gcnew InvalidOperationException("Unable to start the WebRTC engine");
+			}
+		}
+
+	internal:
+		std::shared_ptr<Spitfire::RtcEngine> Native()
+		{
+			return engine_ ? *engine_ : std::shared_ptr<Spitfire::RtcEngine>();
+		}
+
+	public:
+		/// <summary>
+		/// Starts the engine threads, call InitializeSSL before calling this.
+		/// </summary>
+		SpitfireEngine()
+		{
+			Start(1, ShardPolicy::LeastLoaded);
+		}
+
+		/// <summary>
+		/// Starts an engine with the given number of network threads, zero uses one per core.
+		/// </summary>
+		SpitfireEngine(uint32_t network_threads, ShardPolicy policy)
+		{
+			Start(network_threads, policy);
+		}
+
+		/// <summary>
+		/// The process-wide engine used by peers created without one.
+		/// </summary>
+		static property SpitfireEngine^ Shared
+		{
+			SpitfireEngine^ get()
+			{
+				auto engine = Spitfire::RtcEngine::Shared();
+				if (!engine)
+				{
+					throw gcnew InvalidOperationException("Unable to start the WebRTC engine");
+				}
+				return gcnew SpitfireEngine(engine);
+			}
+		}
+
+		/// <summary>
+		/// Lets go of the process-wide engine, which keeps running without peers until then.
+		/// It stops once its last peer is disposed, call this before CleanupSSL.
+		/// </summary>
+		static void ShutdownShared()
+		{
+			Spitfire::RtcEngine::ShutdownShared();
+		}
+
+		/// <summary>
+		/// Blocks until any peer of this engine delivered a callback, or the timeout expired.
+		/// Returns false on timeout. A negative timeout waits forever.
+		/// </summary>
+		bool WaitForActivity(int32_t timeout_ms)
+		{
+			return engine_ && engine_->get()->WaitForActivity(timeout_ms);
+		}
+
+		/// <summary>
+		/// Number of peers currently using this engine.
+		/// </summary>
+		property uint32_t PeerCount
+		{
+			uint32_t get() { return engine_ ? engine_->get()->PeerCount() : 0; }
+		}
+
+		/// <summary>
+		/// Returns a snapshot of the load on each network thread.
+		/// </summary>
+		array<ShardMetrics>^ GetShardMetrics()
+		{
+			if (!engine_)
+			{
+				return gcnew array<ShardMetrics>(0);
+			}
+			const auto metrics = engine_->get()->GetShardMetrics();
+			auto managed_metrics = gcnew array<ShardMetrics>(static_cast<int>(metrics.size()));
+			for (int i = 0; i < managed_metrics->Length; i++)
+			{
+				managed_metrics[i].Index = metrics[i].index;
+				managed_metrics[i].Peers = metrics[i].peers;
+				managed_metrics[i].QueueDepth = metrics[i].queueDepth;
+				managed_metrics[i].BusyPercent = metrics[i].busyPermille / 10.0;
+				managed_metrics[i].SchedulingDelayUs = metrics[i].schedulingDelayUs;
+			}
+			return managed_metrics;
+		}
+
+		/// <summary>
+		/// Raised with the stats of every peer of this engine once per polling interval.
+		/// </summary>
+		delegate void StatsReport(array<PeerStats>^ stats);
+		event StatsReport^ OnStatsReport;
+
+		/// <summary>
+		/// Collects the stats of every peer each interval and raises OnStatsReport once with all of them,
+		/// instead of a callback per peer. Polling stops when this engine object is disposed.
+		/// </summary>
+		void StartStatsPolling(int32_t interval_ms)
+		{
+			if (!engine_)
+			{
+				return;
+			}
+			if (onStatsReport == nullptr)
+			{
+				onStatsReport = gcnew _OnStatsReportCallback(this, &SpitfireEngine::_OnStatsReport);
+				on_stats_report_handle_ = GCHandle::Alloc(onStatsReport);
+			}
+			const auto on_report = static_cast<void(__stdcall*)(const Spitfire::RtcPeerStats*, uint32_t)>(Marshal::GetFunctionPointerForDelegate(onStatsReport).ToPointer());
+			engine_->get()->StartStatsPolling(interval_ms, [on_report](const std::vector<Spitfire::RtcPeerStats>& stats)
+			{
+				on_report(stats.data(), static_cast<uint32_t>(stats.size()));
+			});
+		}
+
+		void StopStatsPolling()
+		{
+			if (engine_)
+			{
+				engine_->get()->StopStatsPolling();
+			}
+		}
+
+		/// <summary>
+		/// Keeps DTLS certificates generated ahead of time on a background thread, so peers initialized
+		/// afterwards do not wait for key generation. With shared set every new peer uses one certificate,
+		/// which remote peers can use to tell that the connections share an endpoint.
+		/// </summary>
+		void EnableCertificatePool(uint32_t pool_size, bool shared)
+		{
+			if (engine_)
+			{
+				engine_->get()->EnableCertificatePool(pool_size, shared);
+			}
+		}
+
+		CertificatePoolStats GetCertificatePoolStats()
+		{
+			const auto native_stats = engine_ ? engine_->get()->GetCertificatePoolStats() : Spitfire::RtcCertificatePoolStats{};
+			CertificatePoolStats stats;
+			stats.Available = native_stats.available;
+			stats.Generated = native_stats.generated;
+			stats.Hits = native_stats.hits;
+			stats.Misses = native_stats.misses;
+			stats.GenerateMeanUs = native_stats.generateMeanUs;
+			return stats;
+		}
+
+		~SpitfireEngine()
+		{
+			this->!SpitfireEngine();
+		}
+
+	protected:
+		!SpitfireEngine()
+		{
+			if (on_stats_report_handle_ != nullptr)
+			{
+				StopStatsPolling();
+				on_stats_report_handle_->Free();
+				on_stats_report_handle_ = nullptr;
+			}
+			// peers keep their own reference, the threads stop once the last of them is disposed
+			if (engine_)
+			{
+				delete engine_;
+				engine_ = nullptr;
+			}
+		}
 	};
 
 	public ref class SpitfireRtc
 	{
 	private:
 		std::unique_ptr<Spitfire::RtcConductor>* conductor_;
+		std::vector<Spitfire::RtcInboundMessage>* drained_;
+		// replaced by a grown copy when a channel opens, so the message events read it without locking
+		array<String^>^ labels_;
+		Object^ labels_lock_;
 
 		bool disposed_;
 		uint16_t min_port_;
@@ -280,22 +1061,38 @@ namespace Spitfire
 		_OnFailureCallback^ onFailure;
 		GCHandle^ on_failure_handle_;
 		
-		delegate void _OnMessageCallback(String^ label, uint8_t* msg, uint32_t size, bool is_binary);
+		delegate void _OnMessageCallback(int32_t channel, uint8_t* msg, uint32_t size, bool is_binary);
 		_OnMessageCallback^ onMessage;
 		GCHandle^ on_message_handle_;
 
-		delegate void _OnIceCandidateCallback(String^ sdp_mid, int32_t sdp_mline_index, String^ sdp);
+		delegate void _OnLeasedMessageCallback(int32_t channel, uint64_t lease, uint8_t* msg, uint32_t size, bool is_binary);
+		_OnLeasedMessageCallback^ onLeasedMessage;
+		GCHandle^ on_leased_message_handle_;
+
+		delegate void _OnIceCandidateCallback(String^ sdp_mid, int32_t sdp_mline_index, String^ sdp, const Spitfire::RtcCandidateFields* fields);
 		_OnIceCandidateCallback^ onIceCandidate;
 		GCHandle^ on_ice_candidate_handle_;
 
-		delegate void _OnDataChannelStateCallback(String^ label, webrtc::DataChannelInterface::DataState state);
+		delegate void _OnIceCandidatesCallback(const Spitfire::RtcIceCandidate* candidates, uint32_t count, bool complete);
+		_OnIceCandidatesCallback^ onIceCandidates;
+		GCHandle^ on_ice_candidates_handle_;
+
+		delegate void _OnDataChannelStateCallback(int32_t channel, String^ label, webrtc::DataChannelInterface::DataState state);
 		_OnDataChannelStateCallback^ onDataChannelStateChange;
 		GCHandle^ on_data_channel_state_handle_;
 
-		delegate void _OnBufferChangeCallback(String^ label, uint64_t previousAmount, uint64_t currentAmount, uint64_t bytesSent, uint64_t bytesReceived);
+		delegate void _OnBufferChangeCallback(int32_t channel, uint64_t previousAmount, uint64_t currentAmount, uint64_t bytesSent, uint64_t bytesReceived);
 		_OnBufferChangeCallback^ onBufferAmountChange;
 		GCHandle^ on_buffer_amount_change_handle_;
 
+		delegate void _OnWritableCallback(int32_t channel);
+		_OnWritableCallback^ onWritable;
+		GCHandle^ on_writable_handle_;
+
+		delegate void _OnStatsCallback(const Spitfire::RtcPeerStats* stats);
+		_OnStatsCallback^ onStats;
+		GCHandle^ on_stats_handle_;
+
 		delegate void _OnIceStateCallback(webrtc::PeerConnectionInterface::IceConnectionState state);
 		_OnIceStateCallback^ onIceStateChange;
 		GCHandle^ on_ice_state_callback_handle_;
@@ -329,15 +1126,34 @@ namespace Spitfire
 			}
 		}
 
-		void _OnIceCandidate(String^ sdp_mid, int32_t sdp_mline_index, String^ sdp)
+		void _OnIceCandidate(String^ sdp_mid, int32_t sdp_mline_index, String^ sdp, const Spitfire::RtcCandidateFields* fields)
 		{
 			auto ice = gcnew SpitfireIceCandidate();
 			ice->Sdp = gcnew String(sdp);
 			ice->SdpMid = gcnew String(sdp_mid);
 			ice->SdpIndex = sdp_mline_index;
+			ice->Fields = ToManagedFields(*fields);
 			OnIceCandidate(ice);
 		}
 
+		void _OnIceCandidates(const Spitfire::RtcIceCandidate* candidates, uint32_t count, bool complete)
+		{
+			auto batch = gcnew array<SpitfireIceCandidate^>(static_cast<int>(count));
+			for (int i = 0; i < batch->Length; i++)
+			{
+				auto ice = gcnew SpitfireIceCandidate();
+				ice->Sdp = gcnew String(candidates[i].sdp);
+				ice->SdpMid = gcnew String(candidates[i].sdpMid);
+				ice->SdpIndex = candidates[i].sdpMlineIndex;
+				if (candidates[i].fields)
+				{
+					ice->Fields = ToManagedFields(*candidates[i].fields);
+				}
+				batch[i] = ice;
+			}
+			OnIceCandidates(batch, complete);
+		}
+
 		void _OnFailure(String^ error)
 		{
 			OnFailure(error);
@@ -357,30 +1173,112 @@ namespace Spitfire
 			OnIceGatheringStateChange(managedState);
 		}
 
-		void _OnBufferAmountChange(String^ label, const uint64_t previous_amount, const uint64_t current_amount, const uint64_t bytes_sent, const uint64_t bytes_received)
+		void _OnBufferAmountChange(const int32_t channel, const uint64_t previous_amount, const uint64_t current_amount, const uint64_t bytes_sent, const uint64_t bytes_received)
+		{
+			OnChannelBufferAmountChange(channel, previous_amount, current_amount, bytes_sent, bytes_received);
+			OnBufferAmountChange(GetChannelLabel(channel), previous_amount, current_amount, bytes_sent, bytes_received);
+		}
+
+		void _OnWritable(const int32_t channel)
 		{
-			OnBufferAmountChange(label, previous_amount, current_amount, bytes_sent, bytes_received);
+			OnChannelWritable(channel);
 		}
 
-		void _OnDataChannelState(String^ label, webrtc::DataChannelInterface::DataState state)
+		void _OnStats(const Spitfire::RtcPeerStats* stats)
 		{
+			OnStats(ToManagedStats(*stats));
+		}
+
+		void _OnDataChannelState(const int32_t channel, String^ label, webrtc::DataChannelInterface::DataState state)
+		{
+			RememberChannelLabel(channel, label);
 			DataChannelState managedState = static_cast<DataChannelState>(state);
+			OnChannelStateChange(channel, label, managedState);
 			OnDataChannelStateChange(label, managedState);
 		}
 
-		void _OnMessage(String^ label, uint8_t* data, const uint32_t size, const bool is_binary)
+		void _OnMessage(const int32_t channel, uint8_t* data, const uint32_t size, const bool is_binary)
 		{
 			//auto buffer = gcnew array<Byte>(size);
 			//IntPtr src(data);
 			//Marshal::Copy(src, buffer, 0, size);
 			IntPtr managedPointer(data);
-			OnMessage(label, managedPointer, size, is_binary);
+			OnChannelMessage(channel, managedPointer, size, is_binary);
+			OnMessage(GetChannelLabel(channel), managedPointer, size, is_binary);
 		}
 
-		void Initialize(uint16_t min_port, uint16_t max_port)
+		void _OnLeasedMessage(const int32_t channel, const uint64_t lease, uint8_t* data, const uint32_t size, const bool is_binary)
+		{
+			OnLeasedMessage(channel, lease, IntPtr(data), size, is_binary);
+		}
+
+		// labels indexed by channel handle, remembered when the channel is created or opens so the label
+		// based events neither allocate nor lock per message
+		void RememberChannelLabel(const int32_t channel, String^ label)
+		{
+			if (channel < 0)
+				return;
+			msclr::lock l(labels_lock_);
+			if (channel < labels_->Length && labels_[channel] != nullptr)
+				return;
+			auto labels = labels_;
+			if (labels->Length <= channel)
+			{
+				// handles are handed out in order, doubling keeps the copies rare
+				labels = gcnew array<String^>(System::Math::Max(channel + 1, labels->Length * 2));
+				labels_->CopyTo(labels, 0);
+			}
+			labels[channel] = label;
+			labels_ = labels;
+		}
+
+		String^ GetChannelLabel(const int32_t channel)
+		{
+			// a snapshot, a channel opening meanwhile swaps in a new array
+			auto labels = labels_;
+			return channel >= 0 && channel < labels->Length ? labels[channel] : nullptr;
+		}
+
+		static Spitfire::DataChannelInfo^ ToManagedInfo(const Spitfire::RtcDataChannelInfo& rtc_info)
+		{
+			if(rtc_info.protocol != "unknown")
+			{
+				const auto managed_info = gcnew Spitfire::DataChannelInfo();
+				managed_info->CurrentBuffer = rtc_info.currentBuffer;
+				managed_info->BytesSent = rtc_info.bytesSent;
+				managed_info->BytesReceived = rtc_info.bytesReceived;
+
+				managed_info->Reliable = rtc_info.reliable;
+				managed_info->Ordered = rtc_info.ordered;
+				managed_info->Negotiated = rtc_info.negotiated;
+
+				managed_info->MessagesSent = rtc_info.messagesSent;
+				managed_info->MessagesReceived = rtc_info.messagesReceived;
+				managed_info->MaxRetransmits = rtc_info.maxRetransmits;
+				managed_info->MaxRetransmitTime = rtc_info.maxRetransmitTime;
+
+				if(!rtc_info.protocol.empty())
+				{
+					managed_info->Protocol = gcnew String(rtc_info.protocol.c_str());
+				}
+				managed_info->State = static_cast<DataChannelState>(rtc_info.state);
+				return managed_info;
+			}
+			return nullptr;
+		}
+
+		static Spitfire::RtcConductor* CreateConductor(SpitfireEngine^ engine)
+		{
+			return new Spitfire::RtcConductor(engine != nullptr ? engine->Native() : std::shared_ptr<Spitfire::RtcEngine>());
+		}
+
+		void Initialize(Spitfire::RtcConductor* conductor, uint16_t min_port, uint16_t max_port)
 		{
 			disposed_ = false;
-			conductor_ = new std::unique_ptr<Spitfire::RtcConductor>(new Spitfire::RtcConductor());
+			conductor_ = new std::unique_ptr<Spitfire::RtcConductor>(conductor);
+			drained_ = new std::vector<Spitfire::RtcInboundMessage>();
+			labels_ = gcnew array<String^>(0);
+			labels_lock_ = gcnew Object();
 			min_port_ = min_port;
 			max_port_ = max_port;
 
@@ -396,10 +1294,18 @@ namespace Spitfire
 			on_message_handle_ = GCHandle::Alloc(onMessage);
 			conductor_->get()->onMessage = static_cast<Spitfire::OnMessageCallbackNative>(Marshal::GetFunctionPointerForDelegate(onMessage).ToPointer());
 
+			onLeasedMessage = gcnew _OnLeasedMessageCallback(this, &SpitfireRtc::_OnLeasedMessage);
+			on_leased_message_handle_ = GCHandle::Alloc(onLeasedMessage);
+			conductor_->get()->onLeasedMessage = static_cast<Spitfire::OnLeasedMessageCallbackNative>(Marshal::GetFunctionPointerForDelegate(onLeasedMessage).ToPointer());
+
 			
 			onIceCandidate = gcnew _OnIceCandidateCallback(this, &SpitfireRtc::_OnIceCandidate);
 			on_ice_candidate_handle_ = GCHandle::Alloc(onIceCandidate);
-			conductor_->get()->onIceCandidate = static_cast<Spitfire::OnIceCandidateCallbackNative>(Marshal::GetFunctionPointerForDelegate(onIceCandidate).ToPointer());
+			conductor_->get()->onIceCandidateFields = static_cast<Spitfire::OnIceCandidateFieldsCallbackNative>(Marshal::GetFunctionPointerForDelegate(onIceCandidate).ToPointer());
+
+			onIceCandidates = gcnew _OnIceCandidatesCallback(this, &SpitfireRtc::_OnIceCandidates);
+			on_ice_candidates_handle_ = GCHandle::Alloc(onIceCandidates);
+			conductor_->get()->onIceCandidates = static_cast<Spitfire::OnIceCandidatesCallbackNative>(Marshal::GetFunctionPointerForDelegate(onIceCandidates).ToPointer());
 
 			onDataChannelStateChange = gcnew _OnDataChannelStateCallback(this, &SpitfireRtc::_OnDataChannelState);
 			on_data_channel_state_handle_ = GCHandle::Alloc(onDataChannelStateChange);
@@ -416,6 +1322,14 @@ namespace Spitfire
 			onBufferAmountChange = gcnew _OnBufferChangeCallback(this, &SpitfireRtc::_OnBufferAmountChange);
 			on_buffer_amount_change_handle_ = GCHandle::Alloc(onBufferAmountChange);
 			conductor_->get()->onBufferAmountChange = static_cast<Spitfire::OnBufferAmountCallbackNative>(Marshal::GetFunctionPointerForDelegate(onBufferAmountChange).ToPointer());
+
+			onWritable = gcnew _OnWritableCallback(this, &SpitfireRtc::_OnWritable);
+			on_writable_handle_ = GCHandle::Alloc(onWritable);
+			conductor_->get()->onWritable = static_cast<Spitfire::OnWritableCallbackNative>(Marshal::GetFunctionPointerForDelegate(onWritable).ToPointer());
+
+			onStats = gcnew _OnStatsCallback(this, &SpitfireRtc::_OnStats);
+			on_stats_handle_ = GCHandle::Alloc(onStats);
+			conductor_->get()->onStats = static_cast<Spitfire::OnStatsCallbackNative>(Marshal::GetFunctionPointerForDelegate(onStats).ToPointer());
 		}
 	
 		
@@ -441,11 +1355,25 @@ namespace Spitfire
 		delegate void OnCallbackIceCandidate(SpitfireIceCandidate^ iceCandidate);
 		event OnCallbackIceCandidate^ OnIceCandidate;
 
+		/// <summary>
+		/// Raised instead of OnIceCandidate once EnableCandidateBatching was called, with the candidates gathered
+		/// within one window. The batch after gathering completed has complete set, it may be empty and marks the end of candidates.
+		/// </summary>
+		delegate void OnCallbackIceCandidates(array<SpitfireIceCandidate^>^ candidates, bool complete);
+		event OnCallbackIceCandidates^ OnIceCandidates;
+
 		/// <summary>
 		/// indicates the state of the data channel's underlying data connection.
 		/// </summary>
 		delegate void DataChannelStateChange(String^ label, Spitfire::DataChannelState state);
 		event DataChannelStateChange^ OnDataChannelStateChange;
+
+		/// <summary>
+		/// Same as OnDataChannelStateChange, but also reports the channel handle.
+		/// Remote channels get their handle here when they first change state.
+		/// </summary>
+		delegate void ChannelStateChange(int32_t channel, String^ label, Spitfire::DataChannelState state);
+		event ChannelStateChange^ OnChannelStateChange;
 		
 		delegate void OnCallbackError(String^ error);
 		event OnCallbackError^ OnFailure;
@@ -456,6 +1384,19 @@ namespace Spitfire
 		delegate void OnCallbackMessage(String^ label, IntPtr data, uint32_t length, bool isBinary);
 		event OnCallbackMessage^ OnMessage;
 
+		/// <summary>
+		/// Same as OnMessage, but reports the channel handle instead of its label.
+		/// </summary>
+		delegate void OnCallbackChannelMessage(int32_t channel, IntPtr data, uint32_t length, bool isBinary);
+		event OnCallbackChannelMessage^ OnChannelMessage;
+
+		/// <summary>
+		/// Raised instead of OnChannelMessage once leased receive is enabled.
+		/// The data stays valid until the lease is handed to ReleaseLease, so it can be processed on any thread.
+		/// </summary>
+		delegate void OnCallbackLeasedMessage(int32_t channel, uint64_t lease, IntPtr data, uint32_t length, bool isBinary);
+		event OnCallbackLeasedMessage^ OnLeasedMessage;
+
 		
 		
 		/// <summary>
@@ -482,14 +1423,47 @@ namespace Spitfire
 		delegate void BufferChange(String^ label, uint64_t previous_buffer_amount, uint64_t current_buffer_amount, uint64_t bytes_sent, uint64_t bytes_received);
 		event BufferChange^ OnBufferAmountChange;
 
+		/// <summary>
+		/// Same as OnBufferAmountChange, but reports the channel handle instead of its label.
+		/// </summary>
+		delegate void ChannelBufferChange(int32_t channel, uint64_t previous_buffer_amount, uint64_t current_buffer_amount, uint64_t bytes_sent, uint64_t bytes_received);
+		event ChannelBufferChange^ OnChannelBufferAmountChange;
+
+		/// <summary>
+		/// Raised once after TrySend returned WouldBlock, when the channel drained to its low watermark.
+		/// </summary>
+		delegate void ChannelWritable(int32_t channel);
+		event ChannelWritable^ OnChannelWritable;
+
+		/// <summary>
+		/// Raised with the result of RequestStats.
+		/// </summary>
+		delegate void StatsDelivered(PeerStats stats);
+		event StatsDelivered^ OnStats;
+
 		SpitfireRtc()
 		{
-			Initialize(1025, 65535);
+			Initialize(CreateConductor(nullptr), 1025, 65535);
 		}
 		SpitfireRtc(const uint16_t min_port, const uint16_t max_port)
 		{
-			Initialize(min_port, max_port);
+			Initialize(CreateConductor(nullptr), min_port, max_port);
 		}
+		/// <summary>
+		/// Creates a peer that runs on the threads of the given engine.
+		/// </summary>
+		SpitfireRtc(SpitfireEngine^ engine, const uint16_t min_port, const uint16_t max_port)
+		{
+			Initialize(CreateConductor(engine), min_port, max_port);
+		}
+	internal:
+		// adopts a peer whose peer connection already exists, see SpitfirePeerPool
+		SpitfireRtc(Spitfire::RtcConductor* conductor)
+		{
+			Initialize(conductor, 0, 0);
+		}
+
+	public:
 		~SpitfireRtc()
 		{
 			if(disposed_)
@@ -499,9 +1473,13 @@ namespace Spitfire
 			FreeGCHandle(on_success_handle_);
 			FreeGCHandle(on_failure_handle_);
 			FreeGCHandle(on_message_handle_);
+			FreeGCHandle(on_leased_message_handle_);
 			FreeGCHandle(on_ice_candidate_handle_);
+			FreeGCHandle(on_ice_candidates_handle_);
 			FreeGCHandle(on_data_channel_state_handle_);
 			FreeGCHandle(on_buffer_amount_change_handle_);
+			FreeGCHandle(on_writable_handle_);
+			FreeGCHandle(on_stats_handle_);
 			FreeGCHandle(on_ice_state_callback_handle_);
 			FreeGCHandle(on_ice_gathering_state_callback_handle_);
 
@@ -519,18 +1497,65 @@ namespace Spitfire
 		/// <summary>
 		/// Enables logging of WebRTC.
 		/// the max log size indicates how big a single log file can be before splitting.
+		/// The files are written on a background thread, see the overload taking the ring size.
 		/// </summary>
 		static void EnableLogging(RtcLogVerbosity verbosity, String^ log_directory, const uint64_t max_log_size, const uint16_t max_number_of_splits)
+		{
+			EnableLogging(verbosity, log_directory, max_log_size, max_number_of_splits, Spitfire::RtcLogSinkOptions().records, false);
+		}
+
+		/// <summary>
+		/// Enables logging of WebRTC, replacing the previous log.
+		/// Logging threads only copy their message into one of |records| preallocated records, when all of them
+		/// wait for the writer the message is dropped and counted. Binary logs are turned back into text with DecodeLog.
+		/// </summary>
+		static bool EnableLogging(RtcLogVerbosity verbosity, String^ log_directory, const uint64_t max_log_size, const uint16_t max_number_of_splits,
+			uint32_t records, bool binary)
 		{
 			const auto directory = marshal_as<std::string>(log_directory);
-			if (!directory.empty()) {
-				static rtc::FileRotatingLogSink sink(directory, "spitfire", max_log_size, max_number_of_splits);
-				sink.Init();
-				rtc::LogMessage::LogTimestamps();
-				rtc::LogMessage::LogThreads();
-				const auto log_severity = static_cast<rtc::LoggingSeverity>(verbosity);
-				rtc::LogMessage::AddLogToStream(&sink, log_severity);
+			if (directory.empty())
+			{
+				return false;
 			}
+			Spitfire::RtcLogSinkOptions options;
+			options.records = records;
+			options.binary = binary;
+			return Spitfire::AsyncLogSink::Enable(directory, "spitfire", max_log_size, max_number_of_splits,
+				static_cast<rtc::LoggingSeverity>(verbosity), options);
+		}
+
+		/// <summary>
+		/// Stops logging once the queued messages are written.
+		/// </summary>
+		static void DisableLogging()
+		{
+			Spitfire::AsyncLogSink::Disable();
+		}
+
+		static LogSinkStats GetLogStats()
+		{
+			Spitfire::RtcLogSinkStats native_stats{};
+			Spitfire::AsyncLogSink::GetEnabledStats(&native_stats);
+			LogSinkStats stats;
+			stats.Written = native_stats.written;
+			stats.Dropped = native_stats.dropped;
+			stats.Truncated = native_stats.truncated;
+			stats.BytesWritten = native_stats.bytesWritten;
+			stats.HighWatermark = native_stats.highWatermark;
+			return stats;
+		}
+
+		/// <summary>
+		/// Returns the text of a binary log written to |log_directory|, or null when there is none.
+		/// </summary>
+		static String^ DecodeLog(String^ log_directory)
+		{
+			std::string text;
+			if (!Spitfire::AsyncLogSink::Decode(marshal_as<std::string>(log_directory), "spitfire", &text))
+			{
+				return nullptr;
+			}
+			return marshal_as<String^>(text);
 		}
 
 		/// <summary>
@@ -542,13 +1567,72 @@ namespace Spitfire
 			rtc::InitializeSSL();
 			rtc::InitRandom(static_cast<int>(rtc::Time()));
 		}
-		
+		
+		/// <summary>
+		/// Attempts to clean up SSL threads.
+		/// </summary>
+		static void CleanupSSL()
+		{
+			rtc::CleanupSSL();
+		}
+
+		/// <summary>
+		/// Starts recording trace events of WebRTC and Spitfire on every thread,
+		/// keeping the last events per thread. Previously recorded events are dropped.
+		/// </summary>
+		static void StartTracing(uint32_t events_per_thread)
+		{
+			Spitfire::RingTracer::Start(events_per_thread);
+		}
+
+		/// <summary>
+		/// Stops recording trace events, the recorded ones stay available.
+		/// </summary>
+		static void StopTracing()
+		{
+			Spitfire::RingTracer::Stop();
+		}
+
+		/// <summary>
+		/// Returns the recorded trace events as Chrome trace JSON, which about:tracing and Perfetto load.
+		/// </summary>
+		static String^ GetTraceJson()
+		{
+			return marshal_as<String^>(Spitfire::RingTracer::ToJson());
+		}
+
+		/// <summary>
+		/// Writes the recorded trace events as Chrome trace JSON to a file.
+		/// </summary>
+		static bool WriteTrace(String^ path)
+		{
+			return Spitfire::RingTracer::WriteJson(marshal_as<std::string>(path));
+		}
+
+		/// <summary>
+		/// Picks the engine network thread for this peer when the engine uses ShardPolicy.Hash.
+		/// Set it before calling InitializePeerConnection.
+		/// </summary>
+		property uint64_t AffinityKey
+		{
+			void set(uint64_t key) { conductor_->get()->SetAffinityKey(key); }
+		}
+
+		/// <summary>
+		/// Selects who drives this peer's callbacks, set it before calling InitializePeerConnection.
+		/// </summary>
+		property Spitfire::MessagePump MessagePump
+		{
+			void set(Spitfire::MessagePump pump) { conductor_->get()->SetMessagePump(static_cast<Spitfire::RtcMessagePump>(pump)); }
+		}
+
 		/// <summary>
-		/// Attempts to clean up SSL threads.
+		/// Starts gathering candidates for this many allocator sessions as soon as the peer connection exists,
+		/// so answering an offer does not wait for gathering to start. Set it before calling InitializePeerConnection.
 		/// </summary>
-		static void CleanupSSL()
+		property int32_t IceCandidatePoolSize
 		{
-			rtc::CleanupSSL();
+			void set(int32_t size) { conductor_->get()->SetIceCandidatePoolSize(size); }
 		}
 
 		/// <summary>
@@ -566,6 +1650,7 @@ namespace Spitfire
 
 		/// <summary>
 		/// Run this within a loop to process signaling messages for your peer.
+		/// With MessagePump.Engine it only waits, and returns false once the peer has been closed.
 		/// </summary>
 		bool ProcessMessages(Int32 delay)
 		{
@@ -591,6 +1676,62 @@ namespace Spitfire
 			return conductor_->get()->AddIceCandidate(marshal_as<std::string>(sdp_mid), sdp_mlineindex, marshal_as<std::string>(sdp));
 		}
 
+		/// <summary>
+		/// Applies many remote candidates in one call, returns how many of them were applied.
+		/// </summary>
+		uint32_t AddIceCandidates(array<SpitfireIceCandidate^>^ candidates)
+		{
+			if (candidates == nullptr)
+				return 0;
+
+			std::vector<std::string> strings;
+			strings.reserve(candidates->Length * 2);
+			for each (SpitfireIceCandidate^ candidate in candidates)
+			{
+				strings.push_back(marshal_as<std::string>(candidate->SdpMid));
+				strings.push_back(marshal_as<std::string>(candidate->Sdp));
+			}
+			std::vector<Spitfire::RtcIceCandidate> batch;
+			batch.reserve(candidates->Length);
+			for (int i = 0; i < candidates->Length; i++)
+			{
+				batch.push_back(Spitfire::RtcIceCandidate{ strings[i * 2].c_str(), candidates[i]->SdpIndex, strings[i * 2 + 1].c_str(), nullptr });
+			}
+			return conductor_->get()->AddIceCandidates(batch.data(), static_cast<uint32_t>(batch.size()));
+		}
+
+		/// <summary>
+		/// Parses a candidate line from signaling without the regular expressions of IceParser.
+		/// Returns false when the candidate is malformed, fields is zero then.
+		/// </summary>
+		static bool ParseCandidate(String^ candidate, IceCandidateFields% fields)
+		{
+			fields = IceCandidateFields();
+			if (candidate == nullptr)
+				return false;
+
+			const auto line = marshal_as<std::string>(candidate);
+			Spitfire::RtcCandidateFields native_fields;
+			const auto valid = Spitfire::CandidateParser::Parse(line.data(), line.size(), &native_fields);
+			if (valid)
+			{
+				fields = ToManagedFields(native_fields);
+			}
+			return valid;
+		}
+
+		/// <summary>
+		/// Delivers local candidates through OnIceCandidates, gathered for up to window_ms or max_candidates at a time.
+		/// A window of 0 holds them until gathering completes. Call it before InitializePeerConnection.
+		/// </summary>
+		void EnableCandidateBatching(int32_t window_ms, uint32_t max_candidates)
+		{
+			Spitfire::RtcCandidateBatchingOptions options;
+			options.windowMs = window_ms;
+			options.maxCandidates = max_candidates;
+			conductor_->get()->EnableCandidateBatching(options);
+		}
+
 		void AddServerConfig(ServerConfig^ config)
 		{
 			String^ type = config->Type == ServerType::Stun ? "stun" : "turn";
@@ -602,10 +1743,10 @@ namespace Spitfire
 			conductor_->get()->AddServerConfig(hostUri, username, password);
 		}
 		/// <summary>
-		/// Creates a data channel from within the application.
+		/// Creates a data channel from within the application and returns its handle, or -1 on failure.
 		/// Only call if your application is setting up the connection and preparing to offer.
 		/// </summary>
-		void CreateDataChannel(DataChannelOptions^ dataChannelOptions)
+		int32_t CreateDataChannel(DataChannelOptions^ dataChannelOptions)
 		{
 			auto label = dataChannelOptions->Label;
 			auto protocol = dataChannelOptions->Protocol;
@@ -624,15 +1765,37 @@ namespace Spitfire
 			{
 				dc_options.protocol = marshal_as<std::string>(protocol);
 			}
+			if(dataChannelOptions->Fragmented)
+			{
+				dc_options.protocol += dc_options.protocol.empty() ? Spitfire::kFragmentedProtocol : std::string(" ") + Spitfire::kFragmentedProtocol;
+			}
+			if(dataChannelOptions->Coalesced)
+			{
+				dc_options.protocol += dc_options.protocol.empty() ? Spitfire::kCoalescedProtocol : std::string(" ") + Spitfire::kCoalescedProtocol;
+			}
+			if(dataChannelOptions->Compressed)
+			{
+				dc_options.protocol += dc_options.protocol.empty() ? Spitfire::kDeflateProtocol : std::string(" ") + Spitfire::kDeflateProtocol;
+			}
 			dc_options.reliable = dataChannelOptions->Reliable;
-			conductor_->get()->CreateDataChannel(marshal_as<std::string>(label), dc_options);
+			const auto channel = conductor_->get()->CreateDataChannel(marshal_as<std::string>(label), dc_options);
+			RememberChannelLabel(channel, label);
+			return channel;
 		}
 		/// <summary>
 		/// Send your text through the data channel
 		/// </summary>
-		void DataChannelSendText(String^ label, String^ text)
+		bool DataChannelSendText(String^ label, String^ text)
+		{
+			return conductor_->get()->DataChannelSendText(marshal_as<std::string>(label), marshal_as<std::string>(text));
+		}
+
+		/// <summary>
+		/// Send your text through the data channel with the given handle
+		/// </summary>
+		bool DataChannelSendText(int32_t channel, String^ text)
 		{
-			conductor_->get()->DataChannelSendText(marshal_as<std::string>(label), marshal_as<std::string>(text));
+			return conductor_->get()->DataChannelSendText(channel, marshal_as<std::string>(text));
 		}
 
 		/// <summary>
@@ -640,31 +1803,15 @@ namespace Spitfire
 		/// </summary>
 		Spitfire::DataChannelInfo^ GetDataChannelInfo(String^ label)
 		{
-			auto rtc_info = conductor_->get()->GetDataChannelInfo(marshal_as<std::string>(label));
-			if(rtc_info.protocol != "unknown")
-			{
-				const auto managed_info = gcnew Spitfire::DataChannelInfo();
-				managed_info->CurrentBuffer = rtc_info.currentBuffer;
-				managed_info->BytesSent = rtc_info.bytesSent;
-				managed_info->BytesReceived = rtc_info.bytesReceived;
-
-				managed_info->Reliable = rtc_info.reliable;
-				managed_info->Ordered = rtc_info.ordered;
-				managed_info->Negotiated = rtc_info.negotiated;
-
-				managed_info->MessagesSent = rtc_info.messagesSent;
-				managed_info->MessagesReceived = rtc_info.messagesReceived;
-				managed_info->MaxRetransmits = rtc_info.maxRetransmits;
-				managed_info->MaxRetransmitTime = rtc_info.maxRetransmitTime;
+			return ToManagedInfo(conductor_->get()->GetDataChannelInfo(marshal_as<std::string>(label)));
+		}
 
-				if(!rtc_info.protocol.empty())
-				{
-					managed_info->Protocol = gcnew String(rtc_info.protocol.c_str());
-				}
-				managed_info->State = static_cast<DataChannelState>(rtc_info.state);
-				return managed_info;
-			}
-			return nullptr;
+		/// <summary>
+		/// Returns a snapshot of information on the data channel with the given handle.
+		/// </summary>
+		Spitfire::DataChannelInfo^ GetDataChannelInfo(int32_t channel)
+		{
+			return ToManagedInfo(conductor_->get()->GetDataChannelInfo(channel));
 		}
 
 		/// <summary>
@@ -676,6 +1823,11 @@ namespace Spitfire
 			const auto managed_state = static_cast<DataChannelState>(state);
 			return managed_state;
 		}
+
+		Spitfire::DataChannelState GetDataChannelState(int32_t channel)
+		{
+			return static_cast<DataChannelState>(conductor_->get()->GetDataChannelState(channel));
+		}
 		
 		/// <summary>
 		/// Closes a data channel and disposes it's observers
@@ -684,14 +1836,398 @@ namespace Spitfire
 		{
 			conductor_->get()->CloseDataChannel(marshal_as<std::string>(label));
 		}
+
+		void CloseDataChannel(int32_t channel)
+		{
+			conductor_->get()->CloseDataChannel(channel);
+		}
 		/// <summary>
 		/// Send your binary data through the data channel
 		/// Be aware that channels have a 16KB limit and you should take advantage 
 		/// Of the provided utilties to chunk messages quickly.
 		/// </summary>
-		void DataChannelSendData(String^ label, Byte* array_data, uint32_t length)
+		bool DataChannelSendData(String^ label, Byte* array_data, uint32_t length)
+		{
+			return conductor_->get()->DataChannelSendData(marshal_as<std::string>(label), array_data, length);
+		}
+
+		/// <summary>
+		/// Send your binary data through the data channel with the given handle, 
+		/// this skips the label lookup of the overload above.
+		/// </summary>
+		bool DataChannelSendData(int32_t channel, Byte* array_data, uint32_t length)
+		{
+			return conductor_->get()->DataChannelSendData(channel, array_data, length);
+		}
+
+		/// <summary>
+		/// Delivers received messages through OnLeasedMessage. At most maxLeases can be held at once and they keep
+		/// at most maxBytes of receive buffers alive, 0 for no byte limit. Once either limit is reached further messages
+		/// are raised through OnChannelMessage until some are released.
+		/// Leases held longer than leakTimeoutMs are logged. Call this before InitializePeerConnection.
+		/// </summary>
+		void EnableLeasedReceive(uint32_t max_leases, uint64_t max_bytes, int32_t leak_timeout_ms)
+		{
+			conductor_->get()->EnableLeasedReceive(max_leases, max_bytes, leak_timeout_ms);
+		}
+
+		/// <summary>
+		/// Ends a lease, the message data must not be used afterwards.
+		/// </summary>
+		bool ReleaseLease(uint64_t lease)
+		{
+			return conductor_->get()->ReleaseLease(lease);
+		}
+
+		LeaseStats GetLeaseStats()
+		{
+			const auto native_stats = conductor_->get()->GetLeaseStats();
+			LeaseStats stats;
+			stats.Limit = native_stats.limit;
+			stats.LimitBytes = native_stats.limitBytes;
+			stats.Outstanding = native_stats.outstanding;
+			stats.OutstandingBytes = native_stats.outstandingBytes;
+			stats.Leased = native_stats.leased;
+			stats.Released = native_stats.released;
+			stats.Fallbacks = native_stats.fallbacks;
+			stats.Leaked = native_stats.leaked;
+			return stats;
+		}
+
+		/// <summary>
+		/// Keeps a pool of send buffers the payload can be written into directly,
+		/// sending them does not copy the payload again. Call this before InitializePeerConnection.
+		/// </summary>
+		void EnableSendBufferPool(uint32_t buffers, uint32_t buffer_size)
+		{
+			conductor_->get()->EnableSendBufferPool(buffers, buffer_size);
+		}
+
+		/// <summary>
+		/// Borrows a pool buffer with room for at least size bytes.
+		/// The result is not valid when the pool is disabled or every buffer is in use.
+		/// </summary>
+		PooledBuffer AcquireSendBuffer(uint32_t size)
+		{
+			uint8_t* data = nullptr;
+			uint32_t capacity = 0;
+			PooledBuffer buffer;
+			buffer.Id = conductor_->get()->AcquireSendBuffer(size, &data, &capacity);
+			buffer.Data = IntPtr(data);
+			buffer.Capacity = capacity;
+			return buffer;
+		}
+
+		/// <summary>
+		/// Sends the first length bytes of a pool buffer, the buffer goes back to the pool either way.
+		/// </summary>
+		bool DataChannelSendBuffer(int32_t channel, PooledBuffer buffer, uint32_t length)
+		{
+			return conductor_->get()->DataChannelSendBuffer(channel, buffer.Id, length);
+		}
+
+		/// <summary>
+		/// Gives back a pool buffer that will not be sent.
+		/// </summary>
+		void ReturnSendBuffer(PooledBuffer buffer)
+		{
+			conductor_->get()->ReturnSendBuffer(buffer.Id);
+		}
+
+		SendBufferPoolStats GetSendBufferPoolStats()
+		{
+			const auto native_stats = conductor_->get()->GetSendBufferPoolStats();
+			SendBufferPoolStats stats;
+			stats.Buffers = native_stats.buffers;
+			stats.Outstanding = native_stats.outstanding;
+			stats.Acquired = native_stats.acquired;
+			stats.Recycled = native_stats.recycled;
+			stats.Reallocated = native_stats.reallocated;
+			stats.Exhausted = native_stats.exhausted;
+			return stats;
+		}
+
+		/// <summary>
+		/// Sets the fragment payload size and the memory partially received messages may hold per channel,
+		/// for fragmented channels created afterwards. Defaults to 16KB minus the 12 byte header and 64MB.
+		/// </summary>
+		void SetFragmentationOptions(uint32_t fragment_size, uint64_t reassembly_budget)
+		{
+			Spitfire::RtcFragmentationOptions options;
+			options.fragmentSize = fragment_size;
+			options.reassemblyBudget = reassembly_budget;
+			conductor_->get()->SetFragmentationOptions(options);
+		}
+
+		FragmentationStats GetFragmentationStats(int32_t channel)
+		{
+			const auto native_stats = conductor_->get()->GetFragmentationStats(channel);
+			FragmentationStats stats;
+			stats.SendingMessages = native_stats.sendingMessages;
+			stats.SendingBytes = native_stats.sendingBytes;
+			stats.FragmentsSent = native_stats.fragmentsSent;
+			stats.ReassemblingMessages = native_stats.reassemblingMessages;
+			stats.ReassemblingBytes = native_stats.reassemblingBytes;
+			stats.MessagesReassembled = native_stats.messagesReassembled;
+			stats.MessagesDropped = native_stats.messagesDropped;
+			return stats;
+		}
+
+		/// <summary>
+		/// Sets how long the first message of a batch may wait and the size at which a batch is sent right away,
+		/// for coalesced channels created afterwards. Defaults to 5ms and 1200 bytes.
+		/// </summary>
+		void SetCoalescingOptions(int32_t window_ms, uint32_t max_batch_bytes)
+		{
+			Spitfire::RtcCoalescingOptions options;
+			options.windowMs = window_ms;
+			options.maxBatchBytes = max_batch_bytes;
+			conductor_->get()->SetCoalescingOptions(options);
+		}
+
+		CoalescingStats GetCoalescingStats(int32_t channel)
+		{
+			const auto native_stats = conductor_->get()->GetCoalescingStats(channel);
+			CoalescingStats stats;
+			stats.MessagesSent = native_stats.messagesSent;
+			stats.BatchesSent = native_stats.batchesSent;
+			stats.AverageLatencyUs = native_stats.averageLatencyUs;
+			stats.MaxLatencyUs = native_stats.maxLatencyUs;
+			stats.MessagesReceived = native_stats.messagesReceived;
+			stats.BatchesReceived = native_stats.batchesReceived;
+			stats.MalformedBatches = native_stats.malformedBatches;
+			return stats;
+		}
+
+		/// <summary>
+		/// Sets the size below which messages are not compressed, the zlib level from 1 to 9 and the ratio
+		/// above which compression pauses for a while, for compressed channels created afterwards.
+		/// Defaults to 256 bytes, level 1 and 0.9.
+		/// </summary>
+		void SetCompressionOptions(uint32_t minimum_size, int32_t level, double maximum_ratio)
+		{
+			Spitfire::RtcCompressionOptions options;
+			options.minimumSize = minimum_size;
+			options.level = level;
+			options.maximumRatio = maximum_ratio;
+			conductor_->get()->SetCompressionOptions(options);
+		}
+
+		CompressionStats GetCompressionStats(int32_t channel)
+		{
+			const auto native_stats = conductor_->get()->GetCompressionStats(channel);
+			CompressionStats stats;
+			stats.MessagesCompressed = native_stats.messagesCompressed;
+			stats.MessagesSkipped = native_stats.messagesSkipped;
+			stats.BytesIn = native_stats.bytesIn;
+			stats.BytesOut = native_stats.bytesOut;
+			stats.Ratio = native_stats.ratio;
+			stats.CompressUs = native_stats.compressUs;
+			stats.MessagesDecompressed = native_stats.messagesDecompressed;
+			stats.MessagesDropped = native_stats.messagesDropped;
+			stats.DecompressUs = native_stats.decompressUs;
+			stats.PoolHits = native_stats.poolHits;
+			return stats;
+		}
+
+		/// <summary>
+		/// Identifies this peer in the stats reports of SpitfireEngine.
+		/// </summary>
+		property uint64_t PeerId
+		{
+			uint64_t get() { return conductor_->get()->PeerId(); }
+		}
+
+		SetupTimeline GetConnectionTimeline()
+		{
+			const auto native_timeline = conductor_->get()->GetConnectionTimeline();
+			SetupTimeline timeline;
+			timeline.DescriptionParsedUs = native_timeline.offsetUs[static_cast<size_t>(Spitfire::RtcMilestone::DescriptionParsed)];
+			timeline.RemoteDescriptionSetUs = native_timeline.offsetUs[static_cast<size_t>(Spitfire::RtcMilestone::RemoteDescriptionSet)];
+			timeline.LocalDescriptionCreatedUs = native_timeline.offsetUs[static_cast<size_t>(Spitfire::RtcMilestone::LocalDescriptionCreated)];
+			timeline.FirstLocalCandidateUs = native_timeline.offsetUs[static_cast<size_t>(Spitfire::RtcMilestone::FirstLocalCandidate)];
+			timeline.IceCheckingUs = native_timeline.offsetUs[static_cast<size_t>(Spitfire::RtcMilestone::IceChecking)];
+			timeline.IceConnectedUs = native_timeline.offsetUs[static_cast<size_t>(Spitfire::RtcMilestone::IceConnected)];
+			timeline.DtlsConnectedUs = native_timeline.offsetUs[static_cast<size_t>(Spitfire::RtcMilestone::DtlsConnected)];
+			timeline.SctpConnectedUs = native_timeline.offsetUs[static_cast<size_t>(Spitfire::RtcMilestone::SctpConnected)];
+			timeline.ChannelOpenUs = native_timeline.offsetUs[static_cast<size_t>(Spitfire::RtcMilestone::ChannelOpen)];
+			return timeline;
+		}
+
+		/// <summary>
+		/// Collects candidate pair, transport and data channel stats and raises OnStats with them.
+		/// Returns false when the peer connection has not been initialized.
+		/// </summary>
+		bool RequestStats()
+		{
+			return conductor_->get()->RequestStats();
+		}
+
+		/// <summary>
+		/// Keeps latency histograms and rates for every data channel. Call this before InitializePeerConnection.
+		/// </summary>
+		void EnableChannelMetrics()
+		{
+			conductor_->get()->EnableChannelMetrics();
+		}
+
+		/// <summary>
+		/// Returns what the channel recorded since its metrics were last read and starts a new interval.
+		/// </summary>
+		DataChannelMetrics GetChannelMetrics(int32_t channel)
+		{
+			Spitfire::RtcChannelMetrics native_metrics{};
+			conductor_->get()->GetChannelMetrics(channel, &native_metrics);
+			return ToManaged(native_metrics);
+		}
+
+		/// <summary>
+		/// Reads the metrics of every open data channel at once, meant to be called about once a second.
+		/// </summary>
+		array<DataChannelMetrics>^ DrainChannelMetrics()
+		{
+			std::vector<Spitfire::RtcChannelMetrics> metrics;
+			conductor_->get()->DrainChannelMetrics(metrics);
+			auto managed_metrics = gcnew array<DataChannelMetrics>(static_cast<int>(metrics.size()));
+			for (int i = 0; i < managed_metrics->Length; i++)
+			{
+				managed_metrics[i] = ToManaged(metrics[i]);
+			}
+			return managed_metrics;
+		}
+
+		/// <summary>
+		/// Sets the buffered amount above which TrySend turns messages away and the amount
+		/// at which OnChannelWritable is raised again. Defaults to 8MB and 1MB.
+		/// </summary>
+		bool SetDataChannelWatermarks(int32_t channel, uint64_t high, uint64_t low)
+		{
+			return conductor_->get()->SetDataChannelWatermarks(channel, high, low);
+		}
+
+		/// <summary>
+		/// Sends unless the channel is above its high watermark, so a producer can go full speed
+		/// without overflowing the channel queue, which would close the channel.
+		/// </summary>
+		SendResult TrySend(int32_t channel, Byte* array_data, uint32_t length, bool is_binary)
+		{
+			return static_cast<SendResult>(conductor_->get()->TrySend(channel, array_data, length, is_binary));
+		}
+
+		/// <summary>
+		/// TrySend for a pool buffer, the buffer stays borrowed when the result is WouldBlock.
+		/// </summary>
+		SendResult TrySendBuffer(int32_t channel, PooledBuffer buffer, uint32_t length)
+		{
+			return static_cast<SendResult>(conductor_->get()->TrySendBuffer(channel, buffer.Id, length));
+		}
+
+		/// <summary>
+		/// Routes ScheduleSend through a scheduler that serves priority classes in strict order and channels
+		/// of the same class by weight. Messages are held back while the channels buffer more than budgetBytes.
+		/// Call this before InitializePeerConnection.
+		/// </summary>
+		void EnableSendScheduler(uint64_t budget_bytes)
+		{
+			conductor_->get()->EnableSendScheduler(budget_bytes);
+		}
+
+		/// <summary>
+		/// Moves a channel to another priority class, the weight shares the class with its other channels.
+		/// </summary>
+		bool SetDataChannelPriority(int32_t channel, SendPriority priority, uint32_t weight)
+		{
+			return conductor_->get()->SetDataChannelPriority(channel, static_cast<Spitfire::RtcSendPriority>(priority), weight);
+		}
+
+		/// <summary>
+		/// Queues a message in the send scheduler, the data is copied before this returns.
+		/// </summary>
+		bool ScheduleSend(int32_t channel, Byte* array_data, uint32_t length, bool is_binary)
+		{
+			return conductor_->get()->ScheduleSend(channel, array_data, length, is_binary);
+		}
+
+		SendClassStats GetSendClassStats(SendPriority priority)
+		{
+			const auto native_stats = conductor_->get()->GetSendClassStats(static_cast<Spitfire::RtcSendPriority>(priority));
+			SendClassStats stats;
+			stats.QueuedMessages = native_stats.queuedMessages;
+			stats.QueuedBytes = native_stats.queuedBytes;
+			stats.SentMessages = native_stats.sentMessages;
+			stats.DroppedMessages = native_stats.droppedMessages;
+			stats.LastDelayUs = native_stats.lastDelayUs;
+			stats.AverageDelayUs = native_stats.averageDelayUs;
+			stats.MaxDelayUs = native_stats.maxDelayUs;
+			return stats;
+		}
+
+		/// <summary>
+		/// Queues received messages instead of raising OnMessage for each of them.
+		/// Collect them with DrainMessages. Call this before InitializePeerConnection.
+		/// </summary>
+		void EnableInboundQueue(uint32_t capacity, InboundOverflowPolicy policy)
+		{
+			conductor_->get()->EnableInboundQueue(capacity, static_cast<Spitfire::RtcOverflowPolicy>(policy));
+		}
+
+		/// <summary>
+		/// Fills the batch with queued messages and returns how many were taken.
+		/// The message data stays valid until the next call.
+		/// </summary>
+		int DrainMessages(array<InboundMessage>^ batch)
+		{
+			const auto count = conductor_->get()->DrainMessages(batch->Length, *drained_);
+			for (size_t i = 0; i < count; i++)
+			{
+				const auto& message = (*drained_)[i];
+				batch[i].Channel = message.channel;
+				batch[i].Label = GetChannelLabel(message.channel);
+				batch[i].Data = IntPtr(const_cast<uint8_t*>(message.data.cdata()));
+				batch[i].Length = static_cast<uint32_t>(message.data.size());
+				batch[i].IsBinary = message.binary;
+			}
+			return static_cast<int>(count);
+		}
+
+		InboundQueueStats GetInboundQueueStats()
 		{
-			conductor_->get()->DataChannelSendData(marshal_as<std::string>(label), array_data, length);
+			const auto native_stats = conductor_->get()->GetInboundQueueStats();
+			InboundQueueStats stats;
+			stats.Capacity = native_stats.capacity;
+			stats.Depth = native_stats.depth;
+			stats.Enqueued = native_stats.enqueued;
+			stats.Dropped = native_stats.dropped;
+			return stats;
+		}
+
+	private:
+		static LatencySummary ToManaged(const Spitfire::RtcLatencySummary& native_summary)
+		{
+			LatencySummary summary;
+			summary.Count = native_summary.count;
+			summary.MeanNs = native_summary.meanNs;
+			summary.P50Ns = native_summary.p50Ns;
+			summary.P90Ns = native_summary.p90Ns;
+			summary.P99Ns = native_summary.p99Ns;
+			summary.P999Ns = native_summary.p999Ns;
+			summary.MaxNs = native_summary.maxNs;
+			return summary;
+		}
+
+		static DataChannelMetrics ToManaged(const Spitfire::RtcChannelMetrics& native_metrics)
+		{
+			DataChannelMetrics metrics;
+			metrics.Channel = native_metrics.channel;
+			metrics.Handoff = ToManaged(native_metrics.handoff);
+			metrics.Buffered = ToManaged(native_metrics.buffered);
+			metrics.Receive = ToManaged(native_metrics.receive);
+			metrics.IntervalMs = native_metrics.intervalMs;
+			metrics.MessagesSentPerSecond = native_metrics.messagesSentPerSecond;
+			metrics.BytesSentPerSecond = native_metrics.bytesSentPerSecond;
+			metrics.MessagesReceivedPerSecond = native_metrics.messagesReceivedPerSecond;
+			metrics.BytesReceivedPerSecond = native_metrics.bytesReceivedPerSecond;
+			return metrics;
 		}
 
 	protected:
@@ -702,6 +2238,83 @@ namespace Spitfire
 			{
 				conductor_->release();
 				delete conductor_;
+				conductor_ = nullptr;
+			}
+			if(drained_)
+			{
+				delete drained_;
+				drained_ = nullptr;
+			}
+		}
+	};
+
+	/// <summary>
+	/// Peers whose peer connection is created ahead of time and refilled in the background, so accepting
+	/// an offer does not wait for the peer connection and its first candidates.
+	/// Pooled peers use MessagePump.Engine, subscribe to their events right after Acquire.
+	/// </summary>
+	public ref class SpitfirePeerPool
+	{
+	private:
+		Spitfire::PeerPool* pool_;
+
+	public:
+		SpitfirePeerPool(SpitfireEngine^ engine, uint32_t peers, uint16_t min_port, uint16_t max_port, int32_t ice_candidate_pool_size, array<ServerConfig^>^ servers)
+		{
+			Spitfire::RtcPeerPoolOptions options;
+			options.peers = peers;
+			options.minPort = min_port;
+			options.maxPort = max_port;
+			options.iceCandidatePoolSize = ice_candidate_pool_size;
+			if (servers != nullptr)
+			{
+				for each (ServerConfig^ config in servers)
+				{
+					String^ type = config->Type == ServerType::Stun ? "stun" : "turn";
+					webrtc::PeerConnectionInterface::IceServer server;
+					server.uri = marshal_as<std::string>(type + ":" + config->Host + ":" + config->Port);
+					server.username = String::IsNullOrWhiteSpace(config->Username) ? "" : marshal_as<std::string>(config->Username);
+					server.password = String::IsNullOrWhiteSpace(config->Password) ? "" : marshal_as<std::string>(config->Password);
+					options.servers.push_back(server);
+				}
+			}
+			pool_ = new Spitfire::PeerPool(engine != nullptr ? engine->Native() : std::shared_ptr<Spitfire::RtcEngine>(), options);
+		}
+
+		/// <summary>
+		/// Returns an idle peer whose InitializePeerConnection already succeeded, or null when the pool ran dry.
+		/// </summary>
+		SpitfireRtc^ Acquire()
+		{
+			auto peer = pool_ ? pool_->Acquire() : nullptr;
+			return peer ? gcnew SpitfireRtc(peer.release()) : nullptr;
+		}
+
+		PeerPoolStats GetStats()
+		{
+			const auto native_stats = pool_ ? pool_->GetStats() : Spitfire::RtcPeerPoolStats{};
+			PeerPoolStats stats;
+			stats.Available = native_stats.available;
+			stats.Built = native_stats.built;
+			stats.Hits = native_stats.hits;
+			stats.Misses = native_stats.misses;
+			stats.Expired = native_stats.expired;
+			stats.BuildMeanUs = native_stats.buildMeanUs;
+			return stats;
+		}
+
+		~SpitfirePeerPool()
+		{
+			this->!SpitfirePeerPool();
+		}
+
+	protected:
+		!SpitfirePeerPool()
+		{
+			if (pool_)
+			{
+				delete pool_;
+				pool_ = nullptr;
 			}
 		}
 	};
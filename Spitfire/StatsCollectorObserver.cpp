@@ -0,0 +1,129 @@
+#include "StatsCollectorObserver.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Spitfire
+{
+	template <typename T>
+	static T ValueOr(const webrtc::RTCStatsMember<T>& member, T fallback)
+	{
+		return member.is_defined() ? *member : fallback;
+	}
+
+	static RtcCandidateType ToCandidateType(const webrtc::RTCStatsMember<std::string>& type)
+	{
+		if (!type.is_defined())
+			return RtcCandidateType::Unknown;
+		if (*type == webrtc::RTCIceCandidateType::kHost)
+			return RtcCandidateType::Host;
+		if (*type == webrtc::RTCIceCandidateType::kSrflx)
+			return RtcCandidateType::ServerReflexive;
+		if (*type == webrtc::RTCIceCandidateType::kPrflx)
+			return RtcCandidateType::PeerReflexive;
+		if (*type == webrtc::RTCIceCandidateType::kRelay)
+			return RtcCandidateType::Relay;
+		return RtcCandidateType::Unknown;
+	}
+
+	static RtcDtlsState ToDtlsState(const webrtc::RTCStatsMember<std::string>& state)
+	{
+		if (!state.is_defined())
+			return RtcDtlsState::Unknown;
+		if (*state == webrtc::RTCDtlsTransportState::kNew)
+			return RtcDtlsState::New;
+		if (*state == webrtc::RTCDtlsTransportState::kConnecting)
+			return RtcDtlsState::Connecting;
+		if (*state == webrtc::RTCDtlsTransportState::kConnected)
+			return RtcDtlsState::Connected;
+		if (*state == webrtc::RTCDtlsTransportState::kClosed)
+			return RtcDtlsState::Closed;
+		if (*state == webrtc::RTCDtlsTransportState::kFailed)
+			return RtcDtlsState::Failed;
+		return RtcDtlsState::Unknown;
+	}
+
+	static void FillCandidate(const webrtc::RTCStatsReport& report, const webrtc::RTCStatsMember<std::string>& id, RtcCandidateInfo* candidate)
+	{
+		if (!id.is_defined())
+			return;
+		const auto* stats = report.Get(*id);
+		// local and remote candidates report their own type, so GetAs can not be used on the shared base
+		if (!stats || (stats->type() != webrtc::RTCLocalIceCandidateStats::kType && stats->type() != webrtc::RTCRemoteIceCandidateStats::kType))
+			return;
+		const auto& ice = static_cast<const webrtc::RTCIceCandidateStats&>(*stats);
+		candidate->type = ToCandidateType(ice.candidate_type);
+		candidate->tcp = ice.protocol.is_defined() && *ice.protocol == "tcp";
+		candidate->port = ValueOr(ice.port, 0);
+		if (ice.ip.is_defined())
+		{
+			const auto length = std::min(ice.ip->size(), sizeof(candidate->address) - 1);
+			std::memcpy(candidate->address, ice.ip->data(), length);
+			candidate->address[length] = '\0';
+		}
+	}
+}
+
+void Spitfire::Observers::StatsCollectorObserver::OnStatsDelivered(const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report)
+{
+	if (report)
+	{
+		Flatten(*report, &stats_);
+	}
+	if (done_)
+	{
+		done_(stats_);
+	}
+}
+
+void Spitfire::Observers::StatsCollectorObserver::Flatten(const webrtc::RTCStatsReport& report, RtcPeerStats* stats)
+{
+	stats->timestampUs = report.timestamp_us();
+
+	const webrtc::RTCIceCandidatePairStats* selected = nullptr;
+	for (const auto* transport : report.GetStatsOfType<webrtc::RTCTransportStats>())
+	{
+		// data channels only ever bundle onto one transport, the first one with a selected pair wins
+		stats->dtlsState = ToDtlsState(transport->dtls_state);
+		stats->transportBytesSent = ValueOr<uint64_t>(transport->bytes_sent, 0);
+		stats->transportBytesReceived = ValueOr<uint64_t>(transport->bytes_received, 0);
+		stats->selectedCandidatePairChanges = ValueOr<uint32_t>(transport->selected_candidate_pair_changes, 0);
+		if (transport->selected_candidate_pair_id.is_defined())
+		{
+			selected = report.GetAs<webrtc::RTCIceCandidatePairStats>(*transport->selected_candidate_pair_id);
+			if (selected)
+				break;
+		}
+	}
+
+	const auto pairs = report.GetStatsOfType<webrtc::RTCIceCandidatePairStats>();
+	stats->candidatePairs = static_cast<uint32_t>(pairs.size());
+	if (selected)
+	{
+		stats->hasSelectedPair = true;
+		FillCandidate(report, selected->local_candidate_id, &stats->localCandidate);
+		FillCandidate(report, selected->remote_candidate_id, &stats->remoteCandidate);
+		// the report has seconds, everything else in Spitfire is milliseconds
+		stats->currentRoundTripTimeMs = ValueOr(selected->current_round_trip_time, 0.0) * 1000;
+		stats->totalRoundTripTimeMs = ValueOr(selected->total_round_trip_time, 0.0) * 1000;
+		stats->availableOutgoingBitrate = ValueOr(selected->available_outgoing_bitrate, 0.0);
+		stats->pairBytesSent = ValueOr<uint64_t>(selected->bytes_sent, 0);
+		stats->pairBytesReceived = ValueOr<uint64_t>(selected->bytes_received, 0);
+		stats->requestsSent = ValueOr<uint64_t>(selected->requests_sent, 0);
+		stats->responsesReceived = ValueOr<uint64_t>(selected->responses_received, 0);
+	}
+
+	for (const auto* peer_connection : report.GetStatsOfType<webrtc::RTCPeerConnectionStats>())
+	{
+		stats->dataChannelsOpened = ValueOr<uint32_t>(peer_connection->data_channels_opened, 0);
+		stats->dataChannelsClosed = ValueOr<uint32_t>(peer_connection->data_channels_closed, 0);
+	}
+
+	for (const auto* channel : report.GetStatsOfType<webrtc::RTCDataChannelStats>())
+	{
+		stats->messagesSent += ValueOr<uint32_t>(channel->messages_sent, 0);
+		stats->messagesReceived += ValueOr<uint32_t>(channel->messages_received, 0);
+		stats->bytesSent += ValueOr<uint64_t>(channel->bytes_sent, 0);
+		stats->bytesReceived += ValueOr<uint64_t>(channel->bytes_received, 0);
+	}
+}
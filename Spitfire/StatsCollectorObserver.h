@@ -0,0 +1,98 @@
+#pragma once
+
+#include "api/stats/rtc_stats_collector_callback.h"
+#include "api/stats/rtcstats_objects.h"
+
+#include <cstdint>
+#include <functional>
+
+namespace Spitfire
+{
+	enum class RtcCandidateType
+	{
+		Unknown = 0,
+		Host = 1,
+		ServerReflexive = 2,
+		PeerReflexive = 3,
+		Relay = 4
+	};
+
+	enum class RtcDtlsState
+	{
+		Unknown = 0,
+		New = 1,
+		Connecting = 2,
+		Connected = 3,
+		Closed = 4,
+		Failed = 5
+	};
+
+	struct RtcCandidateInfo
+	{
+		RtcCandidateType type;
+		// true for TCP, false for UDP
+		bool tcp;
+		int32_t port;
+		// long enough for any IPv6 address, always terminated
+		char address[48];
+	};
+
+	// Flat summary of one RTCStatsReport, no pointers or strings so it can be copied as it is
+	// into managed arrays or across the C API.
+	struct RtcPeerStats
+	{
+		uint64_t peer;
+		int64_t timestampUs;
+
+		// the candidate pair the transport selected, all zero until there is one
+		bool hasSelectedPair;
+		RtcCandidateInfo localCandidate;
+		RtcCandidateInfo remoteCandidate;
+		double currentRoundTripTimeMs;
+		double totalRoundTripTimeMs;
+		double availableOutgoingBitrate;
+		uint64_t pairBytesSent;
+		uint64_t pairBytesReceived;
+		uint64_t requestsSent;
+		uint64_t responsesReceived;
+		uint32_t candidatePairs;
+
+		RtcDtlsState dtlsState;
+		uint64_t transportBytesSent;
+		uint64_t transportBytesReceived;
+		uint32_t selectedCandidatePairChanges;
+
+		// summed over every data channel, this WebRTC has no separate SCTP stats so the bytes
+		// waiting in the SCTP send queue come from the channels themselves
+		uint32_t dataChannelsOpened;
+		uint32_t dataChannelsClosed;
+		uint64_t messagesSent;
+		uint64_t messagesReceived;
+		uint64_t bytesSent;
+		uint64_t bytesReceived;
+		uint64_t bufferedAmount;
+	};
+
+	namespace Observers
+	{
+		// Flattens the report of one GetStats call into |stats|, then hands it to |done| on the signaling thread.
+		class StatsCollectorObserver : public webrtc::RTCStatsCollectorCallback
+		{
+		public:
+			StatsCollectorObserver(const RtcPeerStats& stats, std::function<void(const RtcPeerStats&)> done) :
+				stats_(stats),
+				done_(std::move(done))
+			{
+			}
+
+			void OnStatsDelivered(const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report) override;
+
+			// Fills everything but the fields the conductor knows itself, |peer| and |bufferedAmount|.
+			static void Flatten(const webrtc::RTCStatsReport& report, RtcPeerStats* stats);
+
+		private:
+			RtcPeerStats stats_;
+			std::function<void(const RtcPeerStats&)> done_;
+		};
+	}
+}
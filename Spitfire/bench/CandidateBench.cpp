@@ -0,0 +1,283 @@
+// Compares the cost of reading the fields of a candidate line with CandidateParser, with the SDP parser of
+// WebRTC and with the regular expression of SpitfireUtils' IceParser. The .NET regex cannot run here, its
+// pattern is ported to std::regex and the matched groups are turned into strings and numbers the way
+// IceParser.Parse does, which keeps the comparison of allocations honest even if the engines differ in speed.
+// Every parser reads the same mix of host, server reflexive, relay, TCP, IPv6 and mDNS candidates.
+// Prints one JSON object per parser with the time and heap allocations per candidate.
+//
+// usage: spitfire_candidates [--parsers=native,webrtc,regex] [--iterations=200000]
+
+#include "CandidateParser.h"
+#include "api/candidate.h"
+#include "pc/webrtc_sdp.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	std::atomic<uint64_t> allocations{ 0 };
+}
+
+// counts every heap allocation of the process, the runs are single threaded so the count is the parser's
+void* operator new(size_t size)
+{
+	++allocations;
+	if (auto* memory = std::malloc(size > 0 ? size : 1))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+using namespace Spitfire;
+
+namespace
+{
+	struct Options
+	{
+		std::vector<std::string> parsers{ "native", "webrtc", "regex" };
+		uint32_t iterations = 200000;
+	};
+
+	struct Result
+	{
+		uint64_t parsed = 0;
+		uint64_t failed = 0;
+		double nsPerCandidate = 0;
+		double allocationsPerCandidate = 0;
+	};
+
+	const char* const kCandidates[] =
+	{
+		"candidate:1467250027 1 udp 2122260223 192.168.0.196 46243 typ host generation 0 ufrag EsAw network-id 1 network-cost 10",
+		"a=candidate:842163049 1 udp 1686052607 203.0.113.77 46243 typ srflx raddr 192.168.0.196 rport 46243 generation 0 ufrag EsAw network-id 1 network-cost 10",
+		"candidate:1853887674 1 udp 41885439 198.51.100.20 3478 typ relay raddr 203.0.113.77 rport 46243 generation 0 ufrag EsAw network-id 1",
+		"candidate:1467250027 1 tcp 1518280447 192.168.0.196 9 typ host tcptype active generation 0 ufrag EsAw network-id 1 network-cost 10",
+		"candidate:2999745851 1 udp 2122194687 2001:db8::9c1c:4dff:fe2d:1a2b 56142 typ host generation 0 ufrag EsAw network-id 2",
+		"candidate:3719612470 1 udp 2113937151 5c3d8b1e-8f2a-4f6e-9e8d-3b1a7c2d4e5f.local 60153 typ host generation 0 ufrag EsAw network-cost 999",
+	};
+
+	bool Option(const char* argument, const char* name, std::string* value)
+	{
+		const auto length = std::strlen(name);
+		if (std::strncmp(argument, name, length) != 0 || argument[length] != '=')
+		{
+			return false;
+		}
+		*value = argument + length + 1;
+		return true;
+	}
+
+	std::vector<std::string> Split(const std::string& value)
+	{
+		std::vector<std::string> parts;
+		std::stringstream stream(value);
+		std::string part;
+		while (std::getline(stream, part, ','))
+		{
+			if (!part.empty())
+			{
+				parts.push_back(part);
+			}
+		}
+		return parts;
+	}
+
+	const char* Platform()
+	{
+#if defined(WEBRTC_WIN)
+		return "windows";
+#elif defined(WEBRTC_LINUX)
+		return "linux";
+#else
+		return "posix";
+#endif
+	}
+
+	// IceParser.MasterRegex with the same sub-expressions
+	std::string MasterPattern()
+	{
+		const std::string token = "[0-9a-zA-Z\\-\\.!\\%\\*_\\+\\`\\'\\~]+";
+		const std::string ice = "[a-zA-Z0-9\\+\\/]+";
+		const std::string component = "[0-9]{1,5}";
+		const std::string priority = "[0-9]{1,10}";
+		const std::string ipv4 = "[0-9]{1,3}.[0-9]{1,3}.[0-9]{1,3}.[0-9]{1,3}";
+		const std::string ipv6 = ":?(?:[0-9a-fA-F]{0,4}:?)+";
+		const std::string domain = "(?:[a-z0-9](?:[a-z0-9-]{0,61}[a-z0-9])?\\.)+[a-z0-9][a-z0-9-]{0,61}[a-z0-9]";
+		const std::string address = "(?:" + ipv4 + ")|(?:" + ipv6 + ")|(?:" + domain + ")";
+		const std::string port = "[0-9]{1,5}";
+		return "(?:a=)?candidate:(" + ice + ")\\s(" + component + ")\\s(" + token + ")\\s"
+			+ "(" + priority + ")\\s(" + address + ")\\s(" + port + ")"
+			+ "\\styp\\s(" + token + ")(?:\\sraddr\\s(" + address + ")\\srport\\s(" + port + "))?(?:\\sgeneration\\s(\\d+))?(?:\\sufrag\\s(" + ice + "))?(?:\\snetwork-id\\s(" + priority + "))?(?:\\snetwork-cost\\s(" + priority + "))?";
+	}
+
+	// what IceParser.Parse keeps of a match
+	struct RegexCandidate
+	{
+		uint64_t foundation = 0;
+		uint32_t component = 0;
+		std::string transport;
+		uint64_t priority = 0;
+		std::string address;
+		uint32_t port = 0;
+		std::string type;
+		std::string relatedAddress;
+		uint32_t relatedPort = 0;
+		uint32_t generation = 0;
+		std::string ufrag;
+		int32_t networkId = 0;
+		int32_t networkCost = 0;
+	};
+
+	bool ParseRegex(const std::regex& master, const std::string& line, RegexCandidate* candidate)
+	{
+		std::smatch match;
+		if (!std::regex_search(line, match, master) || match.size() != 14)
+		{
+			return false;
+		}
+		for (size_t i = 1; i < match.size(); ++i)
+		{
+			const auto value = match[i].str();
+			if (value.empty())
+			{
+				continue;
+			}
+			switch (i)
+			{
+			case 1: candidate->foundation = std::strtoull(value.c_str(), nullptr, 10); break;
+			case 2: candidate->component = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)); break;
+			case 3: candidate->transport = value; break;
+			case 4: candidate->priority = std::strtoull(value.c_str(), nullptr, 10); break;
+			case 5: candidate->address = value; break;
+			case 6: candidate->port = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)); break;
+			case 7: candidate->type = value; break;
+			case 8: candidate->relatedAddress = value; break;
+			case 9: candidate->relatedPort = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)); break;
+			case 10: candidate->generation = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)); break;
+			case 11: candidate->ufrag = value; break;
+			case 12: candidate->networkId = std::atoi(value.c_str()); break;
+			case 13: candidate->networkCost = std::atoi(value.c_str()); break;
+			}
+		}
+		return true;
+	}
+
+	Result Run(const std::string& parser, const Options& options, const std::vector<std::string>& lines)
+	{
+		Result result;
+		const std::regex master(MasterPattern());
+		const std::string transport_name = "0";
+
+		const auto start_allocations = allocations.load();
+		const auto start_ns = rtc::TimeNanos();
+		for (uint32_t i = 0; i < options.iterations; ++i)
+		{
+			const auto& line = lines[i % lines.size()];
+			auto valid = false;
+			if (parser == "native")
+			{
+				RtcCandidateFields fields;
+				valid = CandidateParser::Parse(line.data(), line.size(), &fields);
+			}
+			else if (parser == "webrtc")
+			{
+				cricket::Candidate candidate;
+				valid = webrtc::SdpDeserializeCandidate(transport_name, line, &candidate, nullptr);
+			}
+			else
+			{
+				RegexCandidate candidate;
+				valid = ParseRegex(master, line, &candidate);
+			}
+			++(valid ? result.parsed : result.failed);
+		}
+		const auto elapsed_ns = rtc::TimeNanos() - start_ns;
+		const auto allocated = allocations.load() - start_allocations;
+
+		result.nsPerCandidate = static_cast<double>(elapsed_ns) / std::max<uint32_t>(options.iterations, 1);
+		result.allocationsPerCandidate = static_cast<double>(allocated) / std::max<uint32_t>(options.iterations, 1);
+		return result;
+	}
+
+	void Report(const std::string& parser, const Options& options, const Result& result)
+	{
+		std::printf("{\"platform\":\"%s\",\"parser\":\"%s\",\"iterations\":%u,\"parsed\":%llu,\"failed\":%llu,\"nsPerCandidate\":%.1f,\"allocationsPerCandidate\":%.2f}\n",
+			Platform(),
+			parser.c_str(),
+			options.iterations,
+			static_cast<unsigned long long>(result.parsed),
+			static_cast<unsigned long long>(result.failed),
+			result.nsPerCandidate,
+			result.allocationsPerCandidate);
+		std::fflush(stdout);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string value;
+		if (Option(argv[i], "--parsers", &value))
+		{
+			options.parsers = Split(value);
+		}
+		else if (Option(argv[i], "--iterations", &value))
+		{
+			options.iterations = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else
+		{
+			std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	for (const auto& parser : options.parsers)
+	{
+		if (parser != "native" && parser != "webrtc" && parser != "regex")
+		{
+			std::fprintf(stderr, "unknown parser %s\n", parser.c_str());
+			return 1;
+		}
+	}
+
+	// WebRTC only takes the a= form
+	std::vector<std::string> lines;
+	for (const auto* candidate : kCandidates)
+	{
+		lines.push_back(std::strncmp(candidate, "a=", 2) == 0 ? candidate : std::string("a=") + candidate);
+	}
+
+	auto failed = false;
+	for (const auto& parser : options.parsers)
+	{
+		const auto result = Run(parser, options, lines);
+		Report(parser, options, result);
+		failed = failed || result.failed > 0;
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+// Deflates one message with ChannelCompressor and inflates it over and over, the way a channel receiving
+// similar messages does, while the application lets go of each message before the next one arrives.
+// Counts the heap allocations of the inflate loop once the buffer pool warmed up, which should be none.
+// Prints one JSON object and fails when the steady state allocated.
+//
+// usage: spitfire_compressor [--size=16384] [--messages=100000] [--level=1]
+
+#include "ChannelCompressor.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+namespace
+{
+	std::atomic<uint64_t> allocations{ 0 };
+}
+
+// counts every heap allocation of the process, the bench is single threaded so the count is the compressor's
+void* operator new(size_t size)
+{
+	++allocations;
+	if (auto* memory = std::malloc(size > 0 ? size : 1))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+using namespace Spitfire;
+
+namespace
+{
+	struct Options
+	{
+		uint32_t size = 16 * 1024;
+		uint32_t messages = 100000;
+		int32_t level = 1;
+	};
+
+	bool Option(const char* argument, const char* name, std::string* value)
+	{
+		const auto length = std::strlen(name);
+		if (std::strncmp(argument, name, length) != 0 || argument[length] != '=')
+		{
+			return false;
+		}
+		*value = argument + length + 1;
+		return true;
+	}
+
+	const char* Platform()
+	{
+#if defined(WEBRTC_WIN)
+		return "windows";
+#elif defined(WEBRTC_LINUX)
+		return "linux";
+#else
+		return "posix";
+#endif
+	}
+
+	// state updates of a game or a remote desktop compress about this well
+	rtc::CopyOnWriteBuffer Message(uint32_t size)
+	{
+		rtc::CopyOnWriteBuffer message(size);
+		auto* data = message.data();
+		for (uint32_t i = 0; i < size; ++i)
+		{
+			data[i] = static_cast<uint8_t>(i % 64 < 48 ? 'a' + i % 7 : (i * 2654435761u) >> 24);
+		}
+		return message;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string value;
+		if (Option(argv[i], "--size", &value))
+		{
+			options.size = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else if (Option(argv[i], "--messages", &value))
+		{
+			options.messages = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else if (Option(argv[i], "--level", &value))
+		{
+			options.level = static_cast<int32_t>(std::strtol(value.c_str(), nullptr, 10));
+		}
+		else
+		{
+			std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	RtcCompressionOptions compression;
+	compression.level = options.level;
+	// every message is compressed, however well it does
+	compression.maximumRatio = 1.0;
+	ChannelCompressor compressor(compression);
+
+	webrtc::DataBuffer encoded(rtc::CopyOnWriteBuffer(), true);
+	compressor.Compress(webrtc::DataBuffer(Message(options.size), true), &encoded);
+	if (compressor.GetStats().messagesCompressed == 0)
+	{
+		std::fprintf(stderr, "the message did not compress\n");
+		return 1;
+	}
+
+	// every pool entry has been handed out once and given back
+	for (int i = 0; i < 32; ++i)
+	{
+		webrtc::DataBuffer message(rtc::CopyOnWriteBuffer(), true);
+		compressor.Decompress(encoded, &message);
+	}
+
+	const auto warm = compressor.GetStats();
+	const auto start_allocations = allocations.load();
+	const auto start_ns = rtc::TimeNanos();
+	uint32_t failed = 0;
+	for (uint32_t i = 0; i < options.messages; ++i)
+	{
+		webrtc::DataBuffer message(rtc::CopyOnWriteBuffer(), true);
+		if (!compressor.Decompress(encoded, &message) || message.size() != options.size)
+		{
+			++failed;
+		}
+	}
+	const auto elapsed_ns = rtc::TimeNanos() - start_ns;
+	const auto allocated = allocations.load() - start_allocations;
+	const auto stats = compressor.GetStats();
+
+	std::printf("{\"platform\":\"%s\",\"size\":%u,\"compressedSize\":%u,\"messages\":%u,\"failed\":%u,\"nsPerMessage\":%.1f,\"allocationsPerMessage\":%.3f,\"poolHits\":%llu}\n",
+		Platform(),
+		options.size,
+		static_cast<uint32_t>(encoded.size()),
+		options.messages,
+		failed,
+		static_cast<double>(elapsed_ns) / options.messages,
+		static_cast<double>(allocated) / options.messages,
+		static_cast<unsigned long long>(stats.poolHits - warm.poolHits));
+	std::fflush(stdout);
+
+	if (allocated > 0 || stats.poolHits - warm.poolHits != options.messages)
+	{
+		std::fprintf(stderr, "steady state decompression allocated %llu times\n", static_cast<unsigned long long>(allocated));
+		return 1;
+	}
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,327 @@
+// Measures how long peers take to connect during a connection storm: several threads keep connecting
+// fresh pairs of peers of one engine and opening a channel between them. Runs once per engine setup
+// and prints one JSON object each with the percentiles of peer creation, of offer to open channel and
+// of accepting, which is what a server spends from an offer arriving to its answer going out: creating
+// the answering peer (or taking it from the pool) plus applying the offer and creating the answer.
+//
+// setups: default     certificates generated by the factory for every peer connection
+//         pool        certificates taken from the engine's pre-generated CertificatePool
+//         shared      one certificate for every peer connection of the engine
+//         warm        the answering peers come from a PeerPool of --peers idle peers which gather their
+//                     candidates ahead of time
+//
+// usage: spitfire_connect [--setups=default,pool,shared,warm] [--connections=200] [--parallel=4] [--pool=64] [--peers=16]
+
+#include "Loopback.h"
+#include "PeerPool.h"
+#include "rtc_base/cpu_time.h"
+#include "rtc_base/ssl_adapter.h"
+#include "rtc_base/time_utils.h"
+
+#if defined(WEBRTC_WIN)
+#include "rtc_base/win32_socket_init.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Spitfire;
+
+namespace
+{
+	// how long a setup may take to fill its pools before the storm starts anyway
+	const int64_t kWarmUpMs = 10000;
+
+	struct Options
+	{
+		uint32_t connections = 200;
+		uint32_t parallel = 4;
+		uint32_t pool = 64;
+		uint32_t peers = 16;
+	};
+
+	struct Result
+	{
+		uint32_t connected = 0;
+		uint32_t failed = 0;
+		double seconds = 0;
+		int64_t cpuNs = 0;
+		std::vector<int64_t> initializeUs;
+		std::vector<int64_t> connectUs;
+		std::vector<int64_t> acceptUs;
+		RtcCertificatePoolStats certificates{};
+		RtcPeerPoolStats peers{};
+	};
+
+	std::vector<std::string> Split(const std::string& list)
+	{
+		std::vector<std::string> items;
+		std::stringstream stream(list);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			if (!item.empty())
+			{
+				items.push_back(item);
+			}
+		}
+		return items;
+	}
+
+	bool Option(const char* argument, const char* name, std::string* value)
+	{
+		const auto length = std::strlen(name);
+		if (std::strncmp(argument, name, length) != 0 || argument[length] != '=')
+		{
+			return false;
+		}
+		*value = argument + length + 1;
+		return true;
+	}
+
+	const char* Platform()
+	{
+#if defined(WEBRTC_WIN)
+		return "windows";
+#elif defined(WEBRTC_LINUX)
+		return "linux";
+#else
+		return "posix";
+#endif
+	}
+
+	int64_t Percentile(const std::vector<int64_t>& sorted, double percentile)
+	{
+		if (sorted.empty())
+		{
+			return 0;
+		}
+		const auto index = static_cast<size_t>(percentile * (sorted.size() - 1));
+		return sorted[index];
+	}
+
+	bool Configure(const std::shared_ptr<RtcEngine>& engine, const std::string& setup, const Options& options, std::unique_ptr<PeerPool>* peers)
+	{
+		if (setup == "pool")
+		{
+			engine->EnableCertificatePool(options.pool, false);
+		}
+		else if (setup == "shared")
+		{
+			engine->EnableCertificatePool(1, true);
+		}
+		else if (setup == "warm")
+		{
+			RtcPeerPoolOptions pool_options;
+			pool_options.peers = options.peers;
+			peers->reset(new PeerPool(engine, pool_options));
+		}
+		else if (setup != "default")
+		{
+			return false;
+		}
+
+		// a pool only helps once it is filled, the storm after a deploy hits a server that was up for a while
+		const auto deadline = rtc::TimeMillis() + kWarmUpMs;
+		while (setup == "pool" && engine->GetCertificatePoolStats().available < options.pool && rtc::TimeMillis() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		while (*peers && (*peers)->GetStats().available < options.peers && rtc::TimeMillis() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return true;
+	}
+
+	Result Run(const std::string& setup, const Options& options)
+	{
+		Result result;
+		auto engine = RtcEngine::Create();
+		std::unique_ptr<PeerPool> peers;
+		if (!engine || !Configure(engine, setup, options, &peers))
+		{
+			result.failed = options.connections;
+			return result;
+		}
+
+		rtc::CriticalSection crit;
+		std::atomic<uint32_t> next{ 0 };
+		std::vector<std::thread> threads;
+		const auto start_us = rtc::TimeMicros();
+		const auto start_cpu_ns = rtc::GetProcessCpuTimeNanos();
+		for (uint32_t i = 0; i < options.parallel; ++i)
+		{
+			threads.emplace_back([&]
+			{
+				while (next++ < options.connections)
+				{
+					// outlive the loopback, whose peers report to them until they are closed
+					std::atomic<int64_t> offer_us{ 0 };
+					std::atomic<int64_t> answer_us{ 0 };
+
+					const auto acquire_start_us = rtc::TimeMicros();
+					Bench::Loopback loopback(engine, peers ? peers->Acquire() : nullptr);
+					const auto acquire_us = rtc::TimeMicros() - acquire_start_us;
+					auto forward_offer = loopback.offerer().onSuccess;
+					loopback.offerer().onSuccess = [&offer_us, forward_offer](const char* type, const char* sdp)
+					{
+						if (std::strcmp(type, "offer") == 0)
+						{
+							offer_us = rtc::TimeMicros();
+						}
+						forward_offer(type, sdp);
+					};
+					auto forward_answer = loopback.answerer().onSuccess;
+					loopback.answerer().onSuccess = [&answer_us, forward_answer](const char* type, const char* sdp)
+					{
+						if (std::strcmp(type, "answer") == 0)
+						{
+							answer_us = rtc::TimeMicros();
+						}
+						forward_answer(type, sdp);
+					};
+
+					auto connect_start_us = rtc::TimeMicros();
+					auto connected = loopback.offerer().InitializePeerConnection(0, 0);
+					// a pooled answerer is initialized already and returns right away
+					const auto answerer_start_us = rtc::TimeMicros();
+					connected = connected && loopback.answerer().InitializePeerConnection(0, 0);
+					const auto answerer_us = rtc::TimeMicros() - answerer_start_us + acquire_us;
+					const auto initialize_us = rtc::TimeMicros() - connect_start_us + acquire_us;
+
+					connect_start_us = rtc::TimeMicros();
+					int32_t local;
+					int32_t remote;
+					connected = connected && loopback.OpenChannel("connect", webrtc::DataChannelInit(), 10000, &local, &remote);
+					const auto connect_us = rtc::TimeMicros() - connect_start_us;
+
+					rtc::CritScope lock(&crit);
+					if (connected)
+					{
+						++result.connected;
+						result.initializeUs.push_back(initialize_us);
+						result.connectUs.push_back(connect_us);
+						result.acceptUs.push_back(answerer_us + answer_us - offer_us);
+					}
+					else
+					{
+						++result.failed;
+					}
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		result.seconds = (rtc::TimeMicros() - start_us) / 1e6;
+		result.cpuNs = rtc::GetProcessCpuTimeNanos() - start_cpu_ns;
+		result.certificates = engine->GetCertificatePoolStats();
+		if (peers)
+		{
+			result.peers = peers->GetStats();
+		}
+
+		std::sort(result.initializeUs.begin(), result.initializeUs.end());
+		std::sort(result.connectUs.begin(), result.connectUs.end());
+		std::sort(result.acceptUs.begin(), result.acceptUs.end());
+		return result;
+	}
+
+	void Report(const std::string& setup, const Options& options, const Result& result)
+	{
+		std::printf("{\"platform\":\"%s\",\"setup\":\"%s\",\"parallel\":%u,\"connected\":%u,\"failed\":%u,\"seconds\":%.3f,"
+			"\"initializeUs\":{\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"max\":%lld},"
+			"\"connectUs\":{\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"max\":%lld},"
+			"\"acceptUs\":{\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"max\":%lld},"
+			"\"cpuUsPerConnection\":%lld,\"certificates\":{\"hits\":%llu,\"misses\":%llu,\"generateMeanUs\":%lld},"
+			"\"peers\":{\"hits\":%llu,\"misses\":%llu,\"buildMeanUs\":%lld}}\n",
+			Platform(),
+			setup.c_str(),
+			options.parallel,
+			result.connected,
+			result.failed,
+			result.seconds,
+			static_cast<long long>(Percentile(result.initializeUs, 0.5)),
+			static_cast<long long>(Percentile(result.initializeUs, 0.9)),
+			static_cast<long long>(Percentile(result.initializeUs, 0.99)),
+			static_cast<long long>(result.initializeUs.empty() ? 0 : result.initializeUs.back()),
+			static_cast<long long>(Percentile(result.connectUs, 0.5)),
+			static_cast<long long>(Percentile(result.connectUs, 0.9)),
+			static_cast<long long>(Percentile(result.connectUs, 0.99)),
+			static_cast<long long>(result.connectUs.empty() ? 0 : result.connectUs.back()),
+			static_cast<long long>(Percentile(result.acceptUs, 0.5)),
+			static_cast<long long>(Percentile(result.acceptUs, 0.9)),
+			static_cast<long long>(Percentile(result.acceptUs, 0.99)),
+			static_cast<long long>(result.acceptUs.empty() ? 0 : result.acceptUs.back()),
+			static_cast<long long>(result.connected > 0 ? result.cpuNs / result.connected / rtc::kNumNanosecsPerMicrosec : 0),
+			static_cast<unsigned long long>(result.certificates.hits),
+			static_cast<unsigned long long>(result.certificates.misses),
+			static_cast<long long>(result.certificates.generateMeanUs),
+			static_cast<unsigned long long>(result.peers.hits),
+			static_cast<unsigned long long>(result.peers.misses),
+			static_cast<long long>(result.peers.buildMeanUs));
+		std::fflush(stdout);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> setups = { "default", "pool", "shared", "warm" };
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string value;
+		if (Option(argv[i], "--setups", &value))
+		{
+			setups = Split(value);
+		}
+		else if (Option(argv[i], "--connections", &value))
+		{
+			options.connections = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else if (Option(argv[i], "--parallel", &value))
+		{
+			options.parallel = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else if (Option(argv[i], "--pool", &value))
+		{
+			options.pool = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else if (Option(argv[i], "--peers", &value))
+		{
+			options.peers = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else
+		{
+			std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+#if defined(WEBRTC_WIN)
+	rtc::WinsockInitializer winsock;
+#endif
+	rtc::InitializeSSL();
+
+	auto failed = false;
+	for (const auto& setup : setups)
+	{
+		const auto result = Run(setup, options);
+		Report(setup, options, result);
+		failed |= result.failed > 0;
+	}
+
+	rtc::CleanupSSL();
+	return failed ? 1 : 0;
+}
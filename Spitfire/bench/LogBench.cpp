@@ -0,0 +1,333 @@
+// Measures how long logging holds up the network thread, with no log sink, the synchronous
+// rtc::FileRotatingLogSink and the AsyncLogSink in text and binary mode, all at LS_VERBOSE.
+// Each round connects a fresh pair of peers, for the burst of ICE logging, and sends messages over one channel.
+// Prints one JSON object per sink.
+//
+// usage: spitfire_logbench [--sinks=off,sync,async,binary] [--rounds=5] [--messages=20000] [--size=1024] [--directory=.]
+
+#include "AsyncLogSink.h"
+#include "LatencyHistogram.h"
+#include "Loopback.h"
+#include "rtc_base/log_sinks.h"
+#include "rtc_base/ssl_adapter.h"
+#include "rtc_base/time_utils.h"
+
+#if defined(WEBRTC_WIN)
+#include "rtc_base/win32_socket_init.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Spitfire;
+
+namespace
+{
+	const size_t kMaxLogSize = 4 * 1024 * 1024;
+	const size_t kLogFiles = 4;
+	// how often the probe checks whether the network thread keeps up with its queue
+	const int64_t kProbeIntervalUs = 1000;
+
+	// Forwards to the sink under test and times every call made on the network thread.
+	class TimedSink : public rtc::LogSink
+	{
+	public:
+		TimedSink(rtc::LogSink* sink, rtc::Thread* network) :
+			sink_(sink),
+			network_(network)
+		{
+		}
+
+		void OnLogMessage(const std::string& message) override
+		{
+			Forward(message, rtc::LS_INFO);
+		}
+
+		void OnLogMessage(const std::string& message, rtc::LoggingSeverity severity) override
+		{
+			Forward(message, severity);
+		}
+
+		void OnLogMessage(const std::string& message, rtc::LoggingSeverity severity, const char*) override
+		{
+			Forward(message, severity);
+		}
+
+		LatencyHistogram stalls;
+		std::atomic<uint64_t> records{ 0 };
+
+	private:
+		void Forward(const std::string& message, rtc::LoggingSeverity severity)
+		{
+			const auto start_ns = rtc::TimeNanos();
+			sink_->OnLogMessage(message, severity);
+			++records;
+			if (network_->IsCurrent())
+			{
+				stalls.Record(rtc::TimeNanos() - start_ns);
+			}
+		}
+
+		rtc::LogSink* const sink_;
+		rtc::Thread* const network_;
+	};
+
+	struct Result
+	{
+		bool completed = true;
+		double seconds = 0;
+		uint64_t records = 0;
+		RtcLatencySummary stalls{};
+		RtcLatencySummary probes{};
+		RtcLogSinkStats sink{};
+	};
+
+	std::vector<std::string> Split(const std::string& list)
+	{
+		std::vector<std::string> items;
+		std::stringstream stream(list);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			if (!item.empty())
+			{
+				items.push_back(item);
+			}
+		}
+		return items;
+	}
+
+	bool Option(const char* argument, const char* name, std::string* value)
+	{
+		const auto length = std::strlen(name);
+		if (std::strncmp(argument, name, length) != 0 || argument[length] != '=')
+		{
+			return false;
+		}
+		*value = argument + length + 1;
+		return true;
+	}
+
+	const char* Platform()
+	{
+#if defined(WEBRTC_WIN)
+		return "windows";
+#elif defined(WEBRTC_LINUX)
+		return "linux";
+#else
+		return "posix";
+#endif
+	}
+
+	// Connects a pair of peers and moves |messages| over one reliable channel.
+	bool Round(const std::shared_ptr<RtcEngine>& engine, uint32_t messages, uint32_t size)
+	{
+		Bench::Loopback loopback(engine);
+		std::atomic<uint32_t> received{ 0 };
+		rtc::Event writable(false, false);
+		rtc::Event done(false, false);
+		loopback.answerer().onMessage = [&](int32_t, const uint8_t*, uint32_t, bool)
+		{
+			if (++received == messages)
+			{
+				done.Set();
+			}
+		};
+		loopback.offerer().onWritable = [&](int32_t) { writable.Set(); };
+
+		int32_t local;
+		int32_t remote;
+		if (!loopback.Initialize() || !loopback.OpenChannel("logbench", webrtc::DataChannelInit(), 10000, &local, &remote))
+		{
+			return false;
+		}
+		const std::vector<uint8_t> payload(size, 0x5A);
+		for (uint32_t sent = 0; sent < messages;)
+		{
+			const auto send_result = loopback.offerer().TrySend(local, payload.data(), size, true);
+			if (send_result == RtcSendResult::WouldBlock)
+			{
+				writable.Wait(1000);
+				continue;
+			}
+			if (send_result == RtcSendResult::Closed)
+			{
+				return false;
+			}
+			++sent;
+		}
+		return messages == 0 || done.Wait(60000);
+	}
+
+	Result Run(const std::string& name, const std::string& directory, uint32_t rounds, uint32_t messages, uint32_t size)
+	{
+		Result result;
+		auto engine = RtcEngine::Create();
+		if (!engine)
+		{
+			result.completed = false;
+			return result;
+		}
+		// a single network thread, every peer of the engine gets this one
+		auto* shard = engine->AcquireProcessingThread(0);
+		auto* network = shard->thread.get();
+		engine->ReleaseProcessingThread(shard);
+
+		const auto prefix = "logbench_" + name;
+		std::unique_ptr<rtc::LogSink> sink;
+		AsyncLogSink* async_sink = nullptr;
+		if (name == "sync")
+		{
+			std::unique_ptr<rtc::FileRotatingLogSink> file_sink(new rtc::FileRotatingLogSink(directory, prefix, kMaxLogSize, kLogFiles));
+			result.completed = file_sink->Init();
+			sink = std::move(file_sink);
+		}
+		else if (name == "async" || name == "binary")
+		{
+			RtcLogSinkOptions options;
+			options.binary = name == "binary";
+			std::unique_ptr<AsyncLogSink> file_sink(new AsyncLogSink(directory, prefix, kMaxLogSize, kLogFiles, options));
+			result.completed = file_sink->Init();
+			async_sink = file_sink.get();
+			sink = std::move(file_sink);
+		}
+		std::unique_ptr<TimedSink> timed;
+		if (sink)
+		{
+			timed.reset(new TimedSink(sink.get(), network));
+			rtc::LogMessage::AddLogToStream(timed.get(), rtc::LS_VERBOSE);
+		}
+
+		// the probe posts a task every millisecond and records how long it waited in the network thread's queue
+		LatencyHistogram probes;
+		std::atomic<bool> probing{ true };
+		std::thread probe([&]
+		{
+			while (probing)
+			{
+				const auto posted_ns = rtc::TimeNanos();
+				network->PostTask(RTC_FROM_HERE, [&probes, posted_ns] { probes.Record(rtc::TimeNanos() - posted_ns); });
+				std::this_thread::sleep_for(std::chrono::microseconds(kProbeIntervalUs));
+			}
+		});
+
+		const auto start_us = rtc::TimeMicros();
+		for (uint32_t round = 0; round < rounds && result.completed; ++round)
+		{
+			result.completed = Round(engine, messages, size);
+		}
+		result.seconds = (rtc::TimeMicros() - start_us) / 1e6;
+
+		probing = false;
+		probe.join();
+		// runs after every probe still queued
+		network->Invoke<void>(RTC_FROM_HERE, [] {});
+
+		if (timed)
+		{
+			rtc::LogMessage::RemoveLogToStream(timed.get());
+			result.records = timed->records;
+			result.stalls = timed->stalls.Drain();
+		}
+		result.probes = probes.Drain();
+		if (async_sink)
+		{
+			// drops only happen while logging, the writer may still be busy with the rest
+			result.sink = async_sink->GetStats();
+		}
+		sink.reset();
+		engine.reset();
+		return result;
+	}
+
+	void Report(const std::string& name, const Result& result)
+	{
+		std::printf("{\"platform\":\"%s\",\"sink\":\"%s\",\"completed\":%s,\"seconds\":%.3f,\"records\":%llu,"
+			"\"networkStallUs\":{\"count\":%llu,\"total\":%lld,\"p50\":%.1f,\"p99\":%.1f,\"max\":%.1f},"
+			"\"probeDelayUs\":{\"p50\":%.1f,\"p99\":%.1f,\"max\":%.1f},\"dropped\":%llu,\"truncated\":%llu,\"highWatermark\":%u}\n",
+			Platform(),
+			name.c_str(),
+			result.completed ? "true" : "false",
+			result.seconds,
+			static_cast<unsigned long long>(result.records),
+			static_cast<unsigned long long>(result.stalls.count),
+			static_cast<long long>(result.stalls.count * result.stalls.meanNs / rtc::kNumNanosecsPerMicrosec),
+			result.stalls.p50Ns / 1e3,
+			result.stalls.p99Ns / 1e3,
+			result.stalls.maxNs / 1e3,
+			result.probes.p50Ns / 1e3,
+			result.probes.p99Ns / 1e3,
+			result.probes.maxNs / 1e3,
+			static_cast<unsigned long long>(result.sink.dropped),
+			static_cast<unsigned long long>(result.sink.truncated),
+			result.sink.highWatermark);
+		std::fflush(stdout);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> sinks = { "off", "sync", "async", "binary" };
+	uint32_t rounds = 5;
+	uint32_t messages = 20000;
+	uint32_t size = 1024;
+	std::string directory = ".";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string value;
+		if (Option(argv[i], "--sinks", &value))
+		{
+			sinks = Split(value);
+		}
+		else if (Option(argv[i], "--rounds", &value))
+		{
+			rounds = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else if (Option(argv[i], "--messages", &value))
+		{
+			messages = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+		}
+		else if (Option(argv[i], "--size", &value))
+		{
+			size = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else if (Option(argv[i], "--directory", &value))
+		{
+			directory = value;
+		}
+		else
+		{
+			std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+#if defined(WEBRTC_WIN)
+	rtc::WinsockInitializer winsock;
+#endif
+	rtc::InitializeSSL();
+	// nothing but the sink under test may write the log
+	rtc::LogMessage::LogToDebug(rtc::LS_NONE);
+	rtc::LogMessage::LogTimestamps();
+	rtc::LogMessage::LogThreads();
+
+	auto failed = false;
+	for (const auto& name : sinks)
+	{
+		const auto result = Run(name, directory, rounds, messages, size);
+		Report(name, result);
+		failed |= !result.completed;
+	}
+
+	rtc::CleanupSSL();
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+#include "Loopback.h"
+#include "rtc_base/time_utils.h"
+
+namespace Spitfire
+{
+	namespace Bench
+	{
+		Loopback::Loopback(std::shared_ptr<RtcEngine> engine) :
+			Loopback(engine, nullptr)
+		{
+		}
+
+		Loopback::Loopback(std::shared_ptr<RtcEngine> engine, std::unique_ptr<RtcConductor> answerer) :
+			offerer_(new RtcConductor(engine)),
+			answerer_(answerer ? std::move(answerer) : std::unique_ptr<RtcConductor>(new RtcConductor(engine)))
+		{
+			offerer_->SetMessagePump(RtcMessagePump::Engine);
+			answerer_->SetMessagePump(RtcMessagePump::Engine);
+			Wire(offerer_.get(), answerer_.get(), &offerer_open_);
+			Wire(answerer_.get(), offerer_.get(), &answerer_open_);
+		}
+
+		Loopback::~Loopback()
+		{
+			offerer_->DeletePeerConnection();
+			answerer_->DeletePeerConnection();
+		}
+
+		void Loopback::Wire(RtcConductor* conductor, RtcConductor* other, std::map<std::string, int32_t>* open)
+		{
+			// descriptions are handed over before the candidates they produce, which arrive in a later task
+			conductor->onSuccess = [other](const char* type, const char* sdp)
+			{
+				if (std::string(type) == "offer")
+				{
+					other->OnOfferRequest(sdp);
+				}
+				else
+				{
+					other->OnOfferReply(type, sdp);
+				}
+			};
+			conductor->onIceCandidate = [other](const char* sdp_mid, int32_t sdp_index, const char* sdp)
+			{
+				other->AddIceCandidate(sdp_mid, sdp_index, sdp);
+			};
+			// only used by peers with candidate batching enabled
+			conductor->onIceCandidates = [other](const RtcIceCandidate* candidates, uint32_t count, bool)
+			{
+				other->AddIceCandidates(candidates, count);
+			};
+			conductor->onDataChannelState = [this, open](int32_t channel, const char* label, webrtc::DataChannelInterface::DataState state)
+			{
+				{
+					rtc::CritScope lock(&crit_);
+					if (state == webrtc::DataChannelInterface::kOpen)
+					{
+						(*open)[label] = channel;
+					}
+					else
+					{
+						open->erase(label);
+					}
+				}
+				changed_.Set();
+			};
+		}
+
+		bool Loopback::Initialize()
+		{
+			return offerer_->InitializePeerConnection(0, 0) && answerer_->InitializePeerConnection(0, 0);
+		}
+
+		bool Loopback::StartChannel(const std::string& label, const webrtc::DataChannelInit& options)
+		{
+			if (offerer_->CreateDataChannel(label, options) == RtcConductor::kInvalidChannel)
+			{
+				return false;
+			}
+			if (!negotiated_)
+			{
+				negotiated_ = true;
+				offerer_->CreateOffer();
+			}
+			return true;
+		}
+
+		bool Loopback::OpenChannel(const std::string& label, const webrtc::DataChannelInit& options, int32_t timeout_ms, int32_t* local, int32_t* remote)
+		{
+			if (!StartChannel(label, options))
+			{
+				return false;
+			}
+
+			const auto deadline = rtc::TimeMillis() + timeout_ms;
+			while (true)
+			{
+				{
+					rtc::CritScope lock(&crit_);
+					const auto offered = offerer_open_.find(label);
+					const auto answered = answerer_open_.find(label);
+					if (offered != offerer_open_.end() && answered != answerer_open_.end())
+					{
+						*local = offered->second;
+						*remote = answered->second;
+						return true;
+					}
+				}
+				const auto remaining = deadline - rtc::TimeMillis();
+				if (remaining <= 0)
+				{
+					return false;
+				}
+				changed_.Wait(static_cast<int>(remaining));
+			}
+		}
+	}
+}
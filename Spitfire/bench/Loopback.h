@@ -0,0 +1,55 @@
+#pragma once
+
+#include "RtcConductor.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/event.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace Spitfire
+{
+	namespace Bench
+	{
+		// Two peers of one engine connected to each other inside the process. The offer, the answer and
+		// the candidates are handed straight to the other peer instead of going through a signaling server.
+		// Both peers use RtcMessagePump::Engine, so their callbacks run on the engine threads.
+		class Loopback
+		{
+		public:
+			explicit Loopback(std::shared_ptr<RtcEngine> engine);
+			// Answers with |answerer| when it is set, for example an idle peer of a PeerPool.
+			Loopback(std::shared_ptr<RtcEngine> engine, std::unique_ptr<RtcConductor> answerer);
+			~Loopback();
+
+			Loopback(const Loopback&) = delete;
+			Loopback& operator=(const Loopback&) = delete;
+
+			// Creates both peer connections, configure the conductors before calling this.
+			bool Initialize();
+
+			// Creates a channel on the offerer without waiting for it to open.
+			// The first channel triggers the offer, later ones are announced in band.
+			bool StartChannel(const std::string& label, const webrtc::DataChannelInit& options);
+			// Starts a channel and waits until it is open on both ends.
+			bool OpenChannel(const std::string& label, const webrtc::DataChannelInit& options, int32_t timeout_ms, int32_t* local, int32_t* remote);
+
+			RtcConductor& offerer() { return *offerer_; }
+			RtcConductor& answerer() { return *answerer_; }
+
+		private:
+			void Wire(RtcConductor* conductor, RtcConductor* other, std::map<std::string, int32_t>* open);
+
+			std::unique_ptr<RtcConductor> offerer_;
+			std::unique_ptr<RtcConductor> answerer_;
+			bool negotiated_ = false;
+
+			// open channels of each side by label
+			std::map<std::string, int32_t> offerer_open_;
+			std::map<std::string, int32_t> answerer_open_;
+			rtc::CriticalSection crit_;
+			rtc::Event changed_{ false, false };
+		};
+	}
+}
@@ -0,0 +1,452 @@
+// Throughput and latency of data channels between two peers in one process.
+// Sweeps message size, channel configuration and channel count, one fresh pair of peers per run,
+// and prints one JSON object per run so results can be compared between releases.
+//
+// usage: spitfire_loopback [--sizes=16,1024,...] [--channels=1,4,...] [--configs=reliable-ordered,...]
+//                          [--send=copy|pooled|both] [--features=frag,batch,deflate] [--seconds=2] [--output=file]
+
+#include "Loopback.h"
+#include "rtc_base/cpu_time.h"
+#include "rtc_base/ssl_adapter.h"
+#include "rtc_base/time_utils.h"
+
+#if defined(WEBRTC_WIN)
+#include "rtc_base/win32_socket_init.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Spitfire;
+
+namespace
+{
+	// larger messages than this need the fragmenter, SCTP refuses them otherwise
+	const uint32_t kMaxUnfragmentedSize = 64 * 1024;
+	// every message starts with the time it was sent, for its one way latency
+	const uint32_t kMinMessageSize = sizeof(int64_t);
+	const int64_t kDrainIdleUs = 2 * rtc::kNumMicrosecsPerSec;
+
+	struct ChannelConfig
+	{
+		const char* name;
+		bool reliable;
+		bool ordered;
+	};
+
+	const ChannelConfig kConfigs[] =
+	{
+		{ "reliable-ordered", true, true },
+		{ "reliable-unordered", true, false },
+		{ "unreliable-ordered", false, true },
+		{ "unreliable-unordered", false, false }
+	};
+
+	struct Scenario
+	{
+		uint32_t size;
+		uint32_t channels;
+		ChannelConfig config;
+		bool pooled;
+		bool fragmented;
+		bool coalesced;
+		bool compressed;
+	};
+
+	struct Result
+	{
+		bool connected = false;
+		bool closed = false;
+		uint64_t sent = 0;
+		uint64_t received = 0;
+		uint64_t bytes = 0;
+		double seconds = 0;
+		int64_t cpuNs = 0;
+		std::vector<int64_t> latenciesUs;
+	};
+
+	std::vector<std::string> Split(const std::string& list)
+	{
+		std::vector<std::string> items;
+		std::stringstream stream(list);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			if (!item.empty())
+			{
+				items.push_back(item);
+			}
+		}
+		return items;
+	}
+
+	bool Option(const char* argument, const char* name, std::string* value)
+	{
+		const auto length = std::strlen(name);
+		if (std::strncmp(argument, name, length) != 0 || argument[length] != '=')
+		{
+			return false;
+		}
+		*value = argument + length + 1;
+		return true;
+	}
+
+	const char* Platform()
+	{
+#if defined(WEBRTC_WIN)
+		return "windows";
+#elif defined(WEBRTC_LINUX)
+		return "linux";
+#else
+		return "posix";
+#endif
+	}
+
+	std::string Protocol(const Scenario& scenario)
+	{
+		std::string protocol;
+		const auto append = [&protocol](const char* token)
+		{
+			protocol += protocol.empty() ? token : std::string(" ") + token;
+		};
+		if (scenario.fragmented)
+		{
+			append(kFragmentedProtocol);
+		}
+		if (scenario.coalesced)
+		{
+			append(kCoalescedProtocol);
+		}
+		if (scenario.compressed)
+		{
+			append(kDeflateProtocol);
+		}
+		return protocol;
+	}
+
+	int64_t Percentile(const std::vector<int64_t>& sorted, double percentile)
+	{
+		if (sorted.empty())
+		{
+			return 0;
+		}
+		const auto index = static_cast<size_t>(percentile * (sorted.size() - 1));
+		return sorted[index];
+	}
+
+	// something that looks like application traffic, so compression has realistic work to do
+	std::vector<uint8_t> Payload(uint32_t size)
+	{
+		static const char kPattern[] = "{\"seq\":1024,\"x\":0.25,\"y\":-13.5,\"state\":\"moving\"},";
+		std::vector<uint8_t> payload(size);
+		for (uint32_t i = 0; i < size; ++i)
+		{
+			payload[i] = static_cast<uint8_t>(kPattern[i % (sizeof(kPattern) - 1)]);
+		}
+		return payload;
+	}
+
+	Result Run(const std::shared_ptr<RtcEngine>& engine, const Scenario& scenario, double seconds)
+	{
+		Result result;
+		Bench::Loopback loopback(engine);
+
+		rtc::CriticalSection crit;
+		std::atomic<uint64_t> received{ 0 };
+		std::atomic<int64_t> last_received_us{ 0 };
+		rtc::Event writable(false, false);
+		rtc::Event done(false, false);
+		std::atomic<uint64_t> expected{ UINT64_MAX };
+		result.latenciesUs.reserve(1 << 20);
+
+		loopback.answerer().onMessage = [&](int32_t, const uint8_t* data, uint32_t size, bool)
+		{
+			const auto now_us = rtc::TimeMicros();
+			if (size >= kMinMessageSize)
+			{
+				int64_t sent_us;
+				std::memcpy(&sent_us, data, sizeof(sent_us));
+				rtc::CritScope lock(&crit);
+				result.latenciesUs.push_back(now_us - sent_us);
+				result.bytes += size;
+			}
+			last_received_us = now_us;
+			if (++received == expected)
+			{
+				done.Set();
+			}
+		};
+		loopback.offerer().onWritable = [&](int32_t) { writable.Set(); };
+		if (scenario.pooled)
+		{
+			loopback.offerer().EnableSendBufferPool(1024, scenario.size);
+		}
+		if (!loopback.Initialize())
+		{
+			return result;
+		}
+
+		webrtc::DataChannelInit options;
+		options.ordered = scenario.config.ordered;
+		if (!scenario.config.reliable)
+		{
+			options.maxRetransmits = 0;
+		}
+		options.protocol = Protocol(scenario);
+
+		std::vector<int32_t> channels;
+		for (uint32_t i = 0; i < scenario.channels; ++i)
+		{
+			int32_t local;
+			int32_t remote;
+			if (!loopback.OpenChannel("bench" + std::to_string(i), options, 10000, &local, &remote))
+			{
+				return result;
+			}
+			channels.push_back(local);
+		}
+		result.connected = true;
+
+		auto payload = Payload(scenario.size);
+		int32_t pooled = SendBufferPool::kInvalidBuffer;
+		const auto cpu_start_ns = rtc::GetProcessCpuTimeNanos();
+		const auto start_us = rtc::TimeMicros();
+		const auto end_us = start_us + static_cast<int64_t>(seconds * rtc::kNumMicrosecsPerSec);
+		size_t next = 0;
+		while (!result.closed && rtc::TimeMicros() < end_us)
+		{
+			const auto channel = channels[next % channels.size()];
+			RtcSendResult send_result;
+			if (scenario.pooled)
+			{
+				if (pooled == SendBufferPool::kInvalidBuffer)
+				{
+					uint8_t* data;
+					uint32_t capacity;
+					pooled = loopback.offerer().AcquireSendBuffer(scenario.size, &data, &capacity);
+					if (pooled == SendBufferPool::kInvalidBuffer)
+					{
+						// every buffer is still held by WebRTC
+						writable.Wait(1);
+						continue;
+					}
+					std::memcpy(data, payload.data(), scenario.size);
+					const auto now_us = rtc::TimeMicros();
+					std::memcpy(data, &now_us, sizeof(now_us));
+				}
+				send_result = loopback.offerer().TrySendBuffer(channel, pooled, scenario.size);
+			}
+			else
+			{
+				const auto now_us = rtc::TimeMicros();
+				std::memcpy(payload.data(), &now_us, sizeof(now_us));
+				send_result = loopback.offerer().TrySend(channel, payload.data(), scenario.size, true);
+			}
+
+			switch (send_result)
+			{
+			case RtcSendResult::WouldBlock:
+				writable.Wait(1);
+				break;
+			case RtcSendResult::Closed:
+				result.closed = true;
+				break;
+			default:
+				pooled = SendBufferPool::kInvalidBuffer;
+				++result.sent;
+				++next;
+				break;
+			}
+		}
+		if (pooled != SendBufferPool::kInvalidBuffer)
+		{
+			loopback.offerer().ReturnSendBuffer(pooled);
+		}
+
+		// wait for what is still in flight, unreliable channels may never deliver all of it
+		expected = result.sent;
+		auto last_progress_us = rtc::TimeMicros();
+		auto last_count = received.load();
+		while (received < result.sent)
+		{
+			done.Wait(100);
+			const auto count = received.load();
+			const auto now_us = rtc::TimeMicros();
+			if (count != last_count)
+			{
+				last_count = count;
+				last_progress_us = now_us;
+			}
+			else if (now_us - last_progress_us > kDrainIdleUs)
+			{
+				break;
+			}
+		}
+		result.cpuNs = rtc::GetProcessCpuTimeNanos() - cpu_start_ns;
+
+		rtc::CritScope lock(&crit);
+		result.received = received;
+		result.seconds = std::max<int64_t>(last_received_us - start_us, 1) / static_cast<double>(rtc::kNumMicrosecsPerSec);
+		std::sort(result.latenciesUs.begin(), result.latenciesUs.end());
+		return result;
+	}
+
+	void Report(FILE* output, const Scenario& scenario, const Result& result)
+	{
+		std::fprintf(output,
+			"{\"platform\":\"%s\",\"size\":%u,\"channels\":%u,\"config\":\"%s\",\"send\":\"%s\",\"protocol\":\"%s\","
+			"\"connected\":%s,\"closed\":%s,\"sent\":%llu,\"received\":%llu,\"lost\":%llu,\"seconds\":%.3f,"
+			"\"messagesPerSecond\":%.0f,\"megabytesPerSecond\":%.3f,"
+			"\"latencyUs\":{\"p50\":%lld,\"p99\":%lld,\"p999\":%lld,\"max\":%lld},\"cpuNsPerMessage\":%.0f}\n",
+			Platform(),
+			scenario.size,
+			scenario.channels,
+			scenario.config.name,
+			scenario.pooled ? "pooled" : "copy",
+			Protocol(scenario).c_str(),
+			result.connected ? "true" : "false",
+			result.closed ? "true" : "false",
+			static_cast<unsigned long long>(result.sent),
+			static_cast<unsigned long long>(result.received),
+			static_cast<unsigned long long>(result.sent - std::min(result.sent, result.received)),
+			result.seconds,
+			result.received / result.seconds,
+			result.bytes / result.seconds / (1024 * 1024),
+			static_cast<long long>(Percentile(result.latenciesUs, 0.5)),
+			static_cast<long long>(Percentile(result.latenciesUs, 0.99)),
+			static_cast<long long>(Percentile(result.latenciesUs, 0.999)),
+			static_cast<long long>(result.latenciesUs.empty() ? 0 : result.latenciesUs.back()),
+			result.received > 0 ? static_cast<double>(result.cpuNs) / result.received : 0.0);
+		std::fflush(output);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<uint32_t> sizes = { 16, 64, 256, 1024, 4096, 16384, 65536, 262144 };
+	std::vector<uint32_t> channel_counts = { 1, 4, 16 };
+	std::vector<ChannelConfig> configs(std::begin(kConfigs), std::end(kConfigs));
+	std::vector<bool> send_modes = { false };
+	bool fragmented = false;
+	bool coalesced = false;
+	bool compressed = false;
+	double seconds = 2;
+	FILE* output = stdout;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string value;
+		if (Option(argv[i], "--sizes", &value))
+		{
+			sizes.clear();
+			for (const auto& size : Split(value))
+			{
+				sizes.push_back(std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(size.c_str(), nullptr, 10)), kMinMessageSize));
+			}
+		}
+		else if (Option(argv[i], "--channels", &value))
+		{
+			channel_counts.clear();
+			for (const auto& count : Split(value))
+			{
+				channel_counts.push_back(std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(count.c_str(), nullptr, 10)), 1));
+			}
+		}
+		else if (Option(argv[i], "--configs", &value))
+		{
+			configs.clear();
+			for (const auto& name : Split(value))
+			{
+				for (const auto& config : kConfigs)
+				{
+					if (name == config.name)
+					{
+						configs.push_back(config);
+					}
+				}
+			}
+		}
+		else if (Option(argv[i], "--send", &value))
+		{
+			send_modes.clear();
+			if (value == "copy" || value == "both")
+			{
+				send_modes.push_back(false);
+			}
+			if (value == "pooled" || value == "both")
+			{
+				send_modes.push_back(true);
+			}
+		}
+		else if (Option(argv[i], "--features", &value))
+		{
+			for (const auto& feature : Split(value))
+			{
+				fragmented |= feature == "frag";
+				coalesced |= feature == "batch";
+				compressed |= feature == "deflate";
+			}
+		}
+		else if (Option(argv[i], "--seconds", &value))
+		{
+			seconds = std::max(std::atof(value.c_str()), 0.1);
+		}
+		else if (Option(argv[i], "--output", &value))
+		{
+			output = std::fopen(value.c_str(), "w");
+			if (!output)
+			{
+				std::fprintf(stderr, "unable to open %s\n", value.c_str());
+				return 1;
+			}
+		}
+		else
+		{
+			std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+#if defined(WEBRTC_WIN)
+	rtc::WinsockInitializer winsock;
+#endif
+	rtc::InitializeSSL();
+	auto engine = RtcEngine::Create();
+	if (!engine)
+	{
+		std::fprintf(stderr, "unable to start the engine\n");
+		return 1;
+	}
+
+	auto failed = false;
+	for (const auto pooled : send_modes)
+	{
+		for (const auto& config : configs)
+		{
+			for (const auto channels : channel_counts)
+			{
+				for (const auto size : sizes)
+				{
+					Scenario scenario{ size, channels, config, pooled, fragmented || size > kMaxUnfragmentedSize, coalesced, compressed };
+					const auto result = Run(engine, scenario, seconds);
+					Report(output, scenario, result);
+					failed |= !result.connected || result.closed;
+				}
+			}
+		}
+	}
+
+	if (output != stdout)
+	{
+		std::fclose(output);
+	}
+	engine.reset();
+	rtc::CleanupSSL();
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,304 @@
+// Keeps a growing number of loopback peers connected on one shared engine and reports what they cost the
+// process: OS threads, resident memory and how long the connections took to set up. Runs once per size of
+// --peers with a fresh engine, every size counts peers, so 1000 peers are 500 connected pairs. The pairs
+// connect in waves of --concurrent and stay connected until the size is measured.
+// Prints one JSON object per size. 5000 peers need an open file limit of about 12000 on Linux.
+//
+// usage: spitfire_scale [--peers=100,1000,5000] [--concurrent=250] [--threads=1] [--timeout=60000]
+
+#include "Loopback.h"
+#include "rtc_base/ssl_adapter.h"
+#include "rtc_base/time_utils.h"
+
+#if defined(WEBRTC_WIN)
+#include "rtc_base/win32_socket_init.h"
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Spitfire;
+
+namespace
+{
+	struct Options
+	{
+		std::vector<uint32_t> peers{ 100, 1000, 5000 };
+		uint32_t concurrent = 250;
+		uint32_t threads = 1;
+		int64_t timeoutMs = 60000;
+	};
+
+	struct Usage
+	{
+		uint32_t threads = 0;
+		uint64_t rssKb = 0;
+	};
+
+	struct Result
+	{
+		uint32_t opened = 0;
+		uint32_t failed = 0;
+		Usage before;
+		Usage after;
+		double seconds = 0;
+		// offer to open channel of every pair that opened
+		std::vector<int64_t> setupUs;
+	};
+
+	bool Option(const char* argument, const char* name, std::string* value)
+	{
+		const auto length = std::strlen(name);
+		if (std::strncmp(argument, name, length) != 0 || argument[length] != '=')
+		{
+			return false;
+		}
+		*value = argument + length + 1;
+		return true;
+	}
+
+	std::vector<uint32_t> Split(const std::string& value)
+	{
+		std::vector<uint32_t> parts;
+		std::stringstream stream(value);
+		std::string part;
+		while (std::getline(stream, part, ','))
+		{
+			const auto peers = static_cast<uint32_t>(std::strtoul(part.c_str(), nullptr, 10));
+			if (peers >= 2)
+			{
+				parts.push_back(peers);
+			}
+		}
+		return parts;
+	}
+
+	const char* Platform()
+	{
+#if defined(WEBRTC_WIN)
+		return "windows";
+#elif defined(WEBRTC_LINUX)
+		return "linux";
+#else
+		return "posix";
+#endif
+	}
+
+	// zero where the platform does not tell
+	Usage Measure()
+	{
+		Usage usage;
+#if defined(WEBRTC_WIN)
+		PROCESS_MEMORY_COUNTERS memory;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+		{
+			usage.rssKb = memory.WorkingSetSize / 1024;
+		}
+		const auto snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+		if (snapshot != INVALID_HANDLE_VALUE)
+		{
+			THREADENTRY32 entry;
+			entry.dwSize = sizeof(entry);
+			for (auto more = Thread32First(snapshot, &entry); more; more = Thread32Next(snapshot, &entry))
+			{
+				if (entry.th32OwnerProcessID == GetCurrentProcessId())
+				{
+					++usage.threads;
+				}
+			}
+			CloseHandle(snapshot);
+		}
+#elif defined(WEBRTC_LINUX)
+		if (auto* status = std::fopen("/proc/self/status", "r"))
+		{
+			char line[256];
+			while (std::fgets(line, sizeof(line), status))
+			{
+				unsigned long value = 0;
+				if (std::sscanf(line, "Threads: %lu", &value) == 1)
+				{
+					usage.threads = static_cast<uint32_t>(value);
+				}
+				else if (std::sscanf(line, "VmRSS: %lu kB", &value) == 1)
+				{
+					usage.rssKb = value;
+				}
+			}
+			std::fclose(status);
+		}
+#endif
+		return usage;
+	}
+
+	int64_t Percentile(const std::vector<int64_t>& sorted, double percentile)
+	{
+		if (sorted.empty())
+		{
+			return 0;
+		}
+		const auto index = static_cast<size_t>(percentile * (sorted.size() - 1));
+		return sorted[index];
+	}
+
+	int64_t OpenedUs(const RtcConnectionTimeline& timeline)
+	{
+		return timeline.offsetUs[static_cast<size_t>(RtcMilestone::ChannelOpen)];
+	}
+
+	// starts |pairs| more pairs and waits until every one of them is open on both ends or the timeout passed
+	void ConnectWave(const std::shared_ptr<RtcEngine>& engine, uint32_t pairs, const Options& options,
+		std::vector<std::unique_ptr<Bench::Loopback>>* connected, Result* result)
+	{
+		const auto first = connected->size();
+		std::vector<bool> started;
+		for (uint32_t i = 0; i < pairs; ++i)
+		{
+			connected->emplace_back(new Bench::Loopback(engine));
+			started.push_back(connected->back()->Initialize());
+		}
+		for (size_t i = 0; i < started.size(); ++i)
+		{
+			started[i] = started[i] && (*connected)[first + i]->StartChannel("scale", webrtc::DataChannelInit());
+		}
+
+		const auto deadline = rtc::TimeMillis() + options.timeoutMs;
+		while (rtc::TimeMillis() < deadline)
+		{
+			auto pending = false;
+			for (size_t i = 0; i < started.size() && !pending; ++i)
+			{
+				auto& pair = *(*connected)[first + i];
+				pending = started[i] && (OpenedUs(pair.offerer().GetConnectionTimeline()) < 0 || OpenedUs(pair.answerer().GetConnectionTimeline()) < 0);
+			}
+			if (!pending)
+			{
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+
+		for (size_t i = 0; i < started.size(); ++i)
+		{
+			auto& pair = *(*connected)[first + i];
+			const auto offerer = OpenedUs(pair.offerer().GetConnectionTimeline());
+			if (started[i] && offerer >= 0 && OpenedUs(pair.answerer().GetConnectionTimeline()) >= 0)
+			{
+				++result->opened;
+				result->setupUs.push_back(offerer);
+			}
+			else
+			{
+				++result->failed;
+			}
+		}
+	}
+
+	Result Run(uint32_t peers, const Options& options)
+	{
+		Result result;
+		RtcEngineOptions engine_options;
+		engine_options.networkThreads = options.threads;
+		auto engine = RtcEngine::Create(engine_options);
+		if (!engine)
+		{
+			result.failed = peers / 2;
+			return result;
+		}
+		result.before = Measure();
+
+		std::vector<std::unique_ptr<Bench::Loopback>> connected;
+		const auto pairs = peers / 2;
+		const auto start_us = rtc::TimeMicros();
+		for (uint32_t done = 0; done < pairs; done += options.concurrent)
+		{
+			ConnectWave(engine, std::min(options.concurrent, pairs - done), options, &connected, &result);
+		}
+		result.seconds = (rtc::TimeMicros() - start_us) / 1e6;
+		result.after = Measure();
+
+		std::sort(result.setupUs.begin(), result.setupUs.end());
+		return result;
+	}
+
+	void Report(uint32_t peers, const Options& options, const Result& result)
+	{
+		const auto grown_kb = result.after.rssKb > result.before.rssKb ? result.after.rssKb - result.before.rssKb : 0;
+		std::printf("{\"platform\":\"%s\",\"peers\":%u,\"concurrent\":%u,\"networkThreads\":%u,\"opened\":%u,\"failed\":%u,\"seconds\":%.3f,"
+			"\"threadsBefore\":%u,\"threadsAfter\":%u,\"rssBeforeKb\":%llu,\"rssAfterKb\":%llu,\"rssPerPeerKb\":%.1f,"
+			"\"setupUs\":{\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"max\":%lld}}\n",
+			Platform(),
+			peers,
+			options.concurrent,
+			options.threads,
+			result.opened,
+			result.failed,
+			result.seconds,
+			result.before.threads,
+			result.after.threads,
+			static_cast<unsigned long long>(result.before.rssKb),
+			static_cast<unsigned long long>(result.after.rssKb),
+			static_cast<double>(grown_kb) / peers,
+			static_cast<long long>(Percentile(result.setupUs, 0.5)),
+			static_cast<long long>(Percentile(result.setupUs, 0.9)),
+			static_cast<long long>(Percentile(result.setupUs, 0.99)),
+			static_cast<long long>(result.setupUs.empty() ? 0 : result.setupUs.back()));
+		std::fflush(stdout);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string value;
+		if (Option(argv[i], "--peers", &value))
+		{
+			options.peers = Split(value);
+		}
+		else if (Option(argv[i], "--concurrent", &value))
+		{
+			options.concurrent = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else if (Option(argv[i], "--threads", &value))
+		{
+			options.threads = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+		}
+		else if (Option(argv[i], "--timeout", &value))
+		{
+			options.timeoutMs = std::max<int64_t>(std::strtoll(value.c_str(), nullptr, 10), 1);
+		}
+		else
+		{
+			std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+#if defined(WEBRTC_WIN)
+	rtc::WinsockInitializer winsock;
+#endif
+	rtc::InitializeSSL();
+
+	auto failed = false;
+	for (const auto peers : options.peers)
+	{
+		const auto result = Run(peers, options);
+		Report(peers, options, result);
+		failed = failed || result.failed > 0;
+	}
+
+	rtc::CleanupSSL();
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,263 @@
+// Connects thousands of loopback pairs at once and reports where the time between the offer and the open
+// channel goes. Pairs are started in waves of --concurrent: every pair of a wave creates its channel and
+// its offer right away, then the wave waits until every channel is open on both ends or --timeout passed.
+// Prints one JSON object per side with the percentiles of the time from the start to each milestone of
+// RtcMilestone. The offerer starts at CreateOffer, the answerer when the offer reaches it.
+// --batching=<window ms> hands candidates over in batches instead of one by one, see CandidateBatcher.
+//
+// usage: spitfire_setup [--connections=2000] [--concurrent=500] [--threads=1] [--timeout=30000] [--batching=-1]
+
+#include "Loopback.h"
+#include "rtc_base/ssl_adapter.h"
+#include "rtc_base/time_utils.h"
+
+#if defined(WEBRTC_WIN)
+#include "rtc_base/win32_socket_init.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Spitfire;
+
+namespace
+{
+	struct Options
+	{
+		uint32_t connections = 2000;
+		uint32_t concurrent = 500;
+		uint32_t threads = 1;
+		int64_t timeoutMs = 30000;
+		// candidate batching window, negative hands candidates over one by one
+		int32_t batchingMs = -1;
+	};
+
+	struct Side
+	{
+		// per milestone, microseconds from the start of every pair that reached it
+		std::vector<int64_t> offsetUs[kMilestoneCount];
+	};
+
+	struct Result
+	{
+		uint32_t opened = 0;
+		uint32_t failed = 0;
+		double seconds = 0;
+		Side offerer;
+		Side answerer;
+	};
+
+	bool Option(const char* argument, const char* name, std::string* value)
+	{
+		const auto length = std::strlen(name);
+		if (std::strncmp(argument, name, length) != 0 || argument[length] != '=')
+		{
+			return false;
+		}
+		*value = argument + length + 1;
+		return true;
+	}
+
+	const char* Platform()
+	{
+#if defined(WEBRTC_WIN)
+		return "windows";
+#elif defined(WEBRTC_LINUX)
+		return "linux";
+#else
+		return "posix";
+#endif
+	}
+
+	int64_t Percentile(const std::vector<int64_t>& sorted, double percentile)
+	{
+		if (sorted.empty())
+		{
+			return 0;
+		}
+		const auto index = static_cast<size_t>(percentile * (sorted.size() - 1));
+		return sorted[index];
+	}
+
+	bool Opened(const RtcConnectionTimeline& timeline)
+	{
+		return timeline.offsetUs[static_cast<size_t>(RtcMilestone::ChannelOpen)] >= 0;
+	}
+
+	void Collect(const RtcConnectionTimeline& timeline, Side* side)
+	{
+		for (size_t i = 0; i < kMilestoneCount; ++i)
+		{
+			if (timeline.offsetUs[i] >= 0)
+			{
+				side->offsetUs[i].push_back(timeline.offsetUs[i]);
+			}
+		}
+	}
+
+	void RunWave(const std::shared_ptr<RtcEngine>& engine, uint32_t pairs, const Options& options, Result* result)
+	{
+		std::vector<std::unique_ptr<Bench::Loopback>> wave;
+		std::vector<bool> started;
+		for (uint32_t i = 0; i < pairs; ++i)
+		{
+			wave.emplace_back(new Bench::Loopback(engine));
+			if (options.batchingMs >= 0)
+			{
+				RtcCandidateBatchingOptions batching;
+				batching.windowMs = options.batchingMs;
+				wave.back()->offerer().EnableCandidateBatching(batching);
+				wave.back()->answerer().EnableCandidateBatching(batching);
+			}
+			started.push_back(wave.back()->Initialize());
+		}
+		// create every offer in one go, so the pairs negotiate at the same time
+		for (size_t i = 0; i < wave.size(); ++i)
+		{
+			started[i] = started[i] && wave[i]->StartChannel("setup", webrtc::DataChannelInit());
+		}
+
+		const auto deadline = rtc::TimeMillis() + options.timeoutMs;
+		while (rtc::TimeMillis() < deadline)
+		{
+			auto pending = false;
+			for (size_t i = 0; i < wave.size() && !pending; ++i)
+			{
+				pending = started[i] && (!Opened(wave[i]->offerer().GetConnectionTimeline()) || !Opened(wave[i]->answerer().GetConnectionTimeline()));
+			}
+			if (!pending)
+			{
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+
+		for (size_t i = 0; i < wave.size(); ++i)
+		{
+			const auto offerer = wave[i]->offerer().GetConnectionTimeline();
+			const auto answerer = wave[i]->answerer().GetConnectionTimeline();
+			// the pairs that got stuck still tell how far they came
+			Collect(offerer, &result->offerer);
+			Collect(answerer, &result->answerer);
+			if (started[i] && Opened(offerer) && Opened(answerer))
+			{
+				++result->opened;
+			}
+			else
+			{
+				++result->failed;
+			}
+		}
+	}
+
+	Result Run(const Options& options)
+	{
+		Result result;
+		RtcEngineOptions engine_options;
+		engine_options.networkThreads = options.threads;
+		auto engine = RtcEngine::Create(engine_options);
+		if (!engine)
+		{
+			result.failed = options.connections;
+			return result;
+		}
+
+		const auto start_us = rtc::TimeMicros();
+		for (uint32_t done = 0; done < options.connections; done += options.concurrent)
+		{
+			RunWave(engine, std::min(options.concurrent, options.connections - done), options, &result);
+		}
+		result.seconds = (rtc::TimeMicros() - start_us) / 1e6;
+
+		for (auto* side : { &result.offerer, &result.answerer })
+		{
+			for (auto& offsets : side->offsetUs)
+			{
+				std::sort(offsets.begin(), offsets.end());
+			}
+		}
+		return result;
+	}
+
+	void Report(const char* name, const Side& side, const Options& options, const Result& result)
+	{
+		std::printf("{\"platform\":\"%s\",\"side\":\"%s\",\"connections\":%u,\"concurrent\":%u,\"threads\":%u,\"batchingMs\":%d,\"opened\":%u,\"failed\":%u,\"seconds\":%.3f,\"milestonesUs\":{",
+			Platform(),
+			name,
+			options.connections,
+			options.concurrent,
+			options.threads,
+			options.batchingMs,
+			result.opened,
+			result.failed,
+			result.seconds);
+		// the start itself is 0 for everyone
+		for (size_t i = 1; i < kMilestoneCount; ++i)
+		{
+			const auto& offsets = side.offsetUs[i];
+			std::printf("%s\"%s\":{\"reached\":%u,\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"max\":%lld}",
+				i > 1 ? "," : "",
+				ConnectionTimeline::NameOf(static_cast<RtcMilestone>(i)),
+				static_cast<uint32_t>(offsets.size()),
+				static_cast<long long>(Percentile(offsets, 0.5)),
+				static_cast<long long>(Percentile(offsets, 0.9)),
+				static_cast<long long>(Percentile(offsets, 0.99)),
+				static_cast<long long>(offsets.empty() ? 0 : offsets.back()));
+		}
+		std::printf("}}\n");
+		std::fflush(stdout);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string value;
+		if (Option(argv[i], "--connections", &value))
+		{
+			options.connections = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else if (Option(argv[i], "--concurrent", &value))
+		{
+			options.concurrent = std::max<uint32_t>(static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), 1);
+		}
+		else if (Option(argv[i], "--threads", &value))
+		{
+			options.threads = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+		}
+		else if (Option(argv[i], "--batching", &value))
+		{
+			options.batchingMs = static_cast<int32_t>(std::strtol(value.c_str(), nullptr, 10));
+		}
+		else if (Option(argv[i], "--timeout", &value))
+		{
+			options.timeoutMs = std::max<int64_t>(std::strtoll(value.c_str(), nullptr, 10), 1);
+		}
+		else
+		{
+			std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+#if defined(WEBRTC_WIN)
+	rtc::WinsockInitializer winsock;
+#endif
+	rtc::InitializeSSL();
+
+	const auto result = Run(options);
+	Report("offerer", result.offerer, options, result);
+	Report("answerer", result.answerer, options, result);
+
+	rtc::CleanupSSL();
+	return result.failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+// Measures how long the engine and a peer take to start and how fast one reliable channel moves data,
+// so builds for different platforms can be compared. Prints a single JSON object.
+//
+// usage: spitfire_startup [messages] [message_size]
+
+#include "Loopback.h"
+#include "rtc_base/ssl_adapter.h"
+#include "rtc_base/time_utils.h"
+
+#if defined(WEBRTC_WIN)
+#include "rtc_base/win32_socket_init.h"
+#endif
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace Spitfire;
+
+static const char* Platform()
+{
+#if defined(WEBRTC_WIN)
+	return "windows";
+#elif defined(WEBRTC_LINUX)
+	return "linux";
+#else
+	return "posix";
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t messages = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 100000;
+	const uint32_t message_size = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 1024;
+
+#if defined(WEBRTC_WIN)
+	rtc::WinsockInitializer winsock;
+#endif
+	rtc::InitializeSSL();
+
+	auto start_us = rtc::TimeMicros();
+	auto engine = RtcEngine::Create();
+	const auto engine_start_us = rtc::TimeMicros() - start_us;
+	if (!engine)
+	{
+		std::fprintf(stderr, "unable to start the engine\n");
+		return 1;
+	}
+
+	int result = 1;
+	{
+		Bench::Loopback loopback(engine);
+
+		std::atomic<uint64_t> received_messages{ 0 };
+		std::atomic<uint64_t> received_bytes{ 0 };
+		rtc::Event writable(false, false);
+		rtc::Event done(false, false);
+		loopback.answerer().onMessage = [&](int32_t, const uint8_t*, uint32_t size, bool)
+		{
+			received_bytes += size;
+			if (++received_messages == messages)
+			{
+				done.Set();
+			}
+		};
+		loopback.offerer().onWritable = [&](int32_t) { writable.Set(); };
+
+		start_us = rtc::TimeMicros();
+		if (!loopback.Initialize())
+		{
+			std::fprintf(stderr, "unable to create the peer connections\n");
+			return 1;
+		}
+		const auto peer_start_us = rtc::TimeMicros() - start_us;
+
+		webrtc::DataChannelInit options;
+		int32_t local;
+		int32_t remote;
+		start_us = rtc::TimeMicros();
+		if (!loopback.OpenChannel("startup", options, 10000, &local, &remote))
+		{
+			std::fprintf(stderr, "the channel did not open\n");
+			return 1;
+		}
+		const auto connect_us = rtc::TimeMicros() - start_us;
+
+		const std::vector<uint8_t> payload(message_size, 0x5A);
+		start_us = rtc::TimeMicros();
+		for (uint32_t sent = 0; sent < messages;)
+		{
+			const auto send_result = loopback.offerer().TrySend(local, payload.data(), message_size, true);
+			if (send_result == RtcSendResult::WouldBlock)
+			{
+				writable.Wait(1000);
+				continue;
+			}
+			if (send_result == RtcSendResult::Closed)
+			{
+				std::fprintf(stderr, "the channel closed after %u messages\n", sent);
+				return 1;
+			}
+			++sent;
+		}
+		const auto completed = done.Wait(60000);
+		const auto seconds = (rtc::TimeMicros() - start_us) / 1e6;
+
+		std::printf("{\"platform\":\"%s\",\"engineStartUs\":%lld,\"peerStartUs\":%lld,\"connectUs\":%lld,"
+			"\"messages\":%llu,\"messageSize\":%u,\"seconds\":%.3f,\"messagesPerSecond\":%.0f,\"megabytesPerSecond\":%.2f,\"completed\":%s}\n",
+			Platform(),
+			static_cast<long long>(engine_start_us),
+			static_cast<long long>(peer_start_us),
+			static_cast<long long>(connect_us),
+			static_cast<unsigned long long>(received_messages.load()),
+			message_size,
+			seconds,
+			received_messages / seconds,
+			received_bytes / seconds / (1024 * 1024),
+			completed ? "true" : "false");
+		result = completed ? 0 : 1;
+	}
+
+	engine.reset();
+	rtc::CleanupSSL();
+	return result;
+}
@@ -0,0 +1,116 @@
+﻿using System.Runtime.InteropServices;
+using System.Text;
+
+namespace SpitfireUtils
+{
+    /// <summary>
+    /// The fields of one candidate line as the native parser returns them, laid out like spitfire_candidate_fields.
+    /// Text fields stay in fixed ASCII buffers so parsing does not allocate, the Get methods turn them into strings on demand.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public unsafe struct CandidateFields
+    {
+        public fixed byte Foundation[36];
+        public uint Component;
+        public int IsTcp;
+        public uint Priority;
+        public fixed byte Address[48];
+        public int Port;
+        /// <summary>
+        /// 1 host, 2 server reflexive, 3 peer reflexive, 4 relay.
+        /// </summary>
+        public int Type;
+        public fixed byte RelatedAddress[48];
+        public int RelatedPort;
+        public uint Generation;
+        public fixed byte UFrag[64];
+        public ushort NetworkId;
+        public ushort NetworkCost;
+
+        public IceTransport Transport => IsTcp != 0 ? IceTransport.Tcp : IceTransport.Udp;
+
+        public IceType IceType => Type == 2 ? IceType.Srflx : Type == 3 ? IceType.Prflx : Type == 4 ? IceType.Relay : IceType.Host;
+
+        public string GetFoundation()
+        {
+            fixed (byte* value = Foundation)
+            {
+                return ToString(value, 36);
+            }
+        }
+
+        public string GetAddress()
+        {
+            fixed (byte* value = Address)
+            {
+                return ToString(value, 48);
+            }
+        }
+
+        public string GetRelatedAddress()
+        {
+            fixed (byte* value = RelatedAddress)
+            {
+                return ToString(value, 48);
+            }
+        }
+
+        public string GetUFrag()
+        {
+            fixed (byte* value = UFrag)
+            {
+                return ToString(value, 64);
+            }
+        }
+
+        private static string ToString(byte* value, int capacity)
+        {
+            var length = 0;
+            while (length < capacity && value[length] != 0)
+            {
+                length++;
+            }
+            return Encoding.ASCII.GetString(value, length);
+        }
+    }
+
+    /// <summary>
+    /// Parses candidates with the native parser of Spitfire.dll instead of the regular expressions of IceParser.
+    /// </summary>
+    public static class NativeIceParser
+    {
+        /// <summary>
+        /// Longer candidates are rejected, they do not fit the stack buffer the line is converted in.
+        /// </summary>
+        public const int MaxLength = 1024;
+
+        [DllImport("Spitfire", CallingConvention = CallingConvention.Cdecl, EntryPoint = "spitfire_parse_candidate")]
+        private static extern unsafe int ParseCandidate(byte* sdp, uint length, CandidateFields* fields);
+
+        /// <summary>
+        ///     Parses an ice candidate string without allocating.
+        /// </summary>
+        /// <param name="candidate">The candidate line, with or without the leading "a="</param>
+        /// <param name="fields">The parsed fields, zeroed when the candidate is malformed</param>
+        /// <returns>False when the candidate is malformed or longer than MaxLength</returns>
+        public static unsafe bool TryParse(string candidate, out CandidateFields fields)
+        {
+            fields = default(CandidateFields);
+            if (candidate == null || candidate.Length > MaxLength)
+            {
+                return false;
+            }
+            // candidates are ASCII, anything else is replaced
+            var line = stackalloc byte[candidate.Length];
+            for (var i = 0; i < candidate.Length; i++)
+            {
+                var c = candidate[i];
+                line[i] = c < 128 ? (byte)c : (byte)'?';
+            }
+            fixed (CandidateFields* result = &fields)
+            {
+                return ParseCandidate(line, (uint)candidate.Length, result) != 0;
+            }
+        }
+    }
+}